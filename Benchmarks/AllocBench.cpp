@@ -0,0 +1,78 @@
+/*------------------------------------------------------------------------------
+    * File:        AllocBench.cpp                                              *
+    * Description: Short-lived stacks with the heap and the pool allocators    *
+                   and small stacks keeping 16 values in the stack object.     *
+                   Each round creates a stack, pushes a few values (so it      *
+                   grows a couple of times) and destroys it.                   *
+                   Prints CSV: allocator,policy,pushes,rounds,ns/round,hits,misses *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/Stack.h"
+#include <chrono>
+
+struct CheckedNoDump : Checked
+{
+    static constexpr bool dump = false;
+};
+
+const size_t PUSHES[] = { 4, 32, 1000 };
+const size_t ROUNDS   = 200000;
+
+volatile long long sink = 0;
+
+//------------------------------------------------------------------------------
+
+template <typename POLICY, typename ALLOC, size_t SMALL = 0>
+void bench (const char* alloc_name, const char* policy_name, size_t pushes)
+{
+    using clock = std::chrono::steady_clock;
+
+    PoolStats before = PoolAllocator::Stats();
+
+    size_t rounds = ROUNDS * 32 / (pushes + 28);
+
+    clock::time_point start = clock::now();
+
+    for (size_t round = 0; round < rounds; ++round)
+    {
+        Stack<long long, POLICY, ALLOC, SMALL> stk ((char*)"bench");
+
+        for (size_t i = 0; i < pushes; ++i) stk.Push((long long)i);
+
+        sink = sink + stk.Pop();
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    PoolStats after = PoolAllocator::Stats();
+
+    printf("%s,%s,%zu,%zu,%.1f,%zu,%zu\n", alloc_name, policy_name, pushes, rounds, ns / rounds,
+           after.hits - before.hits, after.misses - before.misses);
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+int main ()
+{
+    printf("allocator,policy,pushes,rounds,ns/round,hits,misses\n");
+
+    for (size_t pushes : PUSHES)
+    {
+        bench<Release,       HeapAllocator> ("heap", "Release",       pushes);
+        bench<Release,       PoolAllocator> ("pool", "Release",       pushes);
+        bench<CheckedNoDump, HeapAllocator> ("heap", "CheckedNoDump", pushes);
+        bench<CheckedNoDump, PoolAllocator> ("pool", "CheckedNoDump", pushes);
+
+        bench<Release,       HeapAllocator, 16> ("small16", "Release",       pushes);
+        bench<CheckedNoDump, HeapAllocator, 16> ("small16", "CheckedNoDump", pushes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*------------------------------------------------------------------------------
+    * File:        ColumnBench.cpp                                             *
+    * Description: Sum of the int field of the records of a stack of tuples,   *
+                   kept as an array of records and as a column stack with an   *
+                   array per field.                                            *
+                   Prints CSV: stack,records,ns/record                         *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/ColumnStack.h"
+#include <chrono>
+
+typedef std::tuple<double, int, short> Record;
+
+const size_t RECORDS[] = { 1 << 12, 1 << 16, 1 << 22 };
+const size_t BYTES     = (size_t)1 << 28;   // scanned per measurement
+
+volatile long long sink = 0;
+
+//------------------------------------------------------------------------------
+
+template <typename SCAN>
+double bench (size_t records, SCAN scan)
+{
+    using clock = std::chrono::steady_clock;
+
+    size_t repeats = BYTES / (records * sizeof(int)) + 1;
+
+    sink = sink + scan();
+
+    clock::time_point start = clock::now();
+
+    for (size_t i = 0; i < repeats; ++i) sink = sink + scan();
+
+    return std::chrono::duration<double, std::nano>(clock::now() - start).count() / (repeats * records);
+}
+
+//------------------------------------------------------------------------------
+
+int main ()
+{
+    printf("stack,records,ns/record\n");
+
+    for (size_t records : RECORDS)
+    {
+        Stack<Record, Release>       rows    ((char*)"rows");
+        ColumnStack<Record, Release> columns ((char*)"columns");
+
+        for (size_t i = 0; i < records; ++i)
+        {
+            rows.Push(Record (i * 0.5, (int)i, (short)i));
+            columns.Push(i * 0.5, (int)i, (short)i);
+        }
+
+        double aos = bench(records, [&rows, records]
+        {
+            long long sum = 0;
+            for (size_t i = 0; i < records; ++i) sum += std::get<1>(rows[i]);
+
+            return sum;
+        });
+
+        double soa = bench(records, [&columns, records]
+        {
+            const int* column = columns.Column<1>();
+
+            long long sum = 0;
+            for (size_t i = 0; i < records; ++i) sum += column[i];
+
+            return sum;
+        });
+
+        printf("rows,%zu,%.3f\n",    records, aos);
+        printf("columns,%zu,%.3f\n", records, soa);
+        fflush(stdout);
+    }
+
+    return 0;
+}
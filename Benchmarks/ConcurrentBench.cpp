@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------------
+    * File:        ConcurrentBench.cpp                                         *
+    * Description: Scalability of the concurrent stack against a stack behind  *
+                   a mutex. Every thread pushes and pops in turn, from 1 to N  *
+                   threads (N is the argument or the number of cores).         *
+                   Prints CSV: container,threads,ops,seconds,Mops/s            *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/ConcurrentStack.h"
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const size_t OPS_PER_THREAD = 2000000;
+const size_t PREFILL        = 1000;
+
+std::atomic<long long> sink (0);
+
+//------------------------------------------------------------------------------
+
+struct MutexStack
+{
+    std::mutex                mutex;
+    Stack<long long, Release> stk { (char*)"mutex" };
+
+    void Push (long long value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stk.Push(value);
+    }
+
+    long long Pop ()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stk.Pop();
+    }
+};
+
+//------------------------------------------------------------------------------
+
+template <typename STACK>
+void bench (const char* name, size_t threads_num)
+{
+    using clock = std::chrono::steady_clock;
+
+    STACK stk;
+    for (size_t i = 0; i < PREFILL; ++i) stk.Push((long long)i);
+
+    std::atomic<size_t> ready (0);
+    std::atomic<bool>   start (false);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threads_num; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            ready++;
+            while (! start.load()) std::this_thread::yield();
+
+            long long sum = 0;
+            for (size_t i = 0; i < OPS_PER_THREAD / 2; ++i)
+            {
+                stk.Push((long long)(i + t));
+                sum += stk.Pop();
+            }
+            sink += sum;
+        });
+    }
+
+    while (ready.load() < threads_num) std::this_thread::yield();
+
+    clock::time_point begin = clock::now();
+    start.store(true);
+
+    for (std::thread& thread : threads) thread.join();
+
+    double seconds = std::chrono::duration<double>(clock::now() - begin).count();
+    size_t ops     = OPS_PER_THREAD * threads_num;
+
+    printf("%s,%zu,%zu,%.4f,%.2f\n", name, threads_num, ops, seconds, ops / seconds / 1e6);
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+struct LockFree : ConcurrentStack<long long, Release>
+{
+    LockFree () : ConcurrentStack<long long, Release> ((char*)"lockfree") { }
+};
+
+struct LockFreeHashed : ConcurrentStack<long long, Checked>
+{
+    LockFreeHashed () : ConcurrentStack<long long, Checked> ((char*)"lockfree_hashed") { }
+};
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char* argv[])
+{
+    size_t max_threads = std::thread::hardware_concurrency();
+    if (argc > 1) max_threads = (size_t)atoi(argv[1]);
+    if (max_threads == 0) max_threads = 1;
+
+    printf("container,threads,ops,seconds,Mops/s\n");
+
+    for (size_t threads_num = 1; threads_num <= max_threads; threads_num *= 2)
+    {
+        bench<MutexStack>     ("mutex",           threads_num);
+        bench<LockFree>       ("lockfree",        threads_num);
+        bench<LockFreeHashed> ("lockfree_hashed", threads_num);
+
+        if ((threads_num < max_threads) && (threads_num * 2 > max_threads))
+            threads_num = max_threads / 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*------------------------------------------------------------------------------
+    * File:        HashBench.cpp                                               *
+    * Description: Throughput of hash engines on buffers from 64 B to 64 MB.   *
+                   Prints CSV: engine,size,iterations,seconds,MB/s             *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/hash.h"
+#include <chrono>
+
+const size_t MIN_SIZE   = 64;
+const size_t MAX_SIZE   = 64 << 20;
+const double MIN_TIME   = 0.2;
+
+volatile hash_t sink = 0;
+
+//------------------------------------------------------------------------------
+
+static double measure (int engine, const char* buf, size_t size, size_t* iterations)
+{
+    using clock = std::chrono::steady_clock;
+
+    size_t iters = 1;
+    while (true)
+    {
+        clock::time_point start = clock::now();
+
+        for (size_t i = 0; i < iters; ++i)
+            sink = sink + hash_with(engine, buf, size);
+
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if ((seconds >= MIN_TIME) || (iters * size >= ((size_t)1 << 34)))
+        {
+            *iterations = iters;
+            return seconds;
+        }
+
+        iters *= 2;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int main ()
+{
+    char* buf = (char*)malloc(MAX_SIZE);
+    if (buf == nullptr)
+        return 1;
+
+    for (size_t i = 0; i < MAX_SIZE; ++i)
+        buf[i] = (char)(i * 2654435761u >> 13);
+
+    printf("engine,size,iterations,seconds,MB/s\n");
+
+    for (int engine = HASH_ENGINE_COMPAT; engine <= HASH_ENGINE_AVX2; ++engine)
+    {
+        if (! hash_engine_supported(engine)) continue;
+
+        for (size_t size = MIN_SIZE; size <= MAX_SIZE; size *= 4)
+        {
+            size_t iterations = 0;
+            double seconds = measure(engine, buf, size, &iterations);
+
+            printf("%s,%zu,%zu,%.6f,%.1f\n", hash_engine_names[engine], size, iterations, seconds,
+                   (double)size * iterations / seconds / (1 << 20));
+            fflush(stdout);
+        }
+    }
+
+    free(buf);
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*------------------------------------------------------------------------------
+    * File:        PolicyBench.cpp                                             *
+    * Description: Push/pop throughput of stack policies against std::vector.  *
+                   Background stacks are watched by the verifier running every *
+                   VERIFIER_PERIOD ms.                                         *
+                   Prints CSV: container,elements,rounds,ns/op                 *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/Stack.h"
+#include <chrono>
+#include <vector>
+
+struct CheckedNoDump : Checked
+{
+    static constexpr bool dump = false;
+};
+
+struct PoisonOnly : Release
+{
+    static constexpr bool check  = true;
+    static constexpr bool poison = true;
+};
+
+struct CheckedBudget : CheckedNoDump
+{
+    static constexpr double check_budget = 0.05;
+};
+
+const size_t   ELEMENTS[]      = { 1000, 50000, 10000000 };
+const size_t   OPS_TOTAL       = 100000000;
+const size_t   OPS_CHECKED     = 2000000;
+const size_t   OPS_SAMPLED     = 20000000;
+const unsigned VERIFIER_PERIOD = 10;    // ms
+
+volatile long long sink = 0;
+
+//------------------------------------------------------------------------------
+
+template <typename FUNC>
+double measure (FUNC&& func, size_t rounds)
+{
+    using clock = std::chrono::steady_clock;
+
+    clock::time_point start = clock::now();
+    for (size_t round = 0; round < rounds; ++round) func();
+
+    return std::chrono::duration<double, std::nano>(clock::now() - start).count();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename POLICY>
+void bench_stack (const char* name, size_t elements, size_t ops_total)
+{
+    size_t rounds = ops_total / (2 * elements);
+    if (rounds == 0) rounds = 1;
+
+    Stack<long long, POLICY> stk ((char*)"bench");
+
+    if constexpr (POLICY::background) stk.Watch();
+
+    double ns = measure([&, elements]
+    {
+        for (size_t i = 0; i < elements; ++i) stk.Push((long long)i);
+
+        long long sum = 0;
+        for (size_t i = 0; i < elements; ++i) sum += stk.Pop();
+        sink = sink + sum;
+    }, rounds);
+
+    printf("%s,%zu,%zu,%.3f\n", name, elements, rounds, ns / (2.0 * elements * rounds));
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+void bench_vector (size_t elements, size_t ops_total)
+{
+    size_t rounds = ops_total / (2 * elements);
+    if (rounds == 0) rounds = 1;
+
+    std::vector<long long> vec;
+
+    double ns = measure([&, elements]
+    {
+        for (size_t i = 0; i < elements; ++i) vec.push_back((long long)i);
+
+        long long sum = 0;
+        for (size_t i = 0; i < elements; ++i)
+        {
+            sum += vec.back();
+            vec.pop_back();
+        }
+        sink = sink + sum;
+    }, rounds);
+
+    printf("std::vector,%zu,%zu,%.3f\n", elements, rounds, ns / (2.0 * elements * rounds));
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+int main ()
+{
+    printf("container,elements,rounds,ns/op\n");
+
+    verifier_start(VERIFIER_PERIOD);
+
+    for (size_t elements : ELEMENTS)
+    {
+        bench_vector                (elements, OPS_TOTAL);
+        bench_stack<Release>        ("Release",       elements, OPS_TOTAL);
+
+        if (elements >= MAX_CAPACITY) continue;
+
+        bench_stack<PoisonOnly>     ("PoisonOnly",    elements, OPS_TOTAL);
+        bench_stack<Guarded>        ("Guarded",       elements, OPS_TOTAL);
+
+        if (elements * 2 <= OPS_CHECKED)
+            bench_stack<CheckedNoDump> ("CheckedNoDump", elements, OPS_CHECKED);
+
+        bench_stack<CheckedBudget>  ("CheckedBudget", elements, OPS_SAMPLED);
+        bench_stack<Sampled>        ("Sampled",       elements, OPS_SAMPLED);
+        bench_stack<Background>     ("Background",    elements, OPS_SAMPLED);
+    }
+
+    verifier_stop();
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*------------------------------------------------------------------------------
+    * File:        SegmentBench.cpp                                            *
+    * Description: Push latency of a contiguous stack, which copies all its    *
+                   values when it grows, and of a segmented stack, which only  *
+                   adds a chunk. Every push is timed, the worst ones are the   *
+                   growths.                                                    *
+                   Prints CSV: stack,policy,pushes,ns/push,p99.99,max (cycles) *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/SegmentedStack.h"
+#include <chrono>
+
+struct CheckedNoDump : Checked
+{
+    static constexpr bool dump = false;
+};
+
+const size_t PUSHES[] = { 1 << 16, 1 << 22 };
+
+volatile long long sink = 0;
+
+//------------------------------------------------------------------------------
+
+template <typename STACK>
+void bench (const char* stack_name, const char* policy_name, size_t pushes)
+{
+    using clock = std::chrono::steady_clock;
+
+    StackStats times;
+
+    STACK stk ((char*)"bench");
+
+    clock::time_point start = clock::now();
+
+    uint64_t max = 0;
+    for (size_t i = 0; i < pushes; ++i)
+    {
+        uint64_t push_start = stats_cycles();
+
+        stk.Push((long long)i);
+
+        uint64_t time = stats_cycles() - push_start;
+
+        times.histogram[STATS_PUSH][stats_bucket(time)]++;
+        if (time > max) max = time;
+    }
+
+    double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+    sink = sink + stk.Pop();
+
+    printf("%s,%s,%zu,%.1f,%llu,%llu\n", stack_name, policy_name, pushes, ns / pushes,
+           (unsigned long long)times.Percentile(STATS_PUSH, 99.99), (unsigned long long)max);
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+int main ()
+{
+    printf("stack,policy,pushes,ns/push,p99.99,max\n");
+
+    for (size_t pushes : PUSHES)
+    {
+        bench<Stack         <long long, Release>>       ("contiguous", "Release",       pushes);
+        bench<SegmentedStack<long long, Release>>       ("segmented",  "Release",       pushes);
+        bench<Stack         <long long, CheckedNoDump>> ("contiguous", "CheckedNoDump", pushes);
+        bench<SegmentedStack<long long, CheckedNoDump>> ("segmented",  "CheckedNoDump", pushes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*------------------------------------------------------------------------------
+    * File:        StealBench.cpp                                              *
+    * Description: Parallel traversal of an implicit binary tree by a pool of  *
+                   workers with work-stealing deques, against the sequential   *
+                   traversal with one Stack. Every node does a little work and *
+                   pushes its children, idle workers steal from random victims.*
+                   Workers from 1 to N (N is the argument or number of cores). *
+                   Prints CSV: workers,nodes,seconds,speedup,steals            *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/WorkStealingDeque.h"
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+typedef unsigned long long task_t;
+
+const task_t TREE_DEPTH = 22;
+const size_t NODE_WORK  = 200;
+
+std::atomic<unsigned long long> sink (0);
+
+//------------------------------------------------------------------------------
+
+// task is the depth in the high byte and the node index in the rest
+inline task_t make_task (task_t depth, task_t index) { return (depth << 56) | index; }
+inline task_t task_depth (task_t task)               { return task >> 56; }
+inline task_t task_index (task_t task)               { return task & (((task_t)1 << 56) - 1); }
+
+//------------------------------------------------------------------------------
+
+unsigned long long visit (task_t task)
+{
+    unsigned long long x = task_index(task) + 1;
+
+    for (size_t i = 0; i < NODE_WORK; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+    }
+
+    return x;
+}
+
+//------------------------------------------------------------------------------
+
+double sequential (size_t nodes)
+{
+    using clock = std::chrono::steady_clock;
+
+    Stack<task_t, Release> stk ((char*)"sequential");
+
+    clock::time_point begin = clock::now();
+
+    unsigned long long sum     = 0;
+    size_t             visited = 0;
+
+    stk.Push(make_task(0, 0));
+
+    while (stk.getSize() > 0)
+    {
+        task_t task = stk.Pop();
+
+        sum += visit(task);
+        ++visited;
+
+        if (task_depth(task) < TREE_DEPTH)
+        {
+            stk.Push(make_task(task_depth(task) + 1, task_index(task) * 2));
+            stk.Push(make_task(task_depth(task) + 1, task_index(task) * 2 + 1));
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(clock::now() - begin).count();
+
+    assert(visited == nodes);
+    sink += sum;
+
+    return seconds;
+}
+
+//------------------------------------------------------------------------------
+
+void parallel (size_t workers_num, size_t nodes, double base_seconds)
+{
+    using clock = std::chrono::steady_clock;
+
+    typedef WorkStealingDeque<task_t, Release> deque_t;
+
+    std::vector<std::unique_ptr<deque_t>> deques;
+    for (size_t w = 0; w < workers_num; ++w)
+        deques.emplace_back(new deque_t ((char*)"worker"));
+
+    std::atomic<size_t> visited (0);
+    std::atomic<size_t> steals  (0);
+    std::atomic<size_t> ready   (0);
+    std::atomic<bool>   start   (false);
+
+    deques[0]->Push(make_task(0, 0));
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers_num; ++w)
+    {
+        threads.emplace_back([&, w]
+        {
+            deque_t& own = *deques[w];
+
+            size_t             state = w * 2654435761u + 1;
+            unsigned long long sum   = 0;
+            size_t             count = 0;
+            size_t             stolen = 0;
+
+            ready++;
+            while (! start.load()) std::this_thread::yield();
+
+            while (visited.load(std::memory_order_relaxed) < nodes)
+            {
+                task_t task = 0;
+
+                if (own.Pop(task) != STACK_OK)
+                {
+                    state ^= state << 13;
+                    state ^= state >> 7;
+                    state ^= state << 17;
+
+                    size_t victim = state % workers_num;
+
+                    if ((victim == w) || (deques[victim]->Steal(task) != STACK_OK))
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    ++stolen;
+                }
+
+                sum += visit(task);
+
+                if (task_depth(task) < TREE_DEPTH)
+                {
+                    own.Push(make_task(task_depth(task) + 1, task_index(task) * 2));
+                    own.Push(make_task(task_depth(task) + 1, task_index(task) * 2 + 1));
+                }
+
+                // publish the count in batches to keep the counter cold
+                if ((++count == 64) || (own.getSize() == 0))
+                {
+                    visited += count;
+                    count = 0;
+                }
+            }
+
+            visited += count;
+            steals  += stolen;
+            sink    += sum;
+        });
+    }
+
+    while (ready.load() < workers_num) std::this_thread::yield();
+
+    clock::time_point begin = clock::now();
+    start.store(true);
+
+    for (std::thread& thread : threads) thread.join();
+
+    double seconds = std::chrono::duration<double>(clock::now() - begin).count();
+
+    assert(visited.load() == nodes);
+
+    printf("%zu,%zu,%.4f,%.2f,%zu\n", workers_num, nodes, seconds, base_seconds / seconds, steals.load());
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char* argv[])
+{
+    size_t max_workers = std::thread::hardware_concurrency();
+    if (argc > 1) max_workers = (size_t)atoi(argv[1]);
+    if (max_workers == 0) max_workers = 1;
+
+    size_t nodes = ((size_t)2 << TREE_DEPTH) - 1;
+
+    double base_seconds = sequential(nodes);
+
+    printf("workers,nodes,seconds,speedup,steals\n");
+    printf("sequential,%zu,%.4f,1.00,0\n", nodes, base_seconds);
+
+    for (size_t workers_num = 1; workers_num <= max_workers; workers_num *= 2)
+    {
+        parallel(workers_num, nodes, base_seconds);
+
+        if ((workers_num < max_workers) && (workers_num * 2 > max_workers))
+            workers_num = max_workers / 2;
+    }
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+/*------------------------------------------------------------------------------
+    * File:        SuiteBench.cpp                                              *
+    * Description: Benchmark suite of the default stack, built once for every  *
+                   configuration (NO_HASH, NO_DUMP) by `make bench`. Measures  *
+                   push and pop throughput and per-op latency percentiles for  *
+                   every type with POISON at sizes from 8 to 10^7, and the     *
+                   rate of hash(). Every cell has a time budget, cells that    *
+                   run out of it are reported with complete = 0.               *
+                   Usage: SuiteBench [csv|json] [noheader]                     *
+                   CSV: config,type,size,op,ops,seconds,Mops/s,p50_ns,p99_ns,  *
+                        p999_ns,max_ns,complete                                *
+                   JSON: one object per line with the same fields.             *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/Stack.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#if   defined(NO_HASH) && defined(NO_DUMP)
+    #define BENCH_CONFIG "NO_HASH+NO_DUMP"
+#elif defined(NO_HASH)
+    #define BENCH_CONFIG "NO_HASH"
+#elif defined(NO_DUMP)
+    #define BENCH_CONFIG "NO_DUMP"
+#else
+    #define BENCH_CONFIG "default"
+#endif
+
+const size_t SIZES[]           = { 8, 64, 1000, 100000, 10000000 };
+const double CELL_BUDGET       = 0.5;   // seconds per type and size, and per phase
+const size_t SAMPLES_MAX       = 65536; // timed ops per cell for percentiles
+const size_t SAMPLES_PER_ROUND = 4096;  // timed ops per round
+const size_t SAMPLE_STRIDE_MIN = 16;    // rounds timing ops more often are not
+                                        // counted in the throughput
+const size_t HASH_MIN_SIZE     = 64;
+const size_t HASH_MAX_SIZE     = 64 << 20;
+
+typedef std::chrono::steady_clock bench_clock;
+
+volatile long long sink = 0;
+
+bool json_output = false;
+
+//------------------------------------------------------------------------------
+
+struct Result
+{
+    const char* type     = nullptr;
+    size_t      size     = 0;
+    const char* op       = nullptr;
+    size_t      ops      = 0;
+    double      seconds  = 0;
+    double      p50      = 0;
+    double      p99      = 0;
+    double      p999     = 0;
+    double      max      = 0;
+    bool        complete = true;
+};
+
+//------------------------------------------------------------------------------
+
+void print_header ()
+{
+    if (! json_output)
+        printf("config,type,size,op,ops,seconds,Mops/s,p50_ns,p99_ns,p999_ns,max_ns,complete\n");
+}
+
+//------------------------------------------------------------------------------
+
+void print_result (const Result& res)
+{
+    double mops = (res.seconds > 0) ? res.ops / res.seconds / 1e6 : 0;
+
+    if (json_output)
+        printf("{\"config\":\"%s\",\"type\":\"%s\",\"size\":%zu,\"op\":\"%s\",\"ops\":%zu,\"seconds\":%.6f,"
+               "\"Mops/s\":%.3f,\"p50_ns\":%.1f,\"p99_ns\":%.1f,\"p999_ns\":%.1f,\"max_ns\":%.1f,\"complete\":%d}\n",
+               BENCH_CONFIG, res.type, res.size, res.op, res.ops, res.seconds,
+               mops, res.p50, res.p99, res.p999, res.max, (int)res.complete);
+    else
+        printf("%s,%s,%zu,%s,%zu,%.6f,%.3f,%.1f,%.1f,%.1f,%.1f,%d\n",
+               BENCH_CONFIG, res.type, res.size, res.op, res.ops, res.seconds,
+               mops, res.p50, res.p99, res.p999, res.max, (int)res.complete);
+
+    fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+
+void percentiles (std::vector<double>& samples, Result* res)
+{
+    if (samples.empty()) return;
+
+    std::sort(samples.begin(), samples.end());
+
+    size_t last = samples.size() - 1;
+
+    res->p50  = samples[last * 50  / 100];
+    res->p99  = samples[last * 99  / 100];
+    res->p999 = samples[last * 999 / 1000];
+    res->max  = samples[last];
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE>
+TYPE make_value (size_t i)
+{
+    static char str[] = "value";
+
+    if constexpr (std::is_pointer<TYPE>::value) return str + i % 5;
+    else                                        return (TYPE)(i % 100 + 1);
+}
+
+//------------------------------------------------------------------------------
+
+// Every round fills the stack up to size with Push and drains it with Pop, so
+// push includes Expand. Until enough latency samples are collected, rounds time
+// one op in every stride alone. Such rounds are left out of the throughput when
+// the clock reads would dominate it. Rounds repeat until the budget is over, a
+// phase that does not fit the budget by itself stops and is marked incomplete.
+
+struct Phase
+{
+    Result              res;
+    std::vector<double> samples;
+    size_t              sampled_ops     = 0;
+    double              sampled_seconds = 0;
+};
+
+//------------------------------------------------------------------------------
+
+template <typename OP>
+size_t run_phase (Phase* phase, size_t ops, size_t stride, OP&& op)
+{
+    bool   sampling = phase->samples.size() < SAMPLES_MAX;
+    size_t i        = 0;
+
+    bench_clock::time_point start    = bench_clock::now();
+    bench_clock::time_point deadline = start + std::chrono::duration_cast<bench_clock::duration>(
+                                                   std::chrono::duration<double>(CELL_BUDGET));
+
+    for (; i < ops; ++i)
+    {
+        if (sampling && (i % stride == 0))
+        {
+            bench_clock::time_point op_start = bench_clock::now();
+            op(i);
+            bench_clock::time_point op_end   = bench_clock::now();
+
+            phase->samples.push_back(std::chrono::duration<double, std::nano>(op_end - op_start).count());
+            if (phase->samples.size() == SAMPLES_MAX) sampling = false;
+        }
+        else op(i);
+
+        if ((i % 64 == 63) && (bench_clock::now() > deadline))
+        {
+            ++i;
+            phase->res.complete = false;
+            break;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    if (! sampling || (stride >= SAMPLE_STRIDE_MIN))
+    {
+        phase->res.ops     += i;
+        phase->res.seconds += seconds;
+    }
+    else
+    {
+        phase->sampled_ops     += i;
+        phase->sampled_seconds += seconds;
+    }
+
+    return i;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE>
+void bench_type (size_t size)
+{
+    Phase push;
+    push.res.type = PRINT_TYPE<TYPE>;
+    push.res.size = size;
+    push.res.op   = "push";
+
+    Phase pop = push;
+    pop.res.op = "pop";
+
+    size_t stride = (size + SAMPLES_PER_ROUND - 1) / SAMPLES_PER_ROUND;
+
+    bench_clock::time_point begin = bench_clock::now();
+
+    do
+    {
+        Stack<TYPE> stk ((char*)"bench");
+
+        size_t filled = run_phase(&push, size, stride, [&stk] (size_t i)
+        {
+            stk.Push(make_value<TYPE>(i));
+        });
+
+        long long sum = 0;
+
+        run_phase(&pop, filled, stride, [&stk, &sum] (size_t)
+        {
+            sum += (long long)stk.Pop();
+        });
+
+        sink = sink + sum;
+    }
+    while (push.res.complete && pop.res.complete &&
+           (std::chrono::duration<double>(bench_clock::now() - begin).count() < CELL_BUDGET));
+
+    for (Phase* phase : { &push, &pop })
+    {
+        // only sampled rounds fit the budget, their throughput is the best there is
+        if (phase->res.ops == 0)
+        {
+            phase->res.ops     = phase->sampled_ops;
+            phase->res.seconds = phase->sampled_seconds;
+        }
+
+        percentiles(phase->samples, &phase->res);
+        print_result(phase->res);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE>
+void bench_sizes ()
+{
+    for (size_t size : SIZES) bench_type<TYPE>(size);
+}
+
+//------------------------------------------------------------------------------
+
+void bench_hash ()
+{
+    char* buf = (char*)calloc(HASH_MAX_SIZE, 1);
+    if (buf == nullptr) return;
+
+    for (size_t i = 0; i < HASH_MAX_SIZE; ++i)
+        buf[i] = (char)(i * 2654435761u >> 13);
+
+    for (size_t size = HASH_MIN_SIZE; size <= HASH_MAX_SIZE; size *= 8)
+    {
+        Result res;
+        res.type = "bytes";
+        res.size = size;
+        res.op   = "hash";
+
+        std::vector<double> samples;
+
+        do
+        {
+            bench_clock::time_point start = bench_clock::now();
+            sink = sink + (long long)hash(buf, size);
+            double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+
+            if (samples.size() < SAMPLES_MAX) samples.push_back(ns);
+
+            res.ops     += 1;
+            res.seconds += ns * 1e-9;
+        }
+        while (res.seconds < CELL_BUDGET / 4);
+
+        percentiles(samples, &res);
+        print_result(res);
+    }
+
+    free(buf);
+}
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char* argv[])
+{
+    bool header = true;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if      (strcmp(argv[i], "json") == 0)     json_output = true;
+        else if (strcmp(argv[i], "csv") == 0)      json_output = false;
+        else if (strcmp(argv[i], "noheader") == 0) header = false;
+    }
+
+    if (header) print_header();
+
+    bench_hash();
+
+    bench_sizes<double>             ();
+    bench_sizes<float>              ();
+    bench_sizes<unsigned long long> ();
+    bench_sizes<long long>          ();
+    bench_sizes<long unsigned int>  ();
+    bench_sizes<unsigned int>       ();
+    bench_sizes<int>                ();
+    bench_sizes<unsigned short>     ();
+    bench_sizes<short>              ();
+    bench_sizes<unsigned char>      ();
+    bench_sizes<char>               ();
+    bench_sizes<char*>              ();
+
+    return 0;
+}
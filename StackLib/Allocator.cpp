@@ -0,0 +1,232 @@
+/*------------------------------------------------------------------------------
+    * File:        Allocator.cpp                                               *
+    * Description: Pool, mapping and guard page allocators of stack buffers.   *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Allocator.h"
+#include <stdint.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif // __linux__
+
+
+struct PoolBlock
+{
+    PoolBlock* next;
+};
+
+struct PoolCache
+{
+    PoolBlock* heads [POOL_CLASSES_NUM] = {};
+    size_t     bytes [POOL_CLASSES_NUM] = {};
+
+    PoolStats  stats;
+
+   ~PoolCache () { PoolAllocator::Trim(); }
+};
+
+static thread_local PoolCache pool;
+
+//------------------------------------------------------------------------------
+
+static size_t pool_class (size_t size)
+{
+    if (size <= POOL_MIN_BLOCK) return 0;
+
+    return (sizeof(unsigned long long) * 8) - __builtin_clzll((unsigned long long)(size - 1)) - 6;
+}
+
+//------------------------------------------------------------------------------
+
+void* PoolAllocator::Allocate (size_t size)
+{
+    size_t cls = pool_class(size);
+
+    if (cls >= POOL_CLASSES_NUM)
+    {
+        pool.stats.misses++;
+        return malloc(size);
+    }
+
+    PoolBlock* block = pool.heads[cls];
+
+    if (block != nullptr)
+    {
+        pool.heads[cls]  = block->next;
+        pool.bytes[cls] -= POOL_MIN_BLOCK << cls;
+        pool.stats.cached -= POOL_MIN_BLOCK << cls;
+        pool.stats.hits++;
+
+        return block;
+    }
+
+    pool.stats.misses++;
+
+    return malloc(POOL_MIN_BLOCK << cls);
+}
+
+//------------------------------------------------------------------------------
+
+void PoolAllocator::Deallocate (void* ptr, size_t size)
+{
+    if (ptr == nullptr) return;
+
+    size_t cls = pool_class(size);
+
+    if ((cls >= POOL_CLASSES_NUM) || (pool.bytes[cls] + (POOL_MIN_BLOCK << cls) > POOL_CLASS_LIMIT))
+    {
+        free(ptr);
+        return;
+    }
+
+    PoolBlock* block = (PoolBlock*)ptr;
+
+    block->next      = pool.heads[cls];
+    pool.heads[cls]  = block;
+    pool.bytes[cls] += POOL_MIN_BLOCK << cls;
+    pool.stats.cached += POOL_MIN_BLOCK << cls;
+}
+
+//------------------------------------------------------------------------------
+
+void PoolAllocator::Trim ()
+{
+    for (size_t cls = 0; cls < POOL_CLASSES_NUM; ++cls)
+    {
+        while (pool.heads[cls] != nullptr)
+        {
+            PoolBlock* block = pool.heads[cls];
+            pool.heads[cls]  = block->next;
+
+            free(block);
+        }
+
+        pool.bytes[cls] = 0;
+    }
+
+    pool.stats.cached = 0;
+}
+
+//------------------------------------------------------------------------------
+
+PoolStats PoolAllocator::Stats ()
+{
+    return pool.stats;
+}
+
+//------------------------------------------------------------------------------
+
+#ifdef __linux__
+
+static size_t map_size (size_t size)
+{
+    static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    return (size + page - 1) / page * page;
+}
+
+//------------------------------------------------------------------------------
+
+void* MapAllocator::Allocate (size_t size)
+{
+    void* ptr = mmap(nullptr, map_size(size), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    return (ptr == MAP_FAILED) ? nullptr : ptr;
+}
+
+//------------------------------------------------------------------------------
+
+void* MapAllocator::Reallocate (void* ptr, size_t old_size, size_t new_size)
+{
+    if (map_size(old_size) == map_size(new_size)) return ptr;
+
+    void* new_ptr = mremap(ptr, map_size(old_size), map_size(new_size), MREMAP_MAYMOVE);
+
+    return (new_ptr == MAP_FAILED) ? nullptr : new_ptr;
+}
+
+//------------------------------------------------------------------------------
+
+void MapAllocator::Deallocate (void* ptr, size_t size)
+{
+    if (ptr != nullptr) munmap(ptr, map_size(size));
+}
+
+//------------------------------------------------------------------------------
+
+void* HugeMapAllocator::Allocate (size_t size)
+{
+    void* ptr = MapAllocator::Allocate(size);
+
+    if (ptr != nullptr) madvise(ptr, map_size(size), MADV_HUGEPAGE);
+
+    return ptr;
+}
+
+//------------------------------------------------------------------------------
+
+void* HugeMapAllocator::Reallocate (void* ptr, size_t old_size, size_t new_size)
+{
+    void* new_ptr = MapAllocator::Reallocate(ptr, old_size, new_size);
+
+    if (new_ptr != nullptr) madvise(new_ptr, map_size(new_size), MADV_HUGEPAGE);
+
+    return new_ptr;
+}
+
+//------------------------------------------------------------------------------
+
+void HugeMapAllocator::Deallocate (void* ptr, size_t size)
+{
+    MapAllocator::Deallocate(ptr, size);
+}
+
+//------------------------------------------------------------------------------
+
+static const size_t GUARD_ALIGN = 16;
+
+void* GuardAllocator::Allocate (size_t size)
+{
+    static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    size_t aligned = (size + GUARD_ALIGN - 1) / GUARD_ALIGN * GUARD_ALIGN;
+    size_t pages   = map_size(aligned);
+
+    char* base = (char*)mmap(nullptr, pages + 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return nullptr;
+
+    if ((mprotect(base, page, PROT_NONE) != 0) || (mprotect(base + page + pages, page, PROT_NONE) != 0))
+    {
+        munmap(base, pages + 2 * page);
+        return nullptr;
+    }
+
+    return base + page + pages - aligned;
+}
+
+//------------------------------------------------------------------------------
+
+void GuardAllocator::Deallocate (void* ptr, size_t size)
+{
+    static const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    if (ptr == nullptr) return;
+
+    size_t pages = map_size((size + GUARD_ALIGN - 1) / GUARD_ALIGN * GUARD_ALIGN);
+
+    // the buffer starts in the first page after the lower guard
+    char* base = (char*)((uintptr_t)ptr / page * page) - page;
+
+    munmap(base, pages + 2 * page);
+}
+
+//------------------------------------------------------------------------------
+
+#endif // __linux__
@@ -0,0 +1,170 @@
+/*------------------------------------------------------------------------------
+    * File:        Allocator.h                                                 *
+    * Description: Allocators of stack buffers. An allocator is a struct with  *
+                   static Allocate and Deallocate functions working with raw   *
+                   bytes, it is given to Stack as the third template parameter.*
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef ALLOCATOR_H_INCLUDED
+#define ALLOCATOR_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <stdlib.h>
+#include <type_traits>
+
+
+static const size_t POOL_MIN_BLOCK   = 64;
+static const size_t POOL_CLASSES_NUM = 15;      // 64 B .. 1 MB
+static const size_t POOL_CLASS_LIMIT = 1 << 22; // bytes cached in one size class
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocator of the global heap, the default one. Buffers of
+ *           trivially copyable values grow with realloc, which extends them
+ *           in place when it can.
+ */
+
+struct HeapAllocator
+{
+    static void* Allocate (size_t size)
+    {
+        return malloc(size);
+    }
+
+    static void* Reallocate (void* ptr, size_t /*old_size*/, size_t new_size)
+    {
+        return realloc(ptr, new_size);
+    }
+
+    static void Deallocate (void* ptr, size_t /*size*/)
+    {
+        free(ptr);
+    }
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if an allocator can resize a buffer keeping its contents.
+ *           Such an allocator has a static function
+ *           void* Reallocate (void* ptr, size_t old_size, size_t new_size)
+ *           returning the new pointer or nullptr (the old buffer stays valid).
+ *           PoolAllocator and GuardAllocator have none, so stacks using them
+ *           always grow into a new buffer and copy their values.
+ */
+
+template <typename ALLOC, typename = void> constexpr bool CAN_REALLOCATE = false;
+
+template <typename ALLOC>
+constexpr bool CAN_REALLOCATE<ALLOC, std::void_t<decltype(ALLOC::Reallocate(nullptr, 0, 0))>> = true;
+
+//------------------------------------------------------------------------------
+/*! @brief   Pool counters of the calling thread.
+ */
+
+struct PoolStats
+{
+    size_t hits   = 0;  // allocations taken from the pool
+    size_t misses = 0;  // allocations passed to the heap
+    size_t cached = 0;  // bytes kept in the pool now
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Thread-local pool of buffers rounded up to power of two size
+ *           classes. Freed buffers are kept in the pool of the thread that
+ *           frees them and given to the next stack asking for the same class,
+ *           buffers bigger than the largest class go to the heap directly.
+ *           There is no Reallocate: a buffer of another class is never taken
+ *           in place, growth copies the values to a new one.
+ */
+
+struct PoolAllocator
+{
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocate a buffer.
+ *
+ *  @param   size        Size of the buffer in bytes
+ *
+ *  @return  pointer to the buffer
+ */
+
+    static void* Allocate (size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Give a buffer back to the pool.
+ *
+ *  @param   ptr         Pointer to the buffer, may be null
+ *  @param   size        The size it was allocated with
+ */
+
+    static void Deallocate (void* ptr, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Free all the buffers kept in the pool of the calling thread.
+ */
+
+    static void Trim ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the pool counters of the calling thread.
+ *
+ *  @return  pool counters
+ */
+
+    static PoolStats Stats ();
+
+};
+
+#ifdef __linux__
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocator of anonymous memory mappings for big stacks. Buffers
+ *           grow with mremap, which moves pages instead of copying them.
+ *           Sizes are rounded up to whole pages.
+ */
+
+struct MapAllocator
+{
+    static void* Allocate   (size_t size);
+    static void* Reallocate (void* ptr, size_t old_size, size_t new_size);
+    static void  Deallocate (void* ptr, size_t size);
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   MapAllocator asking the kernel to back the buffers with
+ *           transparent huge pages (MADV_HUGEPAGE).
+ */
+
+struct HugeMapAllocator
+{
+    static void* Allocate   (size_t size);
+    static void* Reallocate (void* ptr, size_t old_size, size_t new_size);
+    static void  Deallocate (void* ptr, size_t size);
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocator putting every buffer between two inaccessible guard
+ *           pages, its end next to the upper one, so writes over the end
+ *           fault at once. The start is aligned to 16 bytes, writes under
+ *           it are caught by the data canary or the lower guard page. For
+ *           debugging, every buffer takes at least three pages. There is
+ *           no Reallocate, the end of a grown buffer has to move to its new
+ *           upper guard page, so growth copies the values.
+ */
+
+struct GuardAllocator
+{
+    static void* Allocate   (size_t size);
+    static void  Deallocate (void* ptr, size_t size);
+};
+
+#endif // __linux__
+
+//------------------------------------------------------------------------------
+
+#endif // ALLOCATOR_H_INCLUDED
@@ -0,0 +1,426 @@
+/*------------------------------------------------------------------------------
+    * File:        ColumnStack.h                                               *
+    * Description: Stack of tuples kept as structure of arrays: every field    *
+                   has its own array, so a scan of one field reads only it     *
+                   and can be vectorized.                                      *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef COLUMN_STACK_H_INCLUDED
+#define COLUMN_STACK_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+
+#include "Stack.h"
+#include <tuple>
+#include <utility>
+
+
+const size_t COLUMN_ALIGN     = 64;     // every column starts on its own cache line
+const size_t COLUMN_DUMP_ROWS = 64;     // records gathered from the columns at a time by dumps
+
+#define newColumnStack(NAME, STK_TYPE, ...) \
+        ColumnStack<STK_TYPE, ##__VA_ARGS__> NAME ((char*)#NAME);
+
+
+template <typename TUPLE, typename POLICY = Checked, typename ALLOC = HeapAllocator>
+class ColumnStack;
+
+//------------------------------------------------------------------------------
+/*! @brief   Stack of std::tuple<FIELDS...> records in columns. The columns are
+ *           in one buffer, each aligned to COLUMN_ALIGN from its start, and
+ *           grow together. A field with POISON is filled with it in the free
+ *           slots, others with zero bytes. The block hashes cover the whole
+ *           buffer, a push rehashes the blocks of its slot in every column.
+ *
+ *  @tparam  FIELDS      Types of the fields, trivially copyable
+ *  @tparam  POLICY      Protection policy (see StackConfig.h), only check,
+ *                       hash, full, poison and dump are used
+ *  @tparam  ALLOC       Allocator of the buffer (see Allocator.h)
+ */
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+class ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>
+{
+    static_assert(sizeof...(FIELDS) > 0, "a column stack needs fields");
+    static_assert((std::is_trivially_copyable<FIELDS>::value && ...), "the fields of a column stack are copied as bytes");
+
+public:
+
+    typedef std::tuple<FIELDS...> RecordType;
+
+    template <size_t I>
+    using FieldType = std::tuple_element_t<I, RecordType>;
+
+    static constexpr size_t FIELDS_NUM = sizeof...(FIELDS);
+
+private:
+
+    char*  name_         = nullptr;
+    size_t capacity_     = 0;
+    size_t size_cur_     = 0;
+    char*  data_         = nullptr;
+    size_t max_capacity_ = MAX_CAPACITY;
+    double growth_       = DEFAULT_STACK_GROWTH;
+
+    int id_ = 0;
+    int errCode_;
+
+    hash_t stackhash_ = 0;
+    hash_t datahash_  = 0;
+
+    static constexpr size_t FIELD_SIZES [] = { sizeof(FIELDS)... };
+
+public:
+
+//------------------------------------------------------------------------------
+/*! @brief   Column stack constructor.
+ *
+ *  @param   stack_name  Stack variable name
+ *  @param   capacity    Capacity of the stack
+ */
+
+    ColumnStack (char* stack_name, size_t capacity = DEFAULT_STACK_CAPACITY);
+
+    ColumnStack (const ColumnStack& obj) = delete;
+
+    ColumnStack& operator = (const ColumnStack& obj) = delete;
+
+//------------------------------------------------------------------------------
+/*! @brief   Column stack destructor.
+ */
+
+   ~ColumnStack ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Pushing a record onto the stack.
+ *
+ *  @param   record      Record to push
+ *
+ *  @return  error code, STACK_FULL if the maximum capacity is reached
+ */
+
+    int Push (const RecordType& record);
+
+//------------------------------------------------------------------------------
+/*! @brief   Pushing a record onto the stack field by field.
+ *
+ *  @param   fields      Fields of the record
+ *
+ *  @return  error code, STACK_FULL if the maximum capacity is reached
+ */
+
+    int Push (const FIELDS&... fields);
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping from stack.
+ *
+ *  @return  record from the stack if present, otherwise POISON
+ */
+
+    RecordType Pop ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Get size of the stack data.
+ *
+ *  @return  stack data size
+ */
+
+    size_t getSize () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get capacity of the stack.
+ *
+ *  @return  stack capacity
+ */
+
+    size_t getCapacity () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get name of the stack.
+ *
+ *  @return  stack name
+ */
+
+    const char* getName () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get a column for scans of one field. The pointer is valid until
+ *           the stack grows, getSize() values are live, the value above them
+ *           is POISON (zero bytes for fields without POISON).
+ *
+ *  @tparam  I           Index of the field
+ *
+ *  @return  pointer to the first value of the field
+ */
+
+    template <size_t I>
+    const FieldType<I>* Column () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get a record.
+ *
+ *  @param   n           Index of the record, 0 is the bottom
+ *
+ *  @return  record
+ */
+
+    RecordType Get (size_t n) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Change one field of a record and rehash it.
+ *
+ *  @tparam  I           Index of the field
+ *  @param   n           Index of the record, 0 is the bottom
+ *  @param   value       New value of the field
+ *
+ *  @return  error code
+ */
+
+    template <size_t I>
+    int Set (size_t n, const FieldType<I>& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Clean stack.
+ */
+
+    void Clean ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Full stack check, including the hash of every data block and
+ *           POISON in every free slot.
+ *
+ *  @return  error code
+ */
+
+    int Verify ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Print the contents of the stack and its data to the logfile. The
+ *           records are printed as rows of their fields.
+ *
+ *  @param   funcname    Name of the function from which the dump was called
+ *  @param   logfile     Name of the logfile
+ *
+ *  @return  error code
+ */
+
+    int Dump (const char* funcname = nullptr, const char* logfile = STACK_LOGNAME);
+
+/*------------------------------------------------------------------------------
+                   Private functions                                           *
+*///----------------------------------------------------------------------------
+
+private:
+
+//------------------------------------------------------------------------------
+/*! @brief   Call a function for every field with the index of the field as a
+ *           std::integral_constant.
+ *
+ *  @param   func        Function
+ */
+
+    template <typename FUNC>
+    static void ForFields (FUNC&& func);
+
+    template <typename FUNC, size_t... I>
+    static void ForFields (FUNC&& func, std::index_sequence<I...>);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the offset of a column in the buffer.
+ *
+ *  @param   field       Index of the field
+ *  @param   capacity    Capacity of the buffer
+ *
+ *  @return  offset in bytes
+ */
+
+    static size_t ColumnOffset (size_t field, size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the size of the columns of a buffer, the block hashes
+ *           are after them.
+ *
+ *  @param   capacity    Capacity of the buffer
+ *
+ *  @return  size in bytes
+ */
+
+    static size_t DataSize (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the size of a buffer with its block hashes, if the
+ *           policy has hash.
+ *
+ *  @param   capacity    Capacity of the buffer
+ *
+ *  @return  size in bytes
+ */
+
+    static size_t BufferSize (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get a column of a buffer.
+ *
+ *  @tparam  I           Index of the field
+ *  @param   data        Buffer
+ *  @param   capacity    Capacity of the buffer
+ *
+ *  @return  pointer to the first value of the field
+ */
+
+    template <size_t I>
+    static FieldType<I>* Field (char* data, size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocate a buffer, its slots are filled with POISON and the
+ *           padding of the columns with zero bytes.
+ *
+ *  @param   capacity    Capacity of the buffer
+ *
+ *  @return  pointer to the buffer, nullptr if there is no memory
+ */
+
+    static char* Allocate (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Make the buffer larger, all the columns are copied to a new one.
+ *
+ *  @return  error code, STACK_FULL if the stack can not grow
+ */
+
+    int Expand ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Write a record to a slot.
+ *
+ *  @param   n           Index of the slot
+ *  @param   record      Record
+ */
+
+    void WriteRecord (size_t n, const RecordType& record);
+
+//------------------------------------------------------------------------------
+/*! @brief   Filling slots of every column with POISON of its field, fields
+ *           without POISON are filled with zero bytes.
+ *
+ *  @param   data        Buffer
+ *  @param   capacity    Capacity of the buffer
+ *  @param   first       Index of the first slot
+ *  @param   last        Index after the last slot
+ */
+
+    static void fillPoison (char* data, size_t capacity, size_t first, size_t last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if all the fields with POISON of a slot are POISON.
+ *
+ *  @param   n           Index of the slot
+ *
+ *  @return  true if the slot is POISON, always true if no field has POISON
+ */
+
+    bool isPoisonSlot (size_t n) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if all the fields with POISON of the free slots are POISON.
+ *
+ *  @return  true if the free slots are POISON
+ */
+
+    bool isPoisonFree () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Check stack for problems and hash (if enabled).
+ *
+ *  @param   full        If false, only the data blocks of the top slots are
+ *                       verified
+ *
+ *  @return  error code
+ */
+
+    int Check (bool full = false);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the size of the stack fields under the stack hash.
+ *
+ *  @return  stack size for hash
+ */
+
+    size_t SizeForHash () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the number of hash blocks of a buffer.
+ *
+ *  @param   capacity    Capacity of the buffer
+ *
+ *  @return  number of blocks
+ */
+
+    static size_t BlocksNum (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the block hashes, stored after the columns.
+ *
+ *  @return  pointer to the block hashes
+ */
+
+    hash_t* BlockHashes () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the hash of one block of the buffer.
+ *
+ *  @param   block       Index of the block
+ *
+ *  @return  block hash
+ */
+
+    hash_t BlockHash (size_t block) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of all blocks and the data hash.
+ */
+
+    void RehashData ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of the blocks covering a slot of one column
+ *           and updates the data hash in place.
+ *
+ *  @param   field       Index of the field
+ *  @param   n           Index of the slot
+ */
+
+    void RehashField (size_t field, size_t n);
+
+//------------------------------------------------------------------------------
+/*! @brief   Checks hashes of the blocks covering a slot in every column.
+ *
+ *  @param   n           Index of the slot
+ *
+ *  @return  true if all the blocks are correct
+ */
+
+    bool CheckSlot (size_t n) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Checks hashes of all blocks and the data hash.
+ *
+ *  @return  true if all the hashes are correct
+ */
+
+    bool CheckData () const;
+
+//------------------------------------------------------------------------------
+};
+
+//------------------------------------------------------------------------------
+
+#include "ColumnStack.ipp"
+
+#endif // COLUMN_STACK_H_INCLUDED
@@ -0,0 +1,638 @@
+/*------------------------------------------------------------------------------
+    * File:        ColumnStack.ipp                                             *
+    * Description: Implementations of column stack functions.                  *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::ColumnStack (char* stack_name, size_t capacity) :
+    name_    (stack_name),
+    id_      (stack_id++),
+    errCode_ (STACK_OK)
+{
+    STACK_ASSERTOK((capacity > MAX_CAPACITY),   STACK_WRONG_INPUT_CAPACITY_VALUE_BIG);
+    STACK_ASSERTOK((capacity == 0),             STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
+    STACK_ASSERTOK((stack_name == nullptr),     STACK_WRONG_INPUT_STACK_NAME);
+
+    capacity_ = capacity;
+    data_     = Allocate(capacity_);
+
+    STACK_ASSERTOK((data_ == nullptr), STACK_NO_MEMORY);
+
+    if constexpr (POLICY::hash)
+    {
+        RehashData();
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::~ColumnStack ()
+{
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    if (errCode_ != STACK_DESTRUCTED)
+    {
+        if (data_ != nullptr) ALLOC::Deallocate(data_, BufferSize(capacity_));
+
+        data_      = nullptr;
+        size_cur_  = 0;
+        capacity_  = 0;
+        datahash_  = 0;
+        stackhash_ = 0;
+
+        errCode_ = STACK_DESTRUCTED;
+    }
+    else
+    {
+        STACK_ASSERTOK(true, STACK_DESTRUCTOR_REPEATED);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+int ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Push (const RecordType& record)
+{
+    STACK_CHECK;
+
+    if (size_cur_ == capacity_ - 1)
+    {
+        if (Expand() != STACK_OK)
+        {
+            errCode_ = STACK_FULL;
+
+            if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+            if constexpr (POLICY::hash) stackhash_ = hash(this, SizeForHash());
+
+            return STACK_FULL;
+        }
+    }
+
+    WriteRecord(size_cur_, record);
+
+    ++size_cur_;
+
+    if constexpr (POLICY::hash)
+    {
+        for (size_t field = 0; field < FIELDS_NUM; ++field) RehashField(field, size_cur_ - 1);
+
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+int ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Push (const FIELDS&... fields)
+{
+    return Push(RecordType (fields...));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+std::tuple<FIELDS...> ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Pop ()
+{
+    STACK_CHECK;
+
+    if (size_cur_ == 0)
+    {
+        errCode_ = STACK_EMPTY_STACK;
+
+        if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+        if constexpr (POLICY::hash) stackhash_ = hash(this, SizeForHash());
+
+        return POISON<RecordType>;
+    }
+
+    RecordType record = Get(size_cur_ - 1);
+
+    --size_cur_;
+
+    fillPoison(data_, capacity_, size_cur_, size_cur_ + 1);
+
+    if constexpr (POLICY::hash)
+    {
+        for (size_t field = 0; field < FIELDS_NUM; ++field) RehashField(field, size_cur_);
+
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return record;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+size_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::getSize () const
+{
+    return size_cur_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+size_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::getCapacity () const
+{
+    return capacity_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+const char* ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::getName () const
+{
+    return name_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+template <size_t I>
+const std::tuple_element_t<I, std::tuple<FIELDS...>>* ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Column () const
+{
+    return Field<I>(data_, capacity_);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+std::tuple<FIELDS...> ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Get (size_t n) const
+{
+    if constexpr (POLICY::check) STACK_ASSERTOK((n >= size_cur_), STACK_MEM_ACCESS_VIOLATION);
+
+    RecordType record;
+
+    ForFields([this, n, &record] (auto field)
+    {
+        std::get<decltype(field)::value>(record) = Field<decltype(field)::value>(data_, capacity_)[n];
+    });
+
+    return record;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+template <size_t I>
+int ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Set (size_t n, const FieldType<I>& value)
+{
+    STACK_CHECK;
+
+    if (n >= size_cur_) return STACK_MEM_ACCESS_VIOLATION;
+
+    Field<I>(data_, capacity_)[n] = value;
+
+    if constexpr (POLICY::hash)
+    {
+        RehashField(I, n);
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+void ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Clean ()
+{
+    STACK_CHECK;
+
+    fillPoison(data_, capacity_, 0, size_cur_);
+
+    size_cur_ = 0;
+
+    if constexpr (POLICY::hash)
+    {
+        RehashData();
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+int ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Verify ()
+{
+    return Check(true);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+int ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Dump (const char* funcname, const char* logfile)
+{
+    DumpStack stk = {};
+    DumpState<RecordType>(&stk, this, data_, capacity_, size_cur_, id_, errCode_);
+
+    if constexpr (POLICY::hash)
+    {
+        stk.flags     |= DUMP_FLAG_HASH;
+        stk.stackhash  = stackhash_;
+        stk.datahash   = datahash_;
+    }
+
+    bool broken = dump_is_broken(errCode_) || (data_ == nullptr) || (capacity_ > max_capacity_);
+
+    // the rows the renderer reads are gathered to records a block at a time
+    RecordType rows [COLUMN_DUMP_ROWS];
+    size_t     first = 0;
+    size_t     count = 0;
+
+    return DumpText<RecordType>(&stk, funcname, name_, logfile, [&] (size_t i, size_t* last) -> const RecordType*
+    {
+        if (broken) return nullptr;
+
+        if ((i < first) || (i >= first + count))
+        {
+            first = i;
+            count = (capacity_ - i < COLUMN_DUMP_ROWS) ? capacity_ - i : COLUMN_DUMP_ROWS;
+
+            for (size_t n = 0; n < count; ++n)
+            {
+                ForFields([this, &rows, first, n] (auto field)
+                {
+                    std::get<decltype(field)::value>(rows[n]) = Field<decltype(field)::value>(data_, capacity_)[first + n];
+                });
+            }
+        }
+
+        *last = first + count;
+
+        return rows + (i - first);
+    });
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+template <typename FUNC>
+void ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::ForFields (FUNC&& func)
+{
+    ForFields(std::forward<FUNC>(func), std::index_sequence_for<FIELDS...>());
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+template <typename FUNC, size_t... I>
+void ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::ForFields (FUNC&& func, std::index_sequence<I...>)
+{
+    (func(std::integral_constant<size_t, I>()), ...);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+size_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::ColumnOffset (size_t field, size_t capacity)
+{
+    assert(field <= FIELDS_NUM);
+
+    size_t offset = 0;
+    for (size_t i = 0; i < field; ++i)
+        offset += (FIELD_SIZES[i] * capacity + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN;
+
+    return offset;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+size_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::DataSize (size_t capacity)
+{
+    return ColumnOffset(FIELDS_NUM, capacity);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+size_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::BufferSize (size_t capacity)
+{
+    if constexpr (POLICY::hash) return DataSize(capacity) + BlocksNum(capacity) * sizeof(hash_t);
+    else                        return DataSize(capacity);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+template <size_t I>
+std::tuple_element_t<I, std::tuple<FIELDS...>>* ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Field (char* data, size_t capacity)
+{
+    return (FieldType<I>*)(data + ColumnOffset(I, capacity));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+char* ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Allocate (size_t capacity)
+{
+    static_assert(((alignof(FIELDS) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) && ...), "stack allocators do not align over-aligned types");
+
+    char* data = (char*)ALLOC::Allocate(BufferSize(capacity));
+
+    if (data == nullptr) return nullptr;
+
+    // the padding after the columns is hashed too
+    memset(data, 0, DataSize(capacity));
+
+    fillPoison(data, capacity, 0, capacity);
+
+    return data;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+int ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Expand ()
+{
+    if (capacity_ >= max_capacity_) return STACK_FULL;
+
+    double next     = capacity_ * growth_;
+    size_t capacity = (next >= (double)max_capacity_) ? max_capacity_ :
+                      ((size_t)next > capacity_)      ? (size_t)next   : capacity_ + 1;
+
+    char* data = Allocate(capacity);
+
+    if (data == nullptr) return STACK_FULL;
+
+    for (size_t field = 0; field < FIELDS_NUM; ++field)
+        memcpy(data + ColumnOffset(field, capacity), data_ + ColumnOffset(field, capacity_), size_cur_ * FIELD_SIZES[field]);
+
+    ALLOC::Deallocate(data_, BufferSize(capacity_));
+
+    data_     = data;
+    capacity_ = capacity;
+
+    if constexpr (POLICY::hash) RehashData();
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+void ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::WriteRecord (size_t n, const RecordType& record)
+{
+    assert(n < capacity_);
+
+    ForFields([this, n, &record] (auto field)
+    {
+        Field<decltype(field)::value>(data_, capacity_)[n] = std::get<decltype(field)::value>(record);
+    });
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+void ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::fillPoison (char* data, size_t capacity, size_t first, size_t last)
+{
+    assert(data != nullptr);
+    assert(first <= last);
+
+    if constexpr (! POLICY::poison) return;
+
+    ForFields([data, capacity, first, last] (auto field)
+    {
+        typedef FieldType<decltype(field)::value> TYPE;
+
+        TYPE* column = Field<decltype(field)::value>(data, capacity);
+
+        if constexpr (HAS_POISON<TYPE>) poison_fill(column + first, last - first);
+        else                            memset((void*)(column + first), 0, (last - first) * sizeof(TYPE));
+    });
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+bool ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::isPoisonSlot (size_t n) const
+{
+    bool poison = true;
+
+    ForFields([this, n, &poison] (auto field)
+    {
+        if constexpr (HAS_POISON<FieldType<decltype(field)::value>>) poison = poison && isPOISON(Field<decltype(field)::value>(data_, capacity_)[n]);
+    });
+
+    return poison;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+bool ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::isPoisonFree () const
+{
+    bool poison = true;
+
+    // every column is scanned on its own, so the kernels see plain arrays
+    ForFields([this, &poison] (auto field)
+    {
+        if constexpr (HAS_POISON<FieldType<decltype(field)::value>>)
+            poison = poison && (poison_count(Field<decltype(field)::value>(data_, capacity_) + size_cur_, capacity_ - size_cur_) == 0);
+    });
+
+    return poison;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+int ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::Check (bool full)
+{
+    if ((errCode_ == STACK_NOT_CONSTRUCTED) || (errCode_ == STACK_DESTRUCTED))
+    {
+        return errCode_;
+    }
+
+    else if (POLICY::hash && (stackhash_ != hash(this, SizeForHash())))
+    {
+        errCode_ = STACK_INCORRECT_HASH;
+    }
+
+    else if ((capacity_ == 0) || (capacity_ > max_capacity_))
+    {
+        errCode_ = STACK_CAPACITY_WRONG_VALUE;
+    }
+
+    else if (data_ == nullptr)
+    {
+        errCode_ = STACK_NULL_DATA_PTR;
+    }
+
+    else if (size_cur_ >= capacity_)
+    {
+        errCode_ = STACK_SIZE_BIGGER_CAPACITY;
+    }
+
+    else if (POLICY::poison && (! isPoisonSlot(size_cur_) || ((full || POLICY::full) && ! isPoisonFree())))
+    {
+        errCode_ = STACK_WRONG_CUR_SIZE;
+    }
+
+    else if (POLICY::hash &&
+             ((full || POLICY::full) ? ! CheckData()
+                                     : (! CheckSlot(size_cur_) || ((size_cur_ > 0) && ! CheckSlot(size_cur_ - 1)))))
+    {
+        errCode_ = STACK_INCORRECT_HASH;
+    }
+
+    else
+    {
+        errCode_ = STACK_OK;
+    }
+
+    return errCode_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+size_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::SizeForHash () const
+{
+    return (char*)&id_ - (char*)this + sizeof(id_);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+size_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::BlocksNum (size_t capacity)
+{
+    return (DataSize(capacity) + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+hash_t* ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::BlockHashes () const
+{
+    return (hash_t*)(data_ + DataSize(capacity_));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+hash_t ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::BlockHash (size_t block) const
+{
+    size_t offset = block * HASH_BLOCK_SIZE;
+    size_t size   = DataSize(capacity_) - offset;
+
+    if (size > HASH_BLOCK_SIZE) size = HASH_BLOCK_SIZE;
+
+    return hash(data_ + offset, size);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+void ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::RehashData ()
+{
+    hash_t* blockhash  = BlockHashes();
+    size_t  blocks_num = BlocksNum(capacity_);
+
+    hash_t datahash = 0;
+    for (size_t block = 0; block < blocks_num; ++block)
+    {
+        blockhash[block] = BlockHash(block);
+        datahash ^= hash_mix(blockhash[block], block);
+    }
+
+    datahash_ = datahash;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+void ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::RehashField (size_t field, size_t n)
+{
+    assert(field < FIELDS_NUM);
+    assert(n < capacity_);
+
+    hash_t* blockhash = BlockHashes();
+
+    size_t offset      = ColumnOffset(field, capacity_) + n * FIELD_SIZES[field];
+    size_t first_block = offset / HASH_BLOCK_SIZE;
+    size_t last_block  = (offset + FIELD_SIZES[field] - 1) / HASH_BLOCK_SIZE;
+
+    for (size_t block = first_block; block <= last_block; ++block)
+    {
+        hash_t block_hash = BlockHash(block);
+
+        datahash_        ^= hash_mix(blockhash[block], block) ^ hash_mix(block_hash, block);
+        blockhash[block]  = block_hash;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+bool ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::CheckSlot (size_t n) const
+{
+    hash_t* blockhash = BlockHashes();
+
+    for (size_t field = 0; field < FIELDS_NUM; ++field)
+    {
+        size_t offset      = ColumnOffset(field, capacity_) + n * FIELD_SIZES[field];
+        size_t first_block = offset / HASH_BLOCK_SIZE;
+        size_t last_block  = (offset + FIELD_SIZES[field] - 1) / HASH_BLOCK_SIZE;
+
+        for (size_t block = first_block; block <= last_block; ++block)
+        {
+            if (blockhash[block] != BlockHash(block)) return false;
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename... FIELDS, typename POLICY, typename ALLOC>
+bool ColumnStack<std::tuple<FIELDS...>, POLICY, ALLOC>::CheckData () const
+{
+    hash_t* blockhash  = BlockHashes();
+    size_t  blocks_num = BlocksNum(capacity_);
+
+    hash_t datahash = 0;
+    for (size_t block = 0; block < blocks_num; ++block)
+    {
+        if (blockhash[block] != BlockHash(block)) return false;
+
+        datahash ^= hash_mix(blockhash[block], block);
+    }
+
+    return (datahash == datahash_);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,213 @@
+/*------------------------------------------------------------------------------
+    * File:        ConcurrentStack.h                                           *
+    * Description: Lock-free stack for many threads: Treiber stack with an     *
+                   elimination-backoff array and hazard pointers.              *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef CONCURRENT_STACK_H_INCLUDED
+#define CONCURRENT_STACK_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+
+#include "Stack.h"
+#include "Hazard.h"
+#include <atomic>
+
+
+static const size_t ELIMINATION_SIZE  = 16;     // slots of the elimination array
+static const size_t ELIMINATION_SPINS = 128;    // how long a push waits in a slot
+
+#define newConcurrentStack(NAME, STK_TYPE, ...) \
+        ConcurrentStack<STK_TYPE, ##__VA_ARGS__> NAME ((char*)#NAME);
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Lock-free stack of TYPE values, Push and Pop may be called from
+ *           any number of threads. When the top is contended, a push and a
+ *           pop meeting in the elimination array exchange the value without
+ *           touching the top. Popped nodes are freed through hazard pointers.
+ *
+ *  @tparam  TYPE        Type of values
+ *  @tparam  POLICY      Protection policy (see StackConfig.h): with hash every
+ *                       node keeps the hash of its value, which is verified on
+ *                       pop, with poison popped nodes are filled with POISON.
+ *                       check and dump are not used, a concurrent stack has no
+ *                       consistent state to check or dump between operations.
+ */
+
+template <typename TYPE, typename POLICY = Checked>
+class ConcurrentStack
+{
+private:
+
+    struct Node
+    {
+        TYPE   value;
+        Node*  next = nullptr;
+        hash_t hash = 0;
+
+        template <typename... ARGS>
+        Node (ARGS&&... args) : value (std::forward<ARGS>(args)...) { }
+    };
+
+    char* name_ = nullptr;
+
+    int id_ = 0;
+
+    alignas(64) std::atomic<Node*> top_;
+
+    alignas(64) std::atomic<Node*> elimination_ [ELIMINATION_SIZE];
+
+public:
+
+//------------------------------------------------------------------------------
+/*! @brief   Concurrent stack constructor.
+ *
+ *  @param   stack_name  Stack variable name
+ */
+
+    ConcurrentStack (char* stack_name);
+
+    ConcurrentStack (const ConcurrentStack& obj) = delete;
+
+    ConcurrentStack& operator = (const ConcurrentStack& obj) = delete;
+
+//------------------------------------------------------------------------------
+/*! @brief   Concurrent stack destructor. No thread may use the stack anymore.
+ */
+
+   ~ConcurrentStack ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Pushing a value onto the stack.
+ *
+ *  @param   value       Value to push
+ *
+ *  @return  error code
+ */
+
+    int Push (const TYPE& value);
+
+    int Push (TYPE&& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Constructing a value on the top of the stack.
+ *
+ *  @param   args        Arguments of the TYPE constructor
+ *
+ *  @return  error code
+ */
+
+    template <typename... ARGS>
+    int Emplace (ARGS&&... args);
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping from stack.
+ *
+ *  @return  value from the stack if present, otherwise POISON
+ *           (default constructed value for types without POISON)
+ */
+
+    TYPE Pop ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping from stack.
+ *
+ *  @param   value       Where to move the popped value
+ *
+ *  @return  STACK_OK or STACK_EMPTY_STACK
+ */
+
+    int Pop (TYPE& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if the stack is empty at the moment of the call.
+ *
+ *  @return  true if empty
+ */
+
+    bool isEmpty () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get name of the stack.
+ *
+ *  @return  stack name
+ */
+
+    const char* getName () const;
+
+/*------------------------------------------------------------------------------
+                   Private functions                                           *
+*///----------------------------------------------------------------------------
+
+private:
+
+//------------------------------------------------------------------------------
+/*! @brief   Push a node to the top.
+ *
+ *  @param   node        Node to push
+ *
+ *  @return  error code
+ */
+
+    int PushNode (Node* node);
+
+//------------------------------------------------------------------------------
+/*! @brief   Offer a node to a pop in the elimination array.
+ *
+ *  @param   node        Node to offer
+ *
+ *  @return  true if a pop took the value, the node is freed then
+ */
+
+    bool EliminatePush (Node* node);
+
+//------------------------------------------------------------------------------
+/*! @brief   Take a value offered by a push in the elimination array.
+ *
+ *  @param   value       Where to move the value
+ *
+ *  @return  true if a value was taken
+ */
+
+    bool EliminatePop (TYPE& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Verify the node hash and move the value out of the node.
+ *
+ *  @param   node        Node
+ *  @param   value       Where to move the value
+ */
+
+    void TakeValue (Node* node, TYPE& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Pick a slot of the elimination array for the calling thread.
+ *
+ *  @return  slot index
+ */
+
+    static size_t EliminationIndex ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Delete a node, used as the hazard pointer deleter.
+ *
+ *  @param   node        Node
+ */
+
+    static void DeleteNode (void* node);
+
+//------------------------------------------------------------------------------
+};
+
+//------------------------------------------------------------------------------
+
+#include "ConcurrentStack.ipp"
+
+#endif // CONCURRENT_STACK_H_INCLUDED
@@ -0,0 +1,251 @@
+/*------------------------------------------------------------------------------
+    * File:        ConcurrentStack.ipp                                         *
+    * Description: Implementations of concurrent stack functions.              *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+ConcurrentStack<TYPE, POLICY>::ConcurrentStack (char* stack_name) :
+    name_ (stack_name),
+    id_   (stack_id++),
+    top_  (nullptr)
+{
+    STACK_ASSERTOK((stack_name == nullptr), STACK_WRONG_INPUT_STACK_NAME);
+
+    for (size_t i = 0; i < ELIMINATION_SIZE; ++i)
+        elimination_[i].store(nullptr, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+ConcurrentStack<TYPE, POLICY>::~ConcurrentStack ()
+{
+    Node* node = top_.load();
+
+    while (node != nullptr)
+    {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
+
+    top_.store(nullptr);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int ConcurrentStack<TYPE, POLICY>::Push (const TYPE& value)
+{
+    return PushNode(new Node (value));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int ConcurrentStack<TYPE, POLICY>::Push (TYPE&& value)
+{
+    return PushNode(new Node (std::move(value)));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+template <typename... ARGS>
+int ConcurrentStack<TYPE, POLICY>::Emplace (ARGS&&... args)
+{
+    return PushNode(new Node (std::forward<ARGS>(args)...));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+TYPE ConcurrentStack<TYPE, POLICY>::Pop ()
+{
+    if constexpr (HAS_POISON<TYPE>)
+    {
+        TYPE value = POISON<TYPE>;
+        Pop(value);
+
+        return value;
+    }
+    else
+    {
+        TYPE value {};
+        Pop(value);
+
+        return value;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int ConcurrentStack<TYPE, POLICY>::Pop (TYPE& value)
+{
+    std::atomic<void*>* slot = hazard_slot(0);
+
+    while (true)
+    {
+        Node* top = hazard_protect(slot, top_);
+
+        if (top == nullptr)
+        {
+            slot->store(nullptr, std::memory_order_release);
+            return STACK_EMPTY_STACK;
+        }
+
+        if (top_.compare_exchange_weak(top, top->next, std::memory_order_acquire, std::memory_order_relaxed))
+        {
+            slot->store(nullptr, std::memory_order_release);
+
+            TakeValue(top, value);
+            hazard_retire(top, DeleteNode);
+
+            return STACK_OK;
+        }
+
+        if (EliminatePop(value))
+        {
+            slot->store(nullptr, std::memory_order_release);
+            return STACK_OK;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+bool ConcurrentStack<TYPE, POLICY>::isEmpty () const
+{
+    return top_.load() == nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+const char* ConcurrentStack<TYPE, POLICY>::getName () const
+{
+    return name_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int ConcurrentStack<TYPE, POLICY>::PushNode (Node* node)
+{
+    STACK_ASSERTOK((node == nullptr), STACK_NO_MEMORY);
+
+    if constexpr (POLICY::hash) node->hash = hash(&node->value, sizeof(TYPE));
+
+    node->next = top_.load(std::memory_order_relaxed);
+
+    while (! top_.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+    {
+        if (EliminatePush(node)) return STACK_OK;
+
+        node->next = top_.load(std::memory_order_relaxed);
+    }
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+// A push puts its node to a free slot and waits. A pop replaces the node with
+// ELIMINATION_TAKEN, moves the value and frees the slot, so the push deletes
+// the node only after the slot stops being ELIMINATION_TAKEN.
+
+#define ELIMINATION_TAKEN ((Node*)(uintptr_t)1)
+
+template <typename TYPE, typename POLICY>
+bool ConcurrentStack<TYPE, POLICY>::EliminatePush (Node* node)
+{
+    std::atomic<Node*>* slot = &elimination_[EliminationIndex()];
+
+    Node* expected = nullptr;
+    if (! slot->compare_exchange_strong(expected, node, std::memory_order_release, std::memory_order_relaxed))
+        return false;
+
+    for (size_t spin = 0; (spin < ELIMINATION_SPINS) && (slot->load(std::memory_order_relaxed) == node); ++spin);
+
+    expected = node;
+    if (slot->compare_exchange_strong(expected, nullptr, std::memory_order_relaxed))
+        return false;
+
+    while (slot->load(std::memory_order_acquire) == ELIMINATION_TAKEN);
+
+    delete node;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+bool ConcurrentStack<TYPE, POLICY>::EliminatePop (TYPE& value)
+{
+    std::atomic<Node*>* slot = &elimination_[EliminationIndex()];
+
+    Node* node = slot->load(std::memory_order_relaxed);
+
+    if ((node == nullptr) || (node == ELIMINATION_TAKEN))
+        return false;
+
+    if (! slot->compare_exchange_strong(node, ELIMINATION_TAKEN, std::memory_order_acquire, std::memory_order_relaxed))
+        return false;
+
+    TakeValue(node, value);
+
+    slot->store(nullptr, std::memory_order_release);
+
+    return true;
+}
+
+#undef ELIMINATION_TAKEN
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void ConcurrentStack<TYPE, POLICY>::TakeValue (Node* node, TYPE& value)
+{
+    assert(node != nullptr);
+
+    if constexpr (POLICY::hash)
+    {
+        STACK_ASSERTOK((node->hash != hash(&node->value, sizeof(TYPE))), STACK_INCORRECT_HASH);
+    }
+
+    value = std::move(node->value);
+
+    if constexpr (POLICY::poison && HAS_POISON<TYPE>) node->value = POISON<TYPE>;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t ConcurrentStack<TYPE, POLICY>::EliminationIndex ()
+{
+    static thread_local size_t state = (size_t)&state;
+
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    return state % ELIMINATION_SIZE;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void ConcurrentStack<TYPE, POLICY>::DeleteNode (void* node)
+{
+    delete (Node*)node;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,178 @@
+/*------------------------------------------------------------------------------
+    * File:        Dump.cpp                                                    *
+    * Description: Binary dump string table and text dump lines.               *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Dump.h"
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+static std::mutex                                 strings_mutex;
+static std::unordered_map<std::string, uint32_t>  strings;
+static uint32_t                                   strings_num = 0;
+
+static std::atomic<size_t>                        window_head (DUMP_NO_WINDOW);
+static std::atomic<size_t>                        window_tail (DUMP_NO_WINDOW);
+
+//------------------------------------------------------------------------------
+
+uint64_t dump_time ()
+{
+    struct timespec ts = {};
+    timespec_get(&ts, TIME_UTC);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------------
+
+static void dump_record (const char* logname, uint16_t record, const void* payload, size_t payload_size,
+                         const void* data, size_t data_size)
+{
+    LogBuffer buf;
+
+    DumpRecordHeader header = { DUMP_MAGIC, DUMP_VERSION, record, payload_size + data_size };
+
+    buf_write(&buf, &header, sizeof(header));
+    buf_write(&buf, payload, payload_size);
+    buf_write(&buf, data, data_size);
+
+    log_write(logname, buf.data, buf.size);
+}
+
+//------------------------------------------------------------------------------
+
+uint32_t dump_string_id (const char* logname, const char* str)
+{
+    assert(logname != nullptr);
+
+    if (str == nullptr)
+        return 0;
+
+    std::string key = std::string(logname) + '\0' + str;
+
+    std::lock_guard<std::mutex> lock(strings_mutex);
+
+    auto found = strings.find(key);
+    if (found != strings.end())
+        return found->second;
+
+    std::string session_key = std::string(logname) + '\0';
+    if (strings.find(session_key) == strings.end())
+    {
+        DumpSession session = { (uint64_t)getpid(), dump_time() };
+        dump_record(logname, DUMP_RECORD_SESSION, &session, sizeof(session), nullptr, 0);
+
+        strings[session_key] = 0;
+    }
+
+    DumpString string = { ++strings_num, 0 };
+    dump_record(logname, DUMP_RECORD_STRING, &string, sizeof(string), str, strlen(str));
+
+    strings[key] = string.id;
+
+    return string.id;
+}
+
+//------------------------------------------------------------------------------
+
+void dump_set_window (size_t head, size_t tail)
+{
+    window_head.store(head, std::memory_order_relaxed);
+    window_tail.store(tail, std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+
+void dump_get_window (size_t* head, size_t* tail)
+{
+    assert(head != nullptr);
+    assert(tail != nullptr);
+
+    *head = window_head.load(std::memory_order_relaxed);
+    *tail = window_tail.load(std::memory_order_relaxed);
+}
+
+//------------------------------------------------------------------------------
+
+void dump_run (LogBuffer* buf, size_t first, size_t last, const char* what)
+{
+    assert(buf  != nullptr);
+    assert(what != nullptr);
+    assert(first <= last);
+
+    size_t what_len = strlen(what);
+
+    char* end = buf_reserve(buf, 80 + what_len);
+    if (end == nullptr) return;
+
+    char* line = end;
+
+    memcpy(line, "\t\t [", 4);                          line += 4;
+    line = std::to_chars(line, line + 20, first).ptr;
+    memcpy(line, "..", 2);                               line += 2;
+    line = std::to_chars(line, line + 20, last).ptr;
+    memcpy(line, "]: ", 3);                              line += 3;
+    memcpy(line, what, what_len);                        line += what_len;
+    memcpy(line, " x ", 3);                              line += 3;
+    line = std::to_chars(line, line + 20, last - first + 1).ptr;
+    *line++ = '\n';
+
+    buf->size += line - end;
+}
+
+//------------------------------------------------------------------------------
+
+void dump_slot_begin (LogBuffer* buf, size_t i, bool poison)
+{
+    assert(buf != nullptr);
+
+    char* end = buf_reserve(buf, 32);
+    if (end == nullptr) return;
+
+    char* line = end;
+
+    *line++ = '\t';
+    *line++ = '\t';
+    *line++ = poison ? ' ' : '*';
+    *line++ = '[';
+    line = std::to_chars(line, line + 20, i).ptr;
+    memcpy(line, "]: [", 4);                             line += 4;
+
+    buf->size += line - end;
+}
+
+//------------------------------------------------------------------------------
+
+void dump_slot_end (LogBuffer* buf, bool poison)
+{
+    assert(buf != nullptr);
+
+    if (poison) buf_write(buf, "] (POISON)\n", 11);
+    else        buf_write(buf, "]\n", 2);
+}
+
+//------------------------------------------------------------------------------
+
+int dump_write (const LogBuffer* buf, const char* logfile)
+{
+    assert(buf != nullptr);
+
+    if (logfile == nullptr)
+    {
+        fwrite(buf->data, 1, buf->size, stdout);
+        return STACK_OK;
+    }
+
+    return log_write(logfile, buf->data, buf->size) ? STACK_OK : STACK_NOT_OK;
+}
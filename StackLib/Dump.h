@@ -0,0 +1,526 @@
+/*------------------------------------------------------------------------------
+    * File:        Dump.h                                                      *
+    * Description: Binary dump records and text rendering of stack dumps,     *
+                   shared by the stack library and the dump decoder.           *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef DUMP_H_INCLUDED
+#define DUMP_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "StackConfig.h"
+#include "Log.h"
+#include "hash.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <charconv>
+#include <type_traits>
+
+
+const uint32_t DUMP_MAGIC   = 0x504D4453; // "SDMP"
+const uint16_t DUMP_VERSION = 1;
+
+const size_t DUMP_VALUE_MAX = 512;        // longest text of a value, a double printed as %f
+const size_t DUMP_NO_WINDOW = SIZE_MAX;
+
+enum DumpRecords
+{
+    DUMP_RECORD_SESSION = 1 ,
+    DUMP_RECORD_STRING      ,
+    DUMP_RECORD_STACK       ,
+};
+
+enum DumpFlags
+{
+    DUMP_FLAG_HASH   = 1 ,
+    DUMP_FLAG_SMALL  = 2 ,
+    DUMP_FLAG_SHARED = 4 ,
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Header of every record in a binary dump file.
+ */
+
+struct DumpRecordHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record;
+    uint64_t size;      // number of bytes after the header
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Written once per process before its first record, resets the
+ *           string table of the decoder.
+ */
+
+struct DumpSession
+{
+    uint64_t pid;
+    uint64_t time;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Interned string (stack name or function name), followed by the
+ *           characters of the string without null terminator.
+ */
+
+struct DumpString
+{
+    uint32_t id;
+    uint32_t reserved;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Stack state, followed by capacity * elem_size raw data bytes
+ *           (no data if data pointer was null).
+ */
+
+struct DumpStack
+{
+    uint64_t time;          // nanoseconds since epoch
+    uint64_t address;
+    uint64_t data_address;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t stackhash;
+    uint64_t datahash;
+    uint64_t truestackhash;
+    uint64_t truedatahash;
+    uint32_t func_id;
+    uint32_t name_id;
+    int32_t  id;
+    int32_t  errcode;
+    uint16_t type_tag;
+    uint16_t elem_size;
+    uint32_t flags;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Get current time for dump records.
+ *
+ *  @return  nanoseconds since epoch
+ */
+
+uint64_t dump_time ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Get id of the string in the binary dump file. The first time a
+ *           string is met, its record (and the session record, if it is the
+ *           first record of the process in this file) is put to the log queue.
+ *
+ *  @param   logname     Name of the binary dump file
+ *  @param   str         String, may be null
+ *
+ *  @return  string id, 0 for null
+ */
+
+uint32_t dump_string_id (const char* logname, const char* str);
+
+//------------------------------------------------------------------------------
+/*! @brief   Set the window of the values printed by text dumps: the first
+ *           head and the last tail values of a stack. The values between
+ *           them are printed as one line, the free slots are not limited.
+ *
+ *  @param   head        Number of values at the bottom of a stack
+ *  @param   tail        Number of values at the top of a stack, both are
+ *                       DUMP_NO_WINDOW by default - all values are printed
+ */
+
+void dump_set_window (size_t head, size_t tail);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the window of the values printed by text dumps.
+ *
+ *  @param   head        Set to the number of values at the bottom of a stack
+ *  @param   tail        Set to the number of values at the top of a stack
+ */
+
+void dump_get_window (size_t* head, size_t* tail);
+
+//------------------------------------------------------------------------------
+/*! @brief   Print a run of slots of a dump as one line: [first..last]: what x n.
+ *
+ *  @param   buf         Log buffer
+ *  @param   first       Index of the first slot
+ *  @param   last        Index of the last slot
+ *  @param   what        What the slots are
+ */
+
+void dump_run (LogBuffer* buf, size_t first, size_t last, const char* what);
+
+//------------------------------------------------------------------------------
+/*! @brief   Print the beginning of the line of a slot, up to its value.
+ *
+ *  @param   buf         Log buffer
+ *  @param   i           Index of the slot
+ *  @param   poison      True if the value is POISON
+ */
+
+void dump_slot_begin (LogBuffer* buf, size_t i, bool poison);
+
+//------------------------------------------------------------------------------
+/*! @brief   Print the end of the line of a slot, after its value.
+ *
+ *  @param   buf         Log buffer
+ *  @param   poison      True if the value is POISON
+ */
+
+void dump_slot_end (LogBuffer* buf, bool poison);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if stack errcode means that only the short dump is printed.
+ *
+ *  @param   errcode     Error code of the stack
+ *
+ *  @return  true if stack data can not be printed
+ */
+
+inline bool dump_is_broken (int errcode)
+{
+    return (errcode == STACK_NOT_CONSTRUCTED)      ||
+           (errcode == STACK_DESTRUCTED)           ||
+           (errcode == STACK_NULL_DATA_PTR)        ||
+           (errcode == STACK_SIZE_BIGGER_CAPACITY) ||
+           (errcode == STACK_CAPACITY_WRONG_VALUE);
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Print one data value of a dump, the fields of a tuple are printed
+ *           with their own formats.
+ *
+ *  @param   buf         Log buffer
+ *  @param   value       Value to print
+ *  @param   foreign     True if the value was read from a dump file, so
+ *                       pointers can not be dereferenced
+ */
+
+template <typename TYPE>
+void DumpValue (LogBuffer* buf, const TYPE& value, bool foreign)
+{
+    if constexpr (IS_TUPLE<TYPE>)
+    {
+        std::apply([buf, foreign] (const auto&... field)
+        {
+            size_t separator = 0;
+            ((buf_write(buf, ", ", separator), DumpValue(buf, field, foreign), separator = 2), ...);
+        }, value);
+    }
+
+    else if constexpr (! HAS_POISON<TYPE>)
+    {
+        char* end = buf_reserve(buf, 32);
+        if (end == nullptr) return;
+
+        char* last = std::to_chars(end, end + 20, sizeof(TYPE)).ptr;
+        memcpy(last, " bytes", 6);
+
+        buf->size += last + 6 - end;
+    }
+
+    else if constexpr (std::is_pointer<TYPE>::value)
+    {
+        if (foreign) buf_printf(buf, PRINT_PTR, (const void*)value);
+        else         buf_printf(buf, PRINT_FORMAT<TYPE>, value);
+    }
+
+    else if constexpr (std::is_same<TYPE, char>::value || std::is_same<TYPE, unsigned char>::value)
+    {
+        buf_write(buf, &value, 1);
+    }
+
+    else
+    {
+        // the same text as PRINT_FORMAT without parsing a format
+        char* end = buf_reserve(buf, DUMP_VALUE_MAX);
+        if (end == nullptr) return;
+
+        std::to_chars_result result = {};
+
+        if constexpr (std::is_floating_point<TYPE>::value)
+            result = std::to_chars(end, end + DUMP_VALUE_MAX, value, std::chars_format::fixed, 6);
+        else
+            result = std::to_chars(end, end + DUMP_VALUE_MAX, value);
+
+        if (result.ec == std::errc()) buf->size += result.ptr - end;
+        else                          buf_printf(buf, PRINT_FORMAT<TYPE>, value);
+    }
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Data of a stack in one array, as the spans of DumpRenderSpans.
+ */
+
+template <typename TYPE>
+struct DumpArray
+{
+    const TYPE* data;
+    size_t      capacity;
+
+    const TYPE* operator () (size_t i, size_t* last) const
+    {
+        *last = capacity;
+        return (data != nullptr) ? data + i : nullptr;
+    }
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Render a stack dump in text format, the data is read in spans of
+ *           consecutive values, so a stack in chunks or columns is rendered
+ *           without copying it to one array.
+ *
+ *  @param   buf         Log buffer
+ *  @param   stk         Stack state
+ *  @param   funcname    Name of the function from which the dump was called,
+ *                       if null, the header and errors are not printed
+ *  @param   name        Stack name
+ *  @param   span        Function const TYPE* (size_t i, size_t* last) giving
+ *                       the address of value i and setting last to the index
+ *                       after the span of values following it in memory, or
+ *                       nullptr if there is no data. The address is read only
+ *                       until the next call. Only the values of the window
+ *                       (see dump_set_window) and the free slots are read, for
+ *                       types without POISON only the first stk->size
+ *  @param   foreign     True if the dump was read from a dump file
+ */
+
+template <typename TYPE, typename SPAN>
+void DumpRenderSpans (LogBuffer* buf, const DumpStack* stk, const char* funcname, const char* name, SPAN&& span, bool foreign = false)
+{
+    assert(buf != nullptr);
+    assert(stk != nullptr);
+
+    const size_t linelen = 80;
+    char divline[linelen + 1] = "********************************************************************************";
+
+    if (funcname != nullptr)
+    {
+        buf_printf(buf, "This dump was called from a function \"%s\"\n", funcname);
+
+        time_t t = (time_t)(stk->time / 1000000000);
+        struct tm tm = *localtime(&t);
+        buf_printf(buf, "TIME: %d-%02d-%02d %02d:%02d:%02d\n\n",
+                   tm.tm_year + 1900,
+                   tm.tm_mon + 1,
+                   tm.tm_mday,
+                   tm.tm_hour,
+                   tm.tm_min,
+                   tm.tm_sec);
+    }
+
+    if (dump_is_broken(stk->errcode))
+    {
+        buf_printf(buf, "\nStack (ERROR) [" PRINT_PTR "] \"%s\" id (%d)\n", (void*)stk->address, name, stk->id);
+        if (funcname != nullptr) buf_printf(buf, "\n%s\n", stk_errstr[stk->errcode + 1]);
+
+        buf_printf(buf, "%s\n", divline);
+
+        return;
+    }
+
+    char* StkState = (char*)stk_errstr[STACK_OK + 1];
+
+    if (stk->errcode && (funcname != nullptr)) buf_printf(buf, "\n%s\n", stk_errstr[stk->errcode + 1]);
+
+    buf_printf(buf, "\nStack (%s) [" PRINT_PTR "] \"%s\", id (%d)\n", StkState, (void*)stk->address, name, stk->id);
+
+    buf_printf(buf, "\t{\n");
+
+    buf_printf(buf, "\tType of data is %s\n\n", PRINT_TYPE<TYPE>);
+
+    buf_printf(buf, "\tCapacity           = %lu\n",   (unsigned long)stk->capacity);
+    buf_printf(buf, "\tCurrent size       = %lu\n\n", (unsigned long)stk->size);
+
+    if (stk->flags & DUMP_FLAG_HASH)
+    {
+        buf_printf(buf, "\tStack hash         = " HASH_PRINT_FORMAT "\n",   (hash_t)stk->stackhash);
+        buf_printf(buf, "\tData hash          = " HASH_PRINT_FORMAT "\n\n", (hash_t)stk->datahash);
+
+        if ((stk->errcode != STACK_OK) && (stk->errcode != STACK_EMPTY_STACK) && (stk->errcode != STACK_NO_MEMORY) &&
+            (stk->errcode != STACK_FULL))
+        {
+            buf_printf(buf, "\tTrue stack hash    = " HASH_PRINT_FORMAT "\n",   (hash_t)stk->truestackhash);
+            buf_printf(buf, "\tTrue data hash     = " HASH_PRINT_FORMAT "\n\n", (hash_t)stk->truedatahash);
+        }
+    }
+
+    buf_printf(buf, "\tData [" PRINT_PTR "]%s%s\n", (void*)stk->data_address, (stk->flags & DUMP_FLAG_SMALL)  ? " (in the stack)" : "",
+                                                                           (stk->flags & DUMP_FLAG_SHARED) ? " (shared)"       : "");
+
+    buf_printf(buf, "\t\t{\n");
+
+    size_t head = 0;
+    size_t tail = 0;
+    dump_get_window(&head, &tail);
+
+    // the values between the head and the tail of the window are skipped
+    size_t size       = (stk->size < stk->capacity) ? stk->size : stk->capacity;
+    size_t skip_first = (head < size) ? head : size;
+    size_t skip_last  = (tail < size - skip_first) ? size - tail : skip_first;
+
+    for (size_t i = 0; i < stk->capacity; )
+    {
+        if ((i == skip_first) && (skip_first < skip_last))
+        {
+            dump_run(buf, skip_first, skip_last - 1, "SKIPPED");
+            i = skip_last;
+            continue;
+        }
+
+        if constexpr (! HAS_POISON<TYPE>)
+        {
+            if (i >= stk->size)
+            {
+                if (i + 1 == stk->capacity) buf_printf(buf, "\t\t [%zu]: [] (FREE)\n", i);
+                else                        dump_run(buf, i, stk->capacity - 1, "FREE");
+                break;
+            }
+        }
+
+        size_t      last  = 0;
+        const TYPE* value = span(i, &last);
+        if (value == nullptr) break;
+
+        bool ispois = isPOISON(*value);
+
+        if (ispois)
+        {
+            // a run of POISON stops at the skipped values and goes on over the spans
+            size_t stop = ((i < skip_first) && (skip_first < skip_last)) ? skip_first : stk->capacity;
+            size_t end  = i + 1;
+
+            for (const TYPE* run = value + 1; (run != nullptr) && (end < stop); )
+            {
+                size_t n = ((last < stop) ? last : stop) - end;
+
+                size_t poisoned = poison_span(run, n);
+                end += poisoned;
+
+                if (poisoned < n) break;
+                if (end < stop) run = span(end, &last);
+            }
+
+            if (end - i > 1)
+            {
+                dump_run(buf, i, end - 1, "POISON");
+                i = end;
+                continue;
+            }
+
+            // the run may have read the next span
+            value = span(i, &last);
+        }
+
+        dump_slot_begin(buf, i, ispois);
+        DumpValue(buf, *value, foreign);
+        dump_slot_end(buf, ispois);
+
+        ++i;
+    }
+
+    buf_printf(buf, "\t\t}\n");
+
+    buf_printf(buf, "\t}\n");
+
+    buf_printf(buf, "%s\n", divline);
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Render a stack dump in text format.
+ *
+ *  @param   buf         Log buffer
+ *  @param   stk         Stack state
+ *  @param   funcname    Name of the function from which the dump was called,
+ *                       if null, the header and errors are not printed
+ *  @param   name        Stack name
+ *  @param   data        Stack data of stk->capacity elements, for types
+ *                       without POISON only the first stk->size are read.
+ *                       Runs of POISON and of free slots are printed as one
+ *                       line, only the window of values is printed (see
+ *                       dump_set_window)
+ *  @param   foreign     True if the dump was read from a dump file
+ */
+
+template <typename TYPE>
+void DumpRender (LogBuffer* buf, const DumpStack* stk, const char* funcname, const char* name, const TYPE* data, bool foreign = false)
+{
+    DumpRenderSpans<TYPE>(buf, stk, funcname, name, DumpArray<TYPE> { data, stk->capacity }, foreign);
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Fill the fields of a dump common to all the stacks, the hashes
+ *           and flags are left to the stack.
+ *
+ *  @param   stk         Stack state
+ *  @param   address     Address of the stack
+ *  @param   data        Address of the stack data
+ *  @param   capacity    Capacity of the stack
+ *  @param   size        Size of the stack
+ *  @param   id          Id of the stack
+ *  @param   errcode     Error code of the stack
+ */
+
+template <typename TYPE>
+void DumpState (DumpStack* stk, const void* address, const void* data, size_t capacity, size_t size, int id, int errcode)
+{
+    assert(stk != nullptr);
+
+    stk->time         = dump_time();
+    stk->address      = (uint64_t)address;
+    stk->data_address = (uint64_t)data;
+    stk->capacity     = capacity;
+    stk->size         = size;
+    stk->id           = id;
+    stk->errcode      = errcode;
+    stk->type_tag     = TYPE_TAG<TYPE>;
+    stk->elem_size    = sizeof(TYPE);
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Write a rendered text dump to a logfile.
+ *
+ *  @param   buf         Log buffer
+ *  @param   logfile     Name of the logfile, stdout if null
+ *
+ *  @return  error code
+ */
+
+int dump_write (const LogBuffer* buf, const char* logfile);
+
+//------------------------------------------------------------------------------
+/*! @brief   Text dump of a stack: the error of the stack is printed to the
+ *           console, the dump is rendered in a thread-local buffer and
+ *           written to the logfile, or to stdout if funcname is null.
+ *
+ *  @param   stk         Stack state
+ *  @param   funcname    Name of the function from which the dump was called
+ *  @param   name        Stack name
+ *  @param   logfile     Name of the logfile
+ *  @param   span        Spans of the stack data (see DumpRenderSpans)
+ *
+ *  @return  error code
+ */
+
+template <typename TYPE, typename SPAN>
+int DumpText (const DumpStack* stk, const char* funcname, const char* name, const char* logfile, SPAN&& span)
+{
+    static thread_local LogBuffer buf;
+    buf.size = 0;
+
+    if (stk->errcode) CONSOLE_PRINT{ printf("%s\n", stk_errstr[stk->errcode + 1]); }
+
+    DumpRenderSpans<TYPE>(&buf, stk, funcname, name, span);
+
+    return dump_write(&buf, (funcname != nullptr) ? logfile : nullptr);
+}
+
+//------------------------------------------------------------------------------
+
+#endif // DUMP_H_INCLUDED
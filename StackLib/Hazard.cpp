@@ -0,0 +1,158 @@
+/*------------------------------------------------------------------------------
+    * File:        Hazard.cpp                                                  *
+    * Description: Hazard pointers implementation.                             *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Hazard.h"
+#include <stdio.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+
+struct HazardRecord
+{
+    std::atomic<void*> slots [HAZARD_SLOTS_NUM];
+    std::atomic<bool>  active;
+};
+
+struct HazardRetired
+{
+    void* ptr;
+    void (*deleter)(void*);
+};
+
+struct HazardThread
+{
+    HazardRecord*              record = nullptr;
+    std::vector<HazardRetired> retired;
+
+   ~HazardThread ();
+};
+
+static HazardRecord        hazard_records [HAZARD_THREADS_NUM];
+static std::atomic<size_t> hazard_records_used (0);
+
+static std::mutex                 orphans_mutex;
+static std::vector<HazardRetired> orphans;
+
+static thread_local HazardThread hazard_thread;
+
+//------------------------------------------------------------------------------
+
+HazardThread::~HazardThread ()
+{
+    if (record == nullptr) return;
+
+    for (size_t i = 0; i < HAZARD_SLOTS_NUM; ++i)
+        record->slots[i].store(nullptr);
+
+    hazard_scan();
+
+    if (! retired.empty())
+    {
+        std::lock_guard<std::mutex> lock(orphans_mutex);
+        orphans.insert(orphans.end(), retired.begin(), retired.end());
+    }
+
+    record->active.store(false);
+    record = nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+static HazardRecord* hazard_acquire ()
+{
+    for (size_t i = 0; i < HAZARD_THREADS_NUM; ++i)
+    {
+        bool expected = false;
+
+        if (! hazard_records[i].active.load() && hazard_records[i].active.compare_exchange_strong(expected, true))
+        {
+            size_t used = hazard_records_used.load();
+            while ((used < i + 1) && ! hazard_records_used.compare_exchange_weak(used, i + 1));
+
+            return &hazard_records[i];
+        }
+    }
+
+    fprintf(stderr, "More than %zu threads use hazard pointers\n", HAZARD_THREADS_NUM);
+    abort();
+}
+
+//------------------------------------------------------------------------------
+
+std::atomic<void*>* hazard_slot (size_t index)
+{
+    assert(index < HAZARD_SLOTS_NUM);
+
+    if (hazard_thread.record == nullptr)
+        hazard_thread.record = hazard_acquire();
+
+    return &hazard_thread.record->slots[index];
+}
+
+//------------------------------------------------------------------------------
+
+void hazard_retire (void* ptr, void (*deleter)(void*))
+{
+    assert(deleter != nullptr);
+
+    if (ptr == nullptr) return;
+
+    hazard_thread.retired.push_back({ ptr, deleter });
+
+    size_t limit = 2 * HAZARD_SLOTS_NUM * hazard_records_used.load(std::memory_order_relaxed);
+    if (limit < HAZARD_SCAN_MIN) limit = HAZARD_SCAN_MIN;
+
+    if (hazard_thread.retired.size() >= limit)
+        hazard_scan();
+}
+
+//------------------------------------------------------------------------------
+
+void hazard_scan ()
+{
+    std::vector<HazardRetired>& retired = hazard_thread.retired;
+
+    if (orphans_mutex.try_lock())
+    {
+        retired.insert(retired.end(), orphans.begin(), orphans.end());
+        orphans.clear();
+        orphans_mutex.unlock();
+    }
+
+    if (retired.empty()) return;
+
+    std::vector<void*> hazards;
+
+    size_t used = hazard_records_used.load();
+    for (size_t i = 0; i < used; ++i)
+    {
+        for (size_t j = 0; j < HAZARD_SLOTS_NUM; ++j)
+        {
+            void* ptr = hazard_records[i].slots[j].load();
+            if (ptr != nullptr) hazards.push_back(ptr);
+        }
+    }
+
+    std::sort(hazards.begin(), hazards.end());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < retired.size(); ++i)
+    {
+        if (std::binary_search(hazards.begin(), hazards.end(), retired[i].ptr))
+            retired[kept++] = retired[i];
+        else
+            retired[i].deleter(retired[i].ptr);
+    }
+
+    retired.resize(kept);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,84 @@
+/*------------------------------------------------------------------------------
+    * File:        Hazard.h                                                    *
+    * Description: Hazard pointers for safe memory reclamation in lock-free   *
+                   containers. A thread publishes the pointer it is going to   *
+                   read in its hazard slot, removed objects are retired and    *
+                   deleted only when no slot points to them.                   *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef HAZARD_H_INCLUDED
+#define HAZARD_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <stdlib.h>
+#include <atomic>
+
+
+static const size_t HAZARD_THREADS_NUM = 512;   // threads using hazard pointers at once
+static const size_t HAZARD_SLOTS_NUM   = 2;     // hazard slots of one thread
+static const size_t HAZARD_SCAN_MIN    = 64;    // retired objects of a thread before a scan
+
+//------------------------------------------------------------------------------
+/*! @brief   Get a hazard slot of the calling thread. The thread takes a free
+ *           record on the first call and gives it back when it exits.
+ *
+ *  @param   index       Index of the slot, less than HAZARD_SLOTS_NUM
+ *
+ *  @return  pointer to the slot
+ */
+
+std::atomic<void*>* hazard_slot (size_t index);
+
+//------------------------------------------------------------------------------
+/*! @brief   Retire an object removed from a container. It is deleted by the
+ *           deleter when no hazard slot points to it.
+ *
+ *  @param   ptr         Pointer to the object
+ *  @param   deleter     Function deleting the object
+ */
+
+void hazard_retire (void* ptr, void (*deleter)(void*));
+
+//------------------------------------------------------------------------------
+/*! @brief   Delete the retired objects of the calling thread which are not
+ *           protected by any hazard slot.
+ */
+
+void hazard_scan ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Read a shared pointer and protect it with a hazard slot. After the
+ *           call the object can be read until the slot is cleared.
+ *
+ *  @param   slot        Hazard slot of the calling thread
+ *  @param   src         Shared pointer
+ *
+ *  @return  protected value of the pointer
+ */
+
+template <typename TYPE>
+TYPE* hazard_protect (std::atomic<void*>* slot, const std::atomic<TYPE*>& src)
+{
+    TYPE* ptr = src.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        slot->store(ptr);
+
+        TYPE* again = src.load();
+        if (again == ptr) return ptr;
+
+        ptr = again;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+#endif // HAZARD_H_INCLUDED
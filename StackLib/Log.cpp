@@ -0,0 +1,527 @@
+/*------------------------------------------------------------------------------
+    * File:        Log.cpp                                                     *
+    * Description: Asynchronous log writer implementation.                     *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Log.h"
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+enum LogStates
+{
+    LOG_NOT_STARTED ,
+    LOG_RUNNING     ,
+    LOG_STOPPING    ,
+    LOG_STOPPED     ,
+};
+
+// a record takes consecutive slots, its first slot has the sizes; a record
+// larger than the queue takes one slot and keeps its bytes in heap
+struct LogSlot
+{
+    std::atomic<size_t> seq;
+    size_t              slots;
+    size_t              name_size;
+    size_t              size;
+    char*               heap;
+};
+
+struct LogFile
+{
+    char* name = nullptr;
+    FILE* fp   = nullptr;
+};
+
+static const size_t LOG_DATA_SIZE = LOG_QUEUE_SIZE * LOG_SLOT_SIZE;
+static const size_t LOG_NAME_MAX  = 4096;
+
+static LogSlot  log_queue [LOG_QUEUE_SIZE];
+static char     log_data  [LOG_DATA_SIZE];     // name and text of the records, slot i owns LOG_SLOT_SIZE bytes from i * LOG_SLOT_SIZE
+static LogFile  log_files [LOG_FILES_NUM];
+
+static std::atomic<size_t> enqueue_pos  (0);
+static std::atomic<size_t> dequeue_pos  (0);
+static std::atomic<size_t> flushed_pos  (0);
+static std::atomic<size_t> flush_target (0);
+
+static std::atomic<int>    log_state    (LOG_NOT_STARTED);
+static std::atomic<int>    log_policy   (LOG_BLOCK);
+static std::atomic<size_t> sample_rate  (16);
+static std::atomic<size_t> sample_count (0);
+static std::atomic<size_t> dropped_num  (0);
+static std::atomic<bool>   sleeping     (false);
+
+static std::once_flag           start_flag;
+static std::mutex               wake_mutex;
+static std::condition_variable  wake_cond;
+static std::thread*             writer = nullptr;
+
+//------------------------------------------------------------------------------
+
+static void log_write_sync (const char* logname, const char* text, size_t size)
+{
+    FILE* fp = fopen(logname, "a");
+    if (fp == nullptr)
+        return;
+
+    fwrite(text, 1, size, fp);
+    fclose(fp);
+}
+
+//------------------------------------------------------------------------------
+
+static FILE* log_file (const char* logname)
+{
+    for (size_t i = 0; i < LOG_FILES_NUM; ++i)
+    {
+        if ((log_files[i].name != nullptr) && (strcmp(log_files[i].name, logname) == 0))
+            return log_files[i].fp;
+    }
+
+    LogFile* file = &log_files[LOG_FILES_NUM - 1];
+    for (size_t i = 0; i < LOG_FILES_NUM; ++i)
+    {
+        if (log_files[i].name == nullptr)
+        {
+            file = &log_files[i];
+            break;
+        }
+    }
+
+    if (file->fp != nullptr) fclose(file->fp);
+    free(file->name);
+
+    file->name = strdup(logname);
+    file->fp   = fopen(logname, "a");
+
+    if (file->fp != nullptr)
+        setvbuf(file->fp, nullptr, _IOFBF, LOG_FILE_BUFSIZE);
+
+    return file->fp;
+}
+
+//------------------------------------------------------------------------------
+
+static void log_flush_files ()
+{
+    for (size_t i = 0; i < LOG_FILES_NUM; ++i)
+    {
+        if (log_files[i].fp != nullptr) fflush(log_files[i].fp);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void log_data_write (size_t offset, const void* src, size_t size)
+{
+    offset %= LOG_DATA_SIZE;
+
+    size_t first = (size < LOG_DATA_SIZE - offset) ? size : LOG_DATA_SIZE - offset;
+
+    memcpy(log_data + offset, src, first);
+    memcpy(log_data, (const char*)src + first, size - first);
+}
+
+//------------------------------------------------------------------------------
+
+static void log_data_read (size_t offset, void* dst, size_t size)
+{
+    offset %= LOG_DATA_SIZE;
+
+    size_t first = (size < LOG_DATA_SIZE - offset) ? size : LOG_DATA_SIZE - offset;
+
+    memcpy(dst, log_data + offset, first);
+    memcpy((char*)dst + first, log_data, size - first);
+}
+
+//------------------------------------------------------------------------------
+
+static void log_data_fwrite (size_t offset, size_t size, FILE* fp)
+{
+    offset %= LOG_DATA_SIZE;
+
+    size_t first = (size < LOG_DATA_SIZE - offset) ? size : LOG_DATA_SIZE - offset;
+
+    fwrite(log_data + offset, 1, first, fp);
+    if (size > first) fwrite(log_data, 1, size - first, fp);
+}
+
+//------------------------------------------------------------------------------
+
+static bool log_pop ()
+{
+    static char logname[LOG_NAME_MAX] = "";
+
+    size_t   pos  = dequeue_pos.load(std::memory_order_relaxed);
+    LogSlot* slot = &log_queue[pos % LOG_QUEUE_SIZE];
+
+    if (slot->seq.load(std::memory_order_acquire) != pos + 1)
+        return false;
+
+    size_t slots  = slot->slots;
+    size_t offset = pos % LOG_QUEUE_SIZE * LOG_SLOT_SIZE;
+
+    if (slot->heap != nullptr)
+    {
+        FILE* fp = log_file(slot->heap);
+        if (fp != nullptr) fwrite(slot->heap + slot->name_size, 1, slot->size, fp);
+
+        free(slot->heap);
+        slot->heap = nullptr;
+    }
+    else if (slot->name_size != 0)
+    {
+        log_data_read(offset, logname, slot->name_size);
+
+        FILE* fp = log_file(logname);
+        if (fp != nullptr) log_data_fwrite(offset + slot->name_size, slot->size, fp);
+    }
+
+    // in order, so a free last slot of a record means all its slots are free
+    for (size_t i = 0; i < slots; ++i)
+        log_queue[(pos + i) % LOG_QUEUE_SIZE].seq.store(pos + i + LOG_QUEUE_SIZE, std::memory_order_release);
+
+    dequeue_pos.store(pos + slots, std::memory_order_release);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool log_push (const char* logname, size_t name_size, const char* text, size_t size)
+{
+    bool   large = (name_size > LOG_NAME_MAX) || (name_size + size > LOG_DATA_SIZE);
+    size_t slots = large ? 1 : (name_size + size + LOG_SLOT_SIZE - 1) / LOG_SLOT_SIZE;
+    size_t pos   = enqueue_pos.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        LogSlot* slot = &log_queue[pos % LOG_QUEUE_SIZE];
+        LogSlot* last = &log_queue[(pos + slots - 1) % LOG_QUEUE_SIZE];
+        long     diff = (long)slot->seq.load(std::memory_order_acquire) - (long)pos;
+
+        if (diff == 0)
+        {
+            if ((long)last->seq.load(std::memory_order_acquire) - (long)(pos + slots - 1) < 0)
+                return false;
+
+            if (enqueue_pos.compare_exchange_weak(pos, pos + slots, std::memory_order_relaxed))
+            {
+                size_t offset = pos % LOG_QUEUE_SIZE * LOG_SLOT_SIZE;
+
+                slot->slots     = slots;
+                slot->name_size = name_size;
+                slot->size      = size;
+                slot->heap      = nullptr;
+
+                if (large)
+                {
+                    slot->heap = (char*)malloc(name_size + size);
+
+                    if (slot->heap != nullptr)
+                    {
+                        memcpy(slot->heap,             logname, name_size);
+                        memcpy(slot->heap + name_size, text,    size);
+                    }
+                    else
+                    {
+                        // the slot is taken already, it is skipped by the writer
+                        dropped_num++;
+
+                        slot->name_size = 0;
+                        slot->size      = 0;
+                    }
+                }
+                else
+                {
+                    log_data_write(offset,             logname, name_size);
+                    log_data_write(offset + name_size, text,    size);
+                }
+
+                // the first slot is published last, the writer reads the record after it
+                for (size_t i = 1; i < slots; ++i)
+                    log_queue[(pos + i) % LOG_QUEUE_SIZE].seq.store(pos + i + 1, std::memory_order_release);
+
+                slot->seq.store(pos + 1, std::memory_order_release);
+
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void log_wake ()
+{
+    if (sleeping.load(std::memory_order_acquire))
+        wake_cond.notify_one();
+}
+
+//------------------------------------------------------------------------------
+
+static void log_writer ()
+{
+    const size_t batch_size = 256;
+
+    while (true)
+    {
+        size_t written = 0;
+
+        while ((written < batch_size) && log_pop()) ++written;
+
+        bool empty = (dequeue_pos.load() == enqueue_pos.load());
+
+        if (empty || (flush_target.load() > flushed_pos.load()))
+        {
+            log_flush_files();
+            flushed_pos.store(dequeue_pos.load());
+        }
+
+        if (! empty) continue;
+
+        if (log_state.load() == LOG_STOPPING)
+            break;
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        sleeping.store(true);
+        if (dequeue_pos.load() == enqueue_pos.load())
+            wake_cond.wait_for(lock, std::chrono::milliseconds(1));
+        sleeping.store(false);
+    }
+
+    for (size_t i = 0; i < LOG_FILES_NUM; ++i)
+    {
+        if (log_files[i].fp != nullptr) fclose(log_files[i].fp);
+        free(log_files[i].name);
+
+        log_files[i].fp   = nullptr;
+        log_files[i].name = nullptr;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void log_shutdown ()
+{
+    if (log_state.load() != LOG_RUNNING)
+        return;
+
+    log_state.store(LOG_STOPPING);
+    wake_cond.notify_one();
+
+    writer->join();
+    delete writer;
+    writer = nullptr;
+
+    log_state.store(LOG_STOPPED);
+}
+
+//------------------------------------------------------------------------------
+
+static void log_start ()
+{
+    for (size_t i = 0; i < LOG_QUEUE_SIZE; ++i)
+    {
+        log_queue[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    writer = new std::thread(log_writer);
+    log_state.store(LOG_RUNNING);
+
+    atexit(log_shutdown);
+}
+
+//------------------------------------------------------------------------------
+
+int buf_printf (LogBuffer* buf, const char* format, ...)
+{
+    assert(buf    != nullptr);
+    assert(format != nullptr);
+
+    va_list args;
+
+    while (true)
+    {
+        va_start(args, format);
+        int len = vsnprintf(buf->data + buf->size, buf->capacity - buf->size, format, args);
+        va_end(args);
+
+        if (len < 0)
+            return -1;
+
+        if (buf->size + len < buf->capacity)
+        {
+            buf->size += len;
+            return len;
+        }
+
+        size_t capacity = (buf->capacity == 0) ? 1024 : buf->capacity * 2;
+        while (capacity <= buf->size + len) capacity *= 2;
+
+        char* data = (char*)realloc(buf->data, capacity);
+        if (data == nullptr)
+            return -1;
+
+        buf->data     = data;
+        buf->capacity = capacity;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int buf_write (LogBuffer* buf, const void* data, size_t size)
+{
+    assert(buf != nullptr);
+
+    if (size == 0)
+        return 0;
+
+    char* end = buf_reserve(buf, size);
+    if (end == nullptr)
+        return -1;
+
+    memcpy(end, data, size);
+    buf->size += size;
+
+    return (int)size;
+}
+
+//------------------------------------------------------------------------------
+
+char* buf_reserve (LogBuffer* buf, size_t size)
+{
+    assert(buf != nullptr);
+
+    if (buf->size + size > buf->capacity)
+    {
+        size_t capacity = (buf->capacity == 0) ? 1024 : buf->capacity * 2;
+        while (capacity < buf->size + size) capacity *= 2;
+
+        char* newdata = (char*)realloc(buf->data, capacity);
+        if (newdata == nullptr)
+            return nullptr;
+
+        buf->data     = newdata;
+        buf->capacity = capacity;
+    }
+
+    return buf->data + buf->size;
+}
+
+//------------------------------------------------------------------------------
+
+int log_write (const char* logname, const char* text, size_t size)
+{
+    assert(logname != nullptr);
+    assert(text    != nullptr);
+
+    std::call_once(start_flag, log_start);
+
+    if (log_state.load(std::memory_order_acquire) != LOG_RUNNING)
+    {
+        log_write_sync(logname, text, size);
+        return 1;
+    }
+
+    size_t name_size = strlen(logname) + 1;
+
+    if (! log_push(logname, name_size, text, size))
+    {
+        int policy = log_policy.load(std::memory_order_relaxed);
+
+        if ((policy == LOG_DROP) ||
+            ((policy == LOG_SAMPLE) && (sample_count++ % sample_rate.load() != 0)))
+        {
+            dropped_num++;
+
+            return 0;
+        }
+
+        do
+        {
+            wake_cond.notify_one();
+            std::this_thread::yield();
+        }
+        while (! log_push(logname, name_size, text, size));
+    }
+
+    log_wake();
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+
+int log_printf (const char* logname, const char* format, ...)
+{
+    assert(format != nullptr);
+
+    char text[1024] = "";
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (len < 0)
+        return 0;
+
+    if ((size_t)len >= sizeof(text)) len = sizeof(text) - 1;
+
+    return log_write(logname, text, len);
+}
+
+//------------------------------------------------------------------------------
+
+void log_flush ()
+{
+    if (log_state.load() != LOG_RUNNING)
+        return;
+
+    size_t target = enqueue_pos.load();
+
+    size_t prev = flush_target.load();
+    while ((prev < target) && ! flush_target.compare_exchange_weak(prev, target));
+
+    while (flushed_pos.load() < target)
+    {
+        wake_cond.notify_one();
+        std::this_thread::yield();
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void log_set_policy (int policy, size_t rate)
+{
+    log_policy.store(policy);
+    sample_rate.store((rate == 0) ? 1 : rate);
+}
+
+//------------------------------------------------------------------------------
+
+size_t log_dropped ()
+{
+    return dropped_num.load();
+}
+
+//------------------------------------------------------------------------------
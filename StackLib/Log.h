@@ -0,0 +1,137 @@
+/*------------------------------------------------------------------------------
+    * File:        Log.h                                                       *
+    * Description: Asynchronous log writer. Records are put into a lock-free   *
+                   ring buffer and written to log files by a background        *
+                   thread with large buffered writes.                          *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef LOG_H_INCLUDED
+#define LOG_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+
+static const size_t LOG_QUEUE_SIZE   = 4096;
+static const size_t LOG_SLOT_SIZE    = 256;     // a record takes as many slots as its name and text need
+static const size_t LOG_FILE_BUFSIZE = 1 << 20;
+static const size_t LOG_FILES_NUM    = 8;
+
+enum LogPolicies
+{
+    LOG_BLOCK  ,
+    LOG_DROP   ,
+    LOG_SAMPLE ,
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Growing text buffer for building a log record.
+ */
+
+struct LogBuffer
+{
+    char*  data     = nullptr;
+    size_t size     = 0;
+    size_t capacity = 0;
+
+   ~LogBuffer () { free(data); }
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Formatted print to the end of a log buffer.
+ *
+ *  @param   buf         Log buffer
+ *  @param   format      Format string as in printf
+ *
+ *  @return  number of printed characters, -1 if error
+ */
+
+int buf_printf (LogBuffer* buf, const char* format, ...);
+
+//------------------------------------------------------------------------------
+/*! @brief   Write raw bytes to the end of a log buffer.
+ *
+ *  @param   buf         Log buffer
+ *  @param   data        Bytes to write
+ *  @param   size        Number of bytes
+ *
+ *  @return  number of written bytes, -1 if error
+ */
+
+int buf_write (LogBuffer* buf, const void* data, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Make room for size bytes at the end of a log buffer. The caller
+ *           writes them and adds the number of written ones to buf->size.
+ *
+ *  @param   buf         Log buffer
+ *  @param   size        Number of bytes
+ *
+ *  @return  pointer to the end of the buffer, nullptr if error
+ */
+
+char* buf_reserve (LogBuffer* buf, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Put a record to the log queue. The text is copied into the
+ *           slots of the queue, nothing is copied if the record is dropped.
+ *           Only a record larger than the whole queue is copied to the heap.
+ *
+ *  @param   logname     Name of the log file
+ *  @param   text        Record text
+ *  @param   size        Record size
+ *
+ *  @return  1 if the record was queued or written, 0 if it was dropped
+ */
+
+int log_write (const char* logname, const char* text, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Formatted print to the log queue.
+ *
+ *  @param   logname     Name of the log file
+ *  @param   format      Format string as in printf
+ *
+ *  @return  1 if the record was queued or written, 0 if it was dropped
+ */
+
+int log_printf (const char* logname, const char* format, ...);
+
+//------------------------------------------------------------------------------
+/*! @brief   Wait until every queued record is written to its file and the
+ *           files are flushed. Must be called before exit on fatal errors.
+ */
+
+void log_flush ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Set what to do with a record when the queue is full.
+ *
+ *  @param   policy      LOG_BLOCK - wait for a free place,
+ *                       LOG_DROP  - drop the record,
+ *                       LOG_SAMPLE - keep every rate-th record, drop others
+ *  @param   rate        Sampling rate for LOG_SAMPLE
+ */
+
+void log_set_policy (int policy, size_t rate = 16);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the number of dropped records.
+ *
+ *  @return  number of dropped records
+ */
+
+size_t log_dropped ();
+
+//------------------------------------------------------------------------------
+
+#endif // LOG_H_INCLUDED
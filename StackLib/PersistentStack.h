@@ -0,0 +1,383 @@
+/*------------------------------------------------------------------------------
+    * File:        PersistentStack.h                                           *
+    * Description: Stack kept in a memory mapped file. The header fields and  *
+                   the data live in the file, so reopening takes no time and   *
+                   no deserialization, the hashes tell a torn or corrupted     *
+                   file from a good one.                                       *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef PERSISTENT_STACK_H_INCLUDED
+#define PERSISTENT_STACK_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+
+#include "Stack.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+const uint64_t PERSISTENT_MAGIC       = 0x4B545350;    // "PSTK"
+const uint32_t PERSISTENT_VERSION     = 1;
+const size_t   PERSISTENT_HEADER_SIZE = 4096;          // data starts on the next page
+
+enum PersistentFlags
+{
+    PERSISTENT_FLAG_HASH   = 1 ,                        // block hashes and datahash are valid
+    PERSISTENT_FLAG_POISON = 2 ,                        // slots over the size are POISON
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Header at the beginning of a stack file. The file is the header,
+ *           the data of capacity values and the array of block hashes.
+ */
+
+struct PersistentHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    uint16_t type_tag;
+    uint16_t elem_size;
+    uint64_t capacity;
+    uint64_t size;
+    uint64_t flags;
+    hash_t   datahash;
+    hash_t   stackhash;     // hash of the fields above
+};
+
+#define newPersistentStack(NAME, STK_TYPE, ...) \
+        PersistentStack<STK_TYPE, ##__VA_ARGS__> NAME ((char*)#NAME);
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Stack of TYPE values in a memory mapped file. Every operation
+ *           changes the mapping in place: the value, its block hash, the data
+ *           hash, the size and the header hash, in this order, so a crash
+ *           between them leaves hashes that do not match. Open checks the
+ *           header and the blocks near the top like Check does, Recover
+ *           rebuilds the hashes of a torn file. Changes reach the disk when
+ *           the kernel writes the pages back or on Sync.
+ *
+ *  @tparam  TYPE        Type of values, trivially copyable
+ *  @tparam  POLICY      Protection policy (see StackConfig.h)
+ */
+
+template <typename TYPE, typename POLICY = Checked>
+class PersistentStack
+{
+    static_assert(std::is_trivially_copyable<TYPE>::value, "persistent stack values must be trivially copyable");
+
+private:
+
+    char* name_ = nullptr;
+    int   fd_   = -1;
+
+    PersistentHeader* header_    = nullptr;
+    TYPE*             data_      = nullptr;
+    hash_t*           blockhash_ = nullptr;
+    size_t            map_size_  = 0;
+
+    size_t max_capacity_ = MAX_CAPACITY;
+    double growth_       = DEFAULT_STACK_GROWTH;
+
+    int id_ = 0;
+    int errCode_;
+
+public:
+
+//------------------------------------------------------------------------------
+/*! @brief   Persistent stack constructor, the stack is not opened.
+ *
+ *  @param   stack_name  Stack variable name
+ */
+
+    PersistentStack (char* stack_name);
+
+    PersistentStack (const PersistentStack& obj) = delete;
+
+    PersistentStack& operator = (const PersistentStack& obj) = delete;
+
+//------------------------------------------------------------------------------
+/*! @brief   Persistent stack destructor, closes the file.
+ */
+
+   ~PersistentStack ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Open a stack file, it is created if it does not exist or is empty.
+ *
+ *  @param   filename    Name of the file
+ *  @param   capacity    Capacity of a new stack
+ *
+ *  @return  STACK_OK, STACK_FILE_ERROR if the file can not be opened or
+ *           mapped, STACK_FILE_WRONG_FORMAT if it is not a stack of TYPE,
+ *           STACK_INCORRECT_HASH, STACK_SIZE_BIGGER_CAPACITY or
+ *           STACK_WRONG_CUR_SIZE if it is torn or corrupted. A torn or
+ *           corrupted file stays open for Recover.
+ */
+
+    int Open (const char* filename, size_t capacity = DEFAULT_STACK_CAPACITY);
+
+//------------------------------------------------------------------------------
+/*! @brief   Make a torn or corrupted file consistent: the capacity is taken
+ *           from the file size, values up to the stored size are kept and
+ *           all hashes are recalculated. Values are not checked, the last
+ *           one may be torn.
+ *
+ *  @return  error code
+ */
+
+    int Recover ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Unmap and close the file.
+ *
+ *  @return  error code
+ */
+
+    int Close ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Write the changed pages to the disk and wait for it.
+ *
+ *  @return  error code
+ */
+
+    int Sync ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Pushing a value onto the stack.
+ *
+ *  @param   value       Value to push
+ *
+ *  @return  error code, STACK_FULL if the maximum capacity is reached
+ */
+
+    int Push (const TYPE& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping from stack.
+ *
+ *  @return  value from the stack if present, otherwise POISON (default
+ *           constructed value for types without POISON)
+ */
+
+    TYPE Pop ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the current size of the stack.
+ *
+ *  @return  size
+ */
+
+    size_t getSize () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the capacity of the stack file.
+ *
+ *  @return  capacity
+ */
+
+    size_t getCapacity () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get name of the stack.
+ *
+ *  @return  stack name
+ */
+
+    const char* getName () const;
+
+    const TYPE& operator [] (size_t n) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Full stack check, including the hash of every data block.
+ *
+ *  @return  error code
+ */
+
+    int Verify ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Print the contents of the stack and its data to the logfile.
+ *
+ *  @param   funcname    Name of the function from which the dump was called
+ *  @param   logfile     Name of the logfile
+ *
+ *  @return  error code
+ */
+
+    int Dump (const char* funcname = nullptr, const char* logfile = STACK_LOGNAME);
+
+/*------------------------------------------------------------------------------
+                   Private functions                                           *
+*///----------------------------------------------------------------------------
+
+private:
+
+//------------------------------------------------------------------------------
+/*! @brief   Size of the data in a stack file, the block hashes after it are
+ *           aligned.
+ *
+ *  @param   capacity    Capacity of the stack
+ *
+ *  @return  size in bytes
+ */
+
+    static size_t DataSize (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Size of a stack file.
+ *
+ *  @param   capacity    Capacity of the stack
+ *
+ *  @return  size in bytes
+ */
+
+    static size_t FileSize (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   The biggest capacity of a stack that fits in a file.
+ *
+ *  @param   file_size   Size of the file
+ *
+ *  @return  capacity, 0 if even the smallest stack does not fit
+ */
+
+    static size_t FitCapacity (size_t file_size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Map the file and set the pointers to its parts.
+ *
+ *  @param   size        Size of the file
+ *  @param   capacity    Capacity of the stack in the file
+ *
+ *  @return  error code
+ */
+
+    int Map (size_t size, size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Increase the file by the growth factor, but not over the maximum
+ *           capacity.
+ *
+ *  @return  error code, STACK_FULL if the stack can not grow
+ */
+
+    int Expand ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Filling the slots from first to last (not including) with POISON.
+ *
+ *  @param   first       Index of the first slot
+ *  @param   last        Index after the last slot
+ */
+
+    void fillPoison (size_t first, size_t last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Make the flags of the file match the policy: poison the free slots
+ *           and calculate the hashes the file has no valid ones of, clear the
+ *           flags of what the policy does not keep up.
+ *
+ *  @param   rebuild     If true, poison and rehash even if the flags are set
+ */
+
+    void SetFlags (bool rebuild);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check stack for problems and hash (if enabled).
+ *
+ *  @param   full        If false, only the data blocks near the top are verified
+ *
+ *  @return  error code
+ */
+
+    int Check (bool full = false);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the hash of the header fields before stackhash. Like
+ *           block hashes, it does not depend on the hash engine of the process.
+ *
+ *  @return  header hash
+ */
+
+    hash_t HeaderHash () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the number of hash blocks covering capacity values.
+ *
+ *  @param   capacity    Capacity
+ *
+ *  @return  number of blocks
+ */
+
+    static size_t BlocksNum (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the hash of one data block.
+ *
+ *  @param   block       Index of the block
+ *
+ *  @return  block hash
+ */
+
+    hash_t BlockHash (size_t block) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of all data blocks and the data hash.
+ */
+
+    void RehashData ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of the blocks covering slots from first to last
+ *           and updates the data hash in place.
+ *
+ *  @param   first       Index of the first changed slot
+ *  @param   last        Index of the last changed slot
+ */
+
+    void RehashSlots (size_t first, size_t last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Checks hashes of the blocks covering slots from first to last.
+ *
+ *  @param   first       Index of the first slot
+ *  @param   last        Index of the last slot
+ *
+ *  @return  true if all the blocks are correct
+ */
+
+    bool CheckSlots (size_t first, size_t last) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Set the size and write the header hash, the last step of every
+ *           change.
+ *
+ *  @param   size        New size
+ */
+
+    void Commit (size_t size);
+
+//------------------------------------------------------------------------------
+};
+
+//------------------------------------------------------------------------------
+
+#include "PersistentStack.ipp"
+
+#endif // __linux__
+
+#endif // PERSISTENT_STACK_H_INCLUDED
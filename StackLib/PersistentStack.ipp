@@ -0,0 +1,591 @@
+/*------------------------------------------------------------------------------
+    * File:        PersistentStack.ipp                                         *
+    * Description: Implementations of persistent stack functions.              *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+PersistentStack<TYPE, POLICY>::PersistentStack (char* stack_name) :
+    name_    (stack_name),
+    id_      (stack_id++),
+    errCode_ (STACK_NOT_CONSTRUCTED)
+{
+    STACK_ASSERTOK((stack_name == nullptr), STACK_WRONG_INPUT_STACK_NAME);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+PersistentStack<TYPE, POLICY>::~PersistentStack ()
+{
+    Close();
+
+    errCode_ = STACK_DESTRUCTED;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Open (const char* filename, size_t capacity)
+{
+    if (filename == nullptr) return STACK_FILE_ERROR;
+
+    Close();
+
+    fd_ = open(filename, O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) return STACK_FILE_ERROR;
+
+    struct stat st = {};
+    if (fstat(fd_, &st) != 0)
+    {
+        Close();
+        return STACK_FILE_ERROR;
+    }
+
+    size_t file_size = (size_t)st.st_size;
+
+    if (file_size == 0)
+    {
+        if ((capacity < 2) || (capacity > max_capacity_))
+        {
+            Close();
+            return (capacity > max_capacity_) ? STACK_WRONG_INPUT_CAPACITY_VALUE_BIG : STACK_WRONG_INPUT_CAPACITY_VALUE_NIL;
+        }
+
+        if ((ftruncate(fd_, FileSize(capacity)) != 0) || (Map(FileSize(capacity), capacity) != STACK_OK))
+        {
+            Close();
+            return STACK_FILE_ERROR;
+        }
+
+        header_->magic     = PERSISTENT_MAGIC;
+        header_->version   = PERSISTENT_VERSION;
+        header_->type_tag  = TYPE_TAG<TYPE>;
+        header_->elem_size = sizeof(TYPE);
+        header_->capacity  = capacity;
+
+        SetFlags(true);
+    }
+    else
+    {
+        if ((file_size < FileSize(2)) || (Map(file_size, 2) != STACK_OK))
+        {
+            Close();
+            return (file_size < FileSize(2)) ? STACK_FILE_WRONG_FORMAT : STACK_FILE_ERROR;
+        }
+
+        if ((header_->magic     != PERSISTENT_MAGIC)   ||
+            (header_->version   != PERSISTENT_VERSION) ||
+            (header_->type_tag  != TYPE_TAG<TYPE>)     ||
+            (header_->elem_size != sizeof(TYPE)))
+        {
+            Close();
+            return STACK_FILE_WRONG_FORMAT;
+        }
+
+        // a file torn while growing has the capacity of its header or of its size
+        size_t stored = header_->capacity;
+        Map(file_size, ((stored <= max_capacity_) && (FileSize(stored) <= file_size)) ? stored : FitCapacity(file_size));
+    }
+
+    errCode_ = STACK_OK;
+
+    if (Check() != STACK_OK)
+    {
+        if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+        return errCode_;
+    }
+
+    // the file may be written by another policy
+    SetFlags(false);
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Recover ()
+{
+    if (header_ == nullptr) return STACK_NOT_CONSTRUCTED;
+
+    size_t capacity = FitCapacity(map_size_);
+
+    if (FileSize(capacity) != map_size_)
+    {
+        if ((ftruncate(fd_, FileSize(capacity)) != 0) || (Map(FileSize(capacity), capacity) != STACK_OK))
+            return STACK_FILE_ERROR;
+    }
+    else Map(map_size_, capacity);
+
+    size_t size = header_->size;
+    if (size >= capacity) size = capacity - 1;
+
+    header_->capacity = capacity;
+    header_->size     = size;
+
+    SetFlags(true);
+
+    errCode_ = STACK_OK;
+
+    Check(true);
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return errCode_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Close ()
+{
+    int err = STACK_OK;
+
+    if (header_ != nullptr)
+    {
+        if (munmap(header_, map_size_) != 0) err = STACK_FILE_ERROR;
+
+        header_    = nullptr;
+        data_      = nullptr;
+        blockhash_ = nullptr;
+        map_size_  = 0;
+    }
+
+    if (fd_ >= 0)
+    {
+        if (close(fd_) != 0) err = STACK_FILE_ERROR;
+
+        fd_ = -1;
+    }
+
+    errCode_ = STACK_NOT_CONSTRUCTED;
+
+    return err;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Sync ()
+{
+    if (header_ == nullptr) return STACK_NOT_CONSTRUCTED;
+
+    return (msync(header_, map_size_, MS_SYNC) == 0) ? STACK_OK : STACK_FILE_ERROR;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Push (const TYPE& value)
+{
+    STACK_ASSERTOK((header_ == nullptr), STACK_NOT_CONSTRUCTED);
+
+    STACK_CHECK;
+
+    // value may be in the mapping, which moves when the file grows
+    TYPE copy = value;
+
+    size_t size = header_->size;
+
+    if (size == header_->capacity - 1)
+    {
+        if (Expand() != STACK_OK)
+        {
+            errCode_ = STACK_FULL;
+
+            if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+            return STACK_FULL;
+        }
+    }
+
+    data_[size] = copy;
+
+    if constexpr (POLICY::hash) RehashSlots(size, size);
+
+    Commit(size + 1);
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+TYPE PersistentStack<TYPE, POLICY>::Pop ()
+{
+    STACK_ASSERTOK((header_ == nullptr), STACK_NOT_CONSTRUCTED);
+
+    STACK_CHECK;
+
+    size_t size = header_->size;
+
+    if (size == 0)
+    {
+        errCode_ = STACK_EMPTY_STACK;
+
+        if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+        if constexpr (HAS_POISON<TYPE>) return POISON<TYPE>;
+        else                            return TYPE ();
+    }
+
+    TYPE value = data_[size - 1];
+
+    fillPoison(size - 1, size);
+
+    if constexpr (POLICY::hash) RehashSlots(size - 1, size - 1);
+
+    Commit(size - 1);
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return value;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t PersistentStack<TYPE, POLICY>::getSize () const
+{
+    return (header_ != nullptr) ? header_->size : 0;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t PersistentStack<TYPE, POLICY>::getCapacity () const
+{
+    return (header_ != nullptr) ? header_->capacity : 0;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+const char* PersistentStack<TYPE, POLICY>::getName () const
+{
+    return name_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+const TYPE& PersistentStack<TYPE, POLICY>::operator [] (size_t n) const
+{
+    STACK_ASSERTOK((header_ == nullptr), STACK_NOT_CONSTRUCTED);
+
+    if constexpr (POLICY::check) STACK_ASSERTOK((n >= header_->size), STACK_MEM_ACCESS_VIOLATION);
+
+    return data_[n];
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Verify ()
+{
+    return Check(true);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Dump (const char* funcname, const char* logfile)
+{
+    DumpStack stk = {};
+    DumpState<TYPE>(&stk, this, data_, getCapacity(), getSize(), id_, errCode_);
+
+    if ((header_ != nullptr) && (header_->flags & PERSISTENT_FLAG_HASH))
+    {
+        stk.flags     |= DUMP_FLAG_HASH;
+        stk.stackhash  = header_->stackhash;
+        stk.datahash   = header_->datahash;
+    }
+
+    const TYPE* data = ((header_ == nullptr) || dump_is_broken(errCode_)) ? nullptr : data_;
+
+    return DumpText<TYPE>(&stk, funcname, name_, logfile, DumpArray<TYPE> { data, stk.capacity });
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t PersistentStack<TYPE, POLICY>::DataSize (size_t capacity)
+{
+    return (capacity * sizeof(TYPE) + sizeof(hash_t) - 1) / sizeof(hash_t) * sizeof(hash_t);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t PersistentStack<TYPE, POLICY>::FileSize (size_t capacity)
+{
+    return PERSISTENT_HEADER_SIZE + DataSize(capacity) + BlocksNum(capacity) * sizeof(hash_t);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t PersistentStack<TYPE, POLICY>::FitCapacity (size_t file_size)
+{
+    if (file_size < FileSize(2)) return 0;
+
+    size_t capacity = (size_t)((file_size - PERSISTENT_HEADER_SIZE) /
+                               (sizeof(TYPE) + (double)sizeof(hash_t) * sizeof(TYPE) / HASH_BLOCK_SIZE));
+
+    while ((capacity > 2) && (FileSize(capacity) > file_size)) --capacity;
+    while (FileSize(capacity + 1) <= file_size) ++capacity;
+
+    return capacity;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Map (size_t size, size_t capacity)
+{
+    assert(FileSize(capacity) <= size);
+
+    void* base = (header_ == nullptr) ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0)
+                                      : mremap(header_, map_size_, size, MREMAP_MAYMOVE);
+
+    if (base == MAP_FAILED) return STACK_FILE_ERROR;
+
+    header_    = (PersistentHeader*)base;
+    map_size_  = size;
+    data_      = (TYPE*)  ((char*)base + PERSISTENT_HEADER_SIZE);
+    blockhash_ = (hash_t*)((char*)base + PERSISTENT_HEADER_SIZE + DataSize(capacity));
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Expand ()
+{
+    size_t old_capacity = header_->capacity;
+
+    if (old_capacity >= max_capacity_) return STACK_FULL;
+
+    double next     = old_capacity * growth_;
+    size_t capacity = (next >= (double)max_capacity_)   ? max_capacity_ :
+                      ((size_t)next > old_capacity)     ? (size_t)next  : old_capacity + 1;
+
+    STACK_ASSERTOK((ftruncate(fd_, FileSize(capacity)) != 0),         STACK_FILE_ERROR);
+    STACK_ASSERTOK((Map(FileSize(capacity), capacity) != STACK_OK),   STACK_FILE_ERROR);
+
+    header_->capacity = capacity;
+
+    fillPoison(old_capacity, capacity);
+
+    // the block hashes moved with the end of the data
+    if constexpr (POLICY::hash) RehashData();
+
+    Commit(header_->size);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void PersistentStack<TYPE, POLICY>::fillPoison (size_t first, size_t last)
+{
+    assert(data_ != nullptr);
+
+    if constexpr (! POLICY::poison) return;
+
+    else if constexpr (HAS_POISON<TYPE>)
+    {
+        poison_fill(data_ + first, last - first);
+    }
+
+    else
+    {
+        memset((void*)(data_ + first), 0, (last - first) * sizeof(TYPE));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void PersistentStack<TYPE, POLICY>::SetFlags (bool rebuild)
+{
+    uint64_t flags = header_->flags;
+
+    if constexpr (POLICY::poison)
+    {
+        if (rebuild || ! (flags & PERSISTENT_FLAG_POISON)) fillPoison(header_->size, header_->capacity);
+
+        header_->flags |= PERSISTENT_FLAG_POISON;
+    }
+    else header_->flags &= ~(uint64_t)PERSISTENT_FLAG_POISON;
+
+    if constexpr (POLICY::hash)
+    {
+        if (rebuild || (header_->flags != flags) || ! (flags & PERSISTENT_FLAG_HASH)) RehashData();
+
+        header_->flags |= PERSISTENT_FLAG_HASH;
+    }
+    else header_->flags &= ~(uint64_t)PERSISTENT_FLAG_HASH;
+
+    if (rebuild || (header_->flags != flags)) Commit(header_->size);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int PersistentStack<TYPE, POLICY>::Check (bool full)
+{
+    if (header_ == nullptr)
+    {
+        return STACK_NOT_CONSTRUCTED;
+    }
+
+    else if (header_->stackhash != HeaderHash())
+    {
+        errCode_ = STACK_INCORRECT_HASH;
+    }
+
+    else if ((header_->capacity < 2) || (header_->capacity > max_capacity_) || (FileSize(header_->capacity) != map_size_))
+    {
+        errCode_ = STACK_CAPACITY_WRONG_VALUE;
+    }
+
+    else if (header_->size >= header_->capacity)
+    {
+        errCode_ = STACK_SIZE_BIGGER_CAPACITY;
+    }
+
+    else if ((header_->flags & PERSISTENT_FLAG_POISON) && HAS_POISON<TYPE> && ! isPOISON(data_[header_->size]))
+    {
+        errCode_ = STACK_WRONG_CUR_SIZE;
+    }
+
+    else if ((header_->flags & PERSISTENT_FLAG_HASH) &&
+             ((full || POLICY::full) ? ! CheckSlots(0, header_->capacity - 1)
+                                     : ! CheckSlots((header_->size == 0) ? 0 : header_->size - 1, header_->size)))
+    {
+        errCode_ = STACK_INCORRECT_HASH;
+    }
+
+    else
+    {
+        errCode_ = STACK_OK;
+    }
+
+    return errCode_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+hash_t PersistentStack<TYPE, POLICY>::HeaderHash () const
+{
+    return hash_stable(header_, offsetof(PersistentHeader, stackhash));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t PersistentStack<TYPE, POLICY>::BlocksNum (size_t capacity)
+{
+    return (capacity * sizeof(TYPE) + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+hash_t PersistentStack<TYPE, POLICY>::BlockHash (size_t block) const
+{
+    size_t offset = block * HASH_BLOCK_SIZE;
+    size_t size   = header_->capacity * sizeof(TYPE) - offset;
+
+    if (size > HASH_BLOCK_SIZE) size = HASH_BLOCK_SIZE;
+
+    return hash_stable((char*)data_ + offset, size);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void PersistentStack<TYPE, POLICY>::RehashData ()
+{
+    size_t blocks_num = BlocksNum(header_->capacity);
+
+    hash_t datahash = 0;
+    for (size_t block = 0; block < blocks_num; ++block)
+    {
+        blockhash_[block] = BlockHash(block);
+        datahash ^= hash_mix(blockhash_[block], block);
+    }
+
+    header_->datahash = datahash;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void PersistentStack<TYPE, POLICY>::RehashSlots (size_t first, size_t last)
+{
+    assert(first <= last);
+    assert(last  <  header_->capacity);
+
+    size_t first_block = first * sizeof(TYPE) / HASH_BLOCK_SIZE;
+    size_t last_block  = ((last + 1) * sizeof(TYPE) - 1) / HASH_BLOCK_SIZE;
+
+    for (size_t block = first_block; block <= last_block; ++block)
+    {
+        hash_t block_hash = BlockHash(block);
+
+        header_->datahash ^= hash_mix(blockhash_[block], block) ^ hash_mix(block_hash, block);
+        blockhash_[block]  = block_hash;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+bool PersistentStack<TYPE, POLICY>::CheckSlots (size_t first, size_t last) const
+{
+    size_t first_block = first * sizeof(TYPE) / HASH_BLOCK_SIZE;
+    size_t last_block  = ((last + 1) * sizeof(TYPE) - 1) / HASH_BLOCK_SIZE;
+
+    hash_t datahash = 0;
+    for (size_t block = first_block; block <= last_block; ++block)
+    {
+        if (blockhash_[block] != BlockHash(block)) return false;
+
+        datahash ^= hash_mix(blockhash_[block], block);
+    }
+
+    if ((first_block == 0) && (last_block == BlocksNum(header_->capacity) - 1))
+        return (datahash == header_->datahash);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void PersistentStack<TYPE, POLICY>::Commit (size_t size)
+{
+    header_->size      = size;
+    header_->stackhash = HeaderHash();
+}
+
+//------------------------------------------------------------------------------
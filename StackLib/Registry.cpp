@@ -0,0 +1,210 @@
+/*------------------------------------------------------------------------------
+    * File:        Registry.cpp                                                *
+    * Description: Registry of live stacks and their parallel verification.   *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Registry.h"
+#include "Log.h"
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+struct RegistryEntry
+{
+    const char*             name;
+    int                     id;
+    verifier_function       verify;
+    registry_dump_function  dump;
+    registry_stats_function stats;
+};
+
+struct RegistryKey
+{
+    void* stack;
+    int   id;
+};
+
+struct Registry
+{
+    // verifying threads share the lock, joining and leaving stacks take it
+    std::shared_mutex                         mutex;
+    std::unordered_map<void*, RegistryEntry>  stacks;
+
+    std::mutex                                report_mutex;
+};
+
+static Registry registry;
+
+//------------------------------------------------------------------------------
+
+bool registry_join (void* stack, const char* name, int id, verifier_function verify,
+                    registry_dump_function dump, registry_stats_function stats)
+{
+    if ((stack == nullptr) || (verify == nullptr) || (dump == nullptr)) return false;
+
+    // stacks assigned to after the default constructor have no name
+    if (name == nullptr) name = "unnamed";
+
+    std::unique_lock<std::shared_mutex> lock(registry.mutex);
+
+    return registry.stacks.insert({ stack, { name, id, verify, dump, stats } }).second;
+}
+
+//------------------------------------------------------------------------------
+
+void registry_leave (const void* stack)
+{
+    std::unique_lock<std::shared_mutex> lock(registry.mutex);
+
+    registry.stacks.erase((void*)stack);
+}
+
+//------------------------------------------------------------------------------
+
+size_t registry_size ()
+{
+    std::shared_lock<std::shared_mutex> lock(registry.mutex);
+
+    return registry.stacks.size();
+}
+
+//------------------------------------------------------------------------------
+
+static std::vector<RegistryKey> registry_keys ()
+{
+    std::vector<RegistryKey> keys;
+
+    std::shared_lock<std::shared_mutex> lock(registry.mutex);
+
+    keys.reserve(registry.stacks.size());
+
+    for (const std::pair<void* const, RegistryEntry>& entry : registry.stacks)
+        keys.push_back({ entry.first, entry.second.id });
+
+    return keys;
+}
+
+//------------------------------------------------------------------------------
+
+static int registry_verify (const RegistryKey& key, verifier_callback callback, void* arg)
+{
+    size_t block = 0;
+
+    // the registry is locked for one chunk at a time, the stack may leave
+    // between chunks and another one may join at its address
+    do
+    {
+        std::shared_lock<std::shared_mutex> lock(registry.mutex);
+
+        std::unordered_map<void*, RegistryEntry>::iterator entry = registry.stacks.find(key.stack);
+        if ((entry == registry.stacks.end()) || (entry->second.id != key.id)) return STACK_OK;
+
+        int err = entry->second.verify(key.stack, &block);
+
+        if (err != STACK_OK)
+        {
+            std::lock_guard<std::mutex> report_lock(registry.report_mutex);
+
+            if (callback != nullptr) callback(key.stack, entry->second.name, err, arg);
+            else log_printf(STACK_LOGNAME, "Registry verifier: stack %s [" PRINT_PTR "]: %s\n\n",
+                            entry->second.name, key.stack, stk_errstr[err + 1]);
+
+            return err;
+        }
+    }
+    while (block != 0);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+size_t registry_verify_all (size_t threads, verifier_callback callback, void* arg)
+{
+    std::vector<RegistryKey> keys = registry_keys();
+
+    if (threads == 0)           threads = std::thread::hardware_concurrency();
+    if (threads > keys.size())  threads = keys.size();
+    if (threads == 0)           threads = 1;
+
+    std::atomic<size_t> next   (0);
+    std::atomic<size_t> broken (0);
+
+    // the stacks are taken one by one, so a large one does not hold up the rest
+    auto worker = [&keys, &next, &broken, callback, arg]
+    {
+        for (size_t i = next++; i < keys.size(); i = next++)
+        {
+            if (registry_verify(keys[i], callback, arg) != STACK_OK) ++broken;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+
+    for (size_t i = 1; i < threads; ++i) pool.emplace_back(worker);
+
+    worker();
+
+    for (std::thread& thread : pool) thread.join();
+
+    return broken;
+}
+
+//------------------------------------------------------------------------------
+
+size_t registry_dump_all (const char* logfile)
+{
+    std::shared_lock<std::shared_mutex> lock(registry.mutex);
+
+    for (const std::pair<void* const, RegistryEntry>& entry : registry.stacks)
+        entry.second.dump(entry.first, logfile);
+
+    return registry.stacks.size();
+}
+
+//------------------------------------------------------------------------------
+
+size_t registry_report (FILE* fp, int format)
+{
+    StackStats total;
+    size_t     reported = 0;
+
+    std::shared_lock<std::shared_mutex> lock(registry.mutex);
+
+    for (const std::pair<void* const, RegistryEntry>& entry : registry.stacks)
+    {
+        if (entry.second.stats == nullptr) continue;
+
+        const StackStats* stats = entry.second.stats(entry.first);
+
+        stats_print(fp, *stats, entry.second.name, format);
+
+        for (size_t i = 0; i < STATS_COUNTERS_NUM; ++i) total.counters[i] += stats->counters[i];
+
+        for (size_t phase = 0; phase < STATS_PHASES_NUM; ++phase)
+        {
+            total.cycles[phase] += stats->cycles[phase];
+
+            for (size_t bucket = 0; bucket < STATS_BUCKETS_NUM; ++bucket)
+                total.histogram[phase][bucket] += stats->histogram[phase][bucket];
+        }
+
+        ++reported;
+    }
+
+    stats_print(fp, total, "registry", format);
+
+    return reported;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,126 @@
+/*------------------------------------------------------------------------------
+    * File:        Registry.h                                                  *
+    * Description: Registry of the live stacks of a process. Stacks with a     *
+                   registry policy join it when they are constructed and leave *
+                   it when they are destructed, so all of them can be verified *
+                   at once by a pool of threads, dumped or reported.           *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef REGISTRY_H_INCLUDED
+#define REGISTRY_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "StackConfig.h"
+#include "Stats.h"
+#include "Verifier.h"
+#include <stdio.h>
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Dumps a registered stack to the logfile.
+ *
+ *  @param   stack       Pointer to the stack
+ *  @param   logfile     Name of the logfile
+ *
+ *  @return  error code
+ */
+
+typedef int (*registry_dump_function) (void* stack, const char* logfile);
+
+//------------------------------------------------------------------------------
+/*! @brief   Gets the stats of a registered stack.
+ *
+ *  @param   stack       Pointer to the stack
+ *
+ *  @return  pointer to the stats
+ */
+
+typedef const StackStats* (*registry_stats_function) (const void* stack);
+
+//------------------------------------------------------------------------------
+/*! @brief   Add a stack to the registry, nothing is done if it is there.
+ *
+ *  @param   stack       Pointer to the stack
+ *  @param   name        Name of the stack
+ *  @param   id          Id of the stack
+ *  @param   verify      Function verifying a chunk of the stack
+ *  @param   dump        Function dumping the stack
+ *  @param   stats       Function getting the stats of the stack, nullptr if
+ *                       the stack has no stats
+ *
+ *  @return  true if the stack was added
+ */
+
+bool registry_join (void* stack, const char* name, int id, verifier_function verify,
+                    registry_dump_function dump, registry_stats_function stats);
+
+//------------------------------------------------------------------------------
+/*! @brief   Remove a stack from the registry, waits for the chunk of it being
+ *           verified.
+ *
+ *  @param   stack       Pointer to the stack
+ */
+
+void registry_leave (const void* stack);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the number of the registered stacks.
+ *
+ *  @return  number of stacks
+ */
+
+size_t registry_size ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Verify all the registered stacks once: the stack fields, the slot
+ *           above the top and the hashes of all the data blocks, as the full
+ *           check does. The stacks are shared by a pool of threads, the
+ *           calling thread is one of them. Stacks with a background policy,
+ *           as Registered, are locked for every chunk, the others must not be
+ *           changed until the verification is done. Stacks may be constructed and
+ *           destructed meanwhile. Errors are written to the log if there is
+ *           no callback.
+ *
+ *  @param   threads     Number of threads, 0 - as many as the processor has
+ *  @param   callback    Function getting the errors, called by one thread at
+ *                       a time, must not construct or destruct stacks
+ *  @param   arg         Argument of the callback
+ *
+ *  @return  number of stacks with errors
+ */
+
+size_t registry_verify_all (size_t threads = 0, verifier_callback callback = nullptr, void* arg = nullptr);
+
+//------------------------------------------------------------------------------
+/*! @brief   Dump all the registered stacks to the logfile. The stacks must not
+ *           be changed until it is done, except the ones with a background
+ *           policy.
+ *
+ *  @param   logfile     Name of the logfile
+ *
+ *  @return  number of dumped stacks
+ */
+
+size_t registry_dump_all (const char* logfile = STACK_LOGNAME);
+
+//------------------------------------------------------------------------------
+/*! @brief   Print the stats of every registered stack that has them, and their
+ *           sum as "registry" (see stats_print).
+ *
+ *  @param   fp          Output file
+ *  @param   format      STATS_TEXT or STATS_JSON
+ *
+ *  @return  number of stacks with stats
+ */
+
+size_t registry_report (FILE* fp, int format = STATS_TEXT);
+
+//------------------------------------------------------------------------------
+
+#endif // REGISTRY_H_INCLUDED
@@ -0,0 +1,431 @@
+/*------------------------------------------------------------------------------
+    * File:        SegmentedStack.h                                            *
+    * Description: Stack kept in chunks that double in size. A push never     *
+                   copies the values, so it takes no more than one allocation  *
+                   of a new chunk and the values never move.                   *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef SEGMENTED_STACK_H_INCLUDED
+#define SEGMENTED_STACK_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+
+#include "Stack.h"
+
+
+const size_t SEGMENT_CHUNKS_MAX = 48;   // chunk k holds first << k values
+
+#define newSegmentedStack(NAME, STK_TYPE, ...) \
+        SegmentedStack<STK_TYPE, ##__VA_ARGS__> NAME ((char*)#NAME);
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Stack of TYPE values in chunks. Chunk k holds first << k values,
+ *           so a value is found in O(1) by its index and the stack has few
+ *           chunks. A stack grows by a new chunk and never moves its values:
+ *           pushes take no copying and references to the values stay valid
+ *           until they are popped. The chunk freed by pops is kept until the
+ *           stack shrinks by one more chunk, so a stack pushing and popping
+ *           around a chunk boundary does not allocate. Every chunk has hashes
+ *           of its blocks and a chunk hash, the data hash combines the chunk
+ *           hashes of the chunks in use.
+ *
+ *  @tparam  TYPE        Type of values
+ *  @tparam  POLICY      Protection policy (see StackConfig.h), only check,
+ *                       hash, full, poison and dump are used
+ *  @tparam  ALLOC       Allocator of the chunks (see Allocator.h)
+ */
+
+template <typename TYPE, typename POLICY = Checked, typename ALLOC = HeapAllocator>
+class SegmentedStack
+{
+private:
+
+    char*  name_         = nullptr;
+    size_t size_cur_     = 0;
+    size_t first_        = 1;       // capacity of the first chunk, a power of two
+    size_t shift_        = 0;       // log2(first_)
+    size_t chunks_num_   = 0;       // chunks in use, the next one may be cached
+    size_t max_capacity_ = MAX_CAPACITY;
+    hash_t tablehash_    = 0;       // hash of the chunk pointers
+
+    int id_ = 0;
+    int errCode_;
+
+    hash_t stackhash_ = 0;
+    hash_t datahash_  = 0;
+
+    TYPE*  chunks_    [SEGMENT_CHUNKS_MAX] = {};
+    hash_t chunkhash_ [SEGMENT_CHUNKS_MAX] = {};
+
+public:
+
+//------------------------------------------------------------------------------
+/*! @brief   Segmented stack constructor.
+ *
+ *  @param   stack_name  Stack variable name
+ *  @param   capacity    Capacity of the first chunk, rounded up to a power
+ *                       of two
+ */
+
+    SegmentedStack (char* stack_name, size_t capacity = DEFAULT_STACK_CAPACITY);
+
+    SegmentedStack (const SegmentedStack& obj) = delete;
+
+    SegmentedStack& operator = (const SegmentedStack& obj) = delete;
+
+//------------------------------------------------------------------------------
+/*! @brief   Segmented stack destructor.
+ */
+
+   ~SegmentedStack ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Pushing a value onto the stack.
+ *
+ *  @param   value       Value to push
+ *
+ *  @return  error code, STACK_FULL if the maximum capacity is reached
+ */
+
+    int Push (const TYPE& value);
+
+    int Push (TYPE&& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Constructing a value in place on the top of the stack.
+ *
+ *  @param   args        Arguments of the TYPE constructor
+ *
+ *  @return  error code
+ */
+
+    template <typename... ARGS>
+    int Emplace (ARGS&&... args);
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping from stack. The value is moved out of the stack.
+ *
+ *  @return  value from the stack if present, otherwise POISON (default
+ *           constructed value for types without POISON, exit if there is none)
+ */
+
+    TYPE Pop ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Get size of the stack data.
+ *
+ *  @return  stack data size
+ */
+
+    size_t getSize () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get capacity of the chunks in use.
+ *
+ *  @return  stack capacity
+ */
+
+    size_t getCapacity () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the number of chunks in use.
+ *
+ *  @return  number of chunks
+ */
+
+    size_t getChunksNum () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get name of the stack.
+ *
+ *  @return  stack name
+ */
+
+    const char* getName () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Set the maximum capacity the stack can grow to. Pushing to a full
+ *           stack returns STACK_FULL.
+ *
+ *  @param   max_capacity  Maximum capacity, not less than the current one
+ *
+ *  @return  error code
+ */
+
+    int setMaxCapacity (size_t max_capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Access a value. The reference stays valid until the value is
+ *           popped.
+ *
+ *  @param   n           Index of the value, 0 is the bottom
+ *
+ *  @return  reference to the value
+ */
+
+    TYPE& operator [] (size_t n);
+
+    const TYPE& operator [] (size_t n) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Clean stack, only the first chunk is kept.
+ */
+
+    void Clean ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Full stack check, including the hash of every data block.
+ *
+ *  @return  error code
+ */
+
+    int Verify ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Print the contents of the stack and its data to the logfile. The
+ *           values of the chunks are printed as one array.
+ *
+ *  @param   funcname    Name of the function from which the dump was called
+ *  @param   logfile     Name of the logfile
+ *
+ *  @return  error code
+ */
+
+    int Dump (const char* funcname = nullptr, const char* logfile = STACK_LOGNAME);
+
+/*------------------------------------------------------------------------------
+                   Private functions                                           *
+*///----------------------------------------------------------------------------
+
+private:
+
+//------------------------------------------------------------------------------
+/*! @brief   Construct a value on the top of the stack, shared by Push and Emplace.
+ *
+ *  @param   funcname    Name of the calling function for dumps
+ *  @param   args        Arguments of the TYPE constructor
+ *
+ *  @return  error code
+ */
+
+    template <typename... ARGS>
+    int Construct (const char* funcname, ARGS&&... args);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the number of values in a chunk.
+ *
+ *  @param   chunk       Index of the chunk
+ *
+ *  @return  chunk capacity
+ */
+
+    size_t ChunkCapacity (size_t chunk) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the index of the first value of a chunk, which is the
+ *           capacity of the chunks before it.
+ *
+ *  @param   chunk       Index of the chunk
+ *
+ *  @return  index of the value
+ */
+
+    size_t ChunkStart (size_t chunk) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Size of the values of a chunk, the block hashes after them are
+ *           aligned.
+ *
+ *  @param   capacity    Chunk capacity
+ *
+ *  @return  size in bytes
+ */
+
+    static size_t DataSize (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Size of a chunk with its block hashes.
+ *
+ *  @param   chunk       Index of the chunk
+ *
+ *  @return  size in bytes
+ */
+
+    size_t ChunkSize (size_t chunk) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Find the chunk of a value.
+ *
+ *  @param   n           Index of the value
+ *  @param   offset      Set to the index of the value in its chunk
+ *
+ *  @return  index of the chunk
+ */
+
+    size_t SlotChunk (size_t n, size_t* offset) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the address of a value.
+ *
+ *  @param   n           Index of the value
+ *
+ *  @return  pointer to the value
+ */
+
+    TYPE* Slot (size_t n) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocate a chunk, poison it and hash its blocks.
+ *
+ *  @param   chunk       Index of the chunk
+ */
+
+    void AllocateChunk (size_t chunk);
+
+//------------------------------------------------------------------------------
+/*! @brief   Free a chunk, its values must be destroyed.
+ *
+ *  @param   chunk       Index of the chunk
+ */
+
+    void FreeChunk (size_t chunk);
+
+//------------------------------------------------------------------------------
+/*! @brief   Start using the next chunk, it is allocated unless it is cached.
+ *
+ *  @return  error code, STACK_FULL if the stack can not grow
+ */
+
+    int AddChunk ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Stop using the last chunk, it is cached and the cached one is freed.
+ */
+
+    void RemoveChunk ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Destroy the live values, the chunks are kept.
+ */
+
+    void DestroyValues ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Filling n slots with POISON. Types without POISON are filled with
+ *           zero bytes.
+ *
+ *  @param   slot        Pointer to the first slot
+ *  @param   n           Number of slots
+ */
+
+    void fillPoison (TYPE* slot, size_t n);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check stack for problems and hash (if enabled).
+ *
+ *  @param   full        If false, only the data blocks near the top are verified
+ *
+ *  @return  error code
+ */
+
+    int Check (bool full = false);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the size of the stack fields under the stack hash.
+ *
+ *  @return  stack size for hash
+ */
+
+    size_t SizeForHash () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the hash of the pointers to the chunks in use and to
+ *           the cached one.
+ *
+ *  @return  table hash
+ */
+
+    hash_t TableHash () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the number of hash blocks of a chunk.
+ *
+ *  @param   chunk       Index of the chunk
+ *
+ *  @return  number of blocks
+ */
+
+    size_t BlocksNum (size_t chunk) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the block hashes of a chunk, stored after its values.
+ *
+ *  @param   chunk       Index of the chunk
+ *
+ *  @return  pointer to the block hashes
+ */
+
+    hash_t* BlockHashes (size_t chunk) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the hash of one block of a chunk.
+ *
+ *  @param   chunk       Index of the chunk
+ *  @param   block       Index of the block
+ *
+ *  @return  block hash
+ */
+
+    hash_t BlockHash (size_t chunk, size_t block) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of all blocks of a chunk and its chunk hash.
+ *
+ *  @param   chunk       Index of the chunk
+ */
+
+    void RehashChunk (size_t chunk);
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of the blocks covering a slot and updates the
+ *           chunk hash and the data hash in place.
+ *
+ *  @param   n           Index of the slot
+ */
+
+    void RehashSlot (size_t n);
+
+//------------------------------------------------------------------------------
+/*! @brief   Checks hashes of the blocks covering a slot.
+ *
+ *  @param   n           Index of the slot
+ *
+ *  @return  true if all the blocks are correct
+ */
+
+    bool CheckSlot (size_t n) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Checks hashes of all blocks of the chunks in use, the chunk hashes
+ *           and the data hash.
+ *
+ *  @return  true if all the hashes are correct
+ */
+
+    bool CheckChunks () const;
+
+//------------------------------------------------------------------------------
+};
+
+//------------------------------------------------------------------------------
+
+#include "SegmentedStack.ipp"
+
+#endif // SEGMENTED_STACK_H_INCLUDED
@@ -0,0 +1,689 @@
+/*------------------------------------------------------------------------------
+    * File:        SegmentedStack.ipp                                          *
+    * Description: Implementations of segmented stack functions.               *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+SegmentedStack<TYPE, POLICY, ALLOC>::SegmentedStack (char* stack_name, size_t capacity) :
+    name_    (stack_name),
+    id_      (stack_id++),
+    errCode_ (STACK_OK)
+{
+    STACK_ASSERTOK((capacity > MAX_CAPACITY),   STACK_WRONG_INPUT_CAPACITY_VALUE_BIG);
+    STACK_ASSERTOK((capacity == 0),             STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
+    STACK_ASSERTOK((stack_name == nullptr),     STACK_WRONG_INPUT_STACK_NAME);
+
+    while (first_ < capacity)
+    {
+        first_ <<= 1;
+        ++shift_;
+    }
+
+    AllocateChunk(0);
+
+    chunks_num_ = 1;
+
+    if constexpr (POLICY::hash)
+    {
+        datahash_  = hash_mix(chunkhash_[0], 0);
+        tablehash_ = TableHash();
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+SegmentedStack<TYPE, POLICY, ALLOC>::~SegmentedStack ()
+{
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    if (errCode_ != STACK_DESTRUCTED)
+    {
+        DestroyValues();
+
+        for (size_t chunk = 0; chunk < SEGMENT_CHUNKS_MAX; ++chunk)
+        {
+            if (chunks_[chunk] != nullptr) FreeChunk(chunk);
+        }
+
+        size_cur_   = 0;
+        chunks_num_ = 0;
+        datahash_   = 0;
+        stackhash_  = 0;
+
+        errCode_ = STACK_DESTRUCTED;
+    }
+    else
+    {
+        STACK_ASSERTOK(true, STACK_DESTRUCTOR_REPEATED);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+int SegmentedStack<TYPE, POLICY, ALLOC>::Push (const TYPE& value)
+{
+    return Construct(__FUNC_NAME__, value);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+int SegmentedStack<TYPE, POLICY, ALLOC>::Push (TYPE&& value)
+{
+    return Construct(__FUNC_NAME__, std::move(value));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+template <typename... ARGS>
+int SegmentedStack<TYPE, POLICY, ALLOC>::Emplace (ARGS&&... args)
+{
+    return Construct(__FUNC_NAME__, std::forward<ARGS>(args)...);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+template <typename... ARGS>
+int SegmentedStack<TYPE, POLICY, ALLOC>::Construct (const char* funcname, ARGS&&... args)
+{
+    STACK_CHECK;
+
+    // the values never move, so arguments referring to them stay valid
+    if (size_cur_ == getCapacity() - 1)
+    {
+        if (AddChunk() != STACK_OK)
+        {
+            errCode_ = STACK_FULL;
+
+            if constexpr (POLICY::dump) Dump(funcname);
+
+            if constexpr (POLICY::hash) stackhash_ = hash(this, SizeForHash());
+
+            return STACK_FULL;
+        }
+    }
+
+    new (Slot(size_cur_)) TYPE (std::forward<ARGS>(args)...);
+
+    ++size_cur_;
+
+    if constexpr (POLICY::hash)
+    {
+        RehashSlot(size_cur_ - 1);
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(funcname);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+TYPE SegmentedStack<TYPE, POLICY, ALLOC>::Pop ()
+{
+    STACK_CHECK;
+
+    if (size_cur_ == 0)
+    {
+        errCode_ = STACK_EMPTY_STACK;
+
+        if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+        if constexpr (POLICY::hash) stackhash_ = hash(this, SizeForHash());
+
+        if constexpr (HAS_POISON<TYPE>)
+            return POISON<TYPE>;
+
+        else if constexpr (std::is_default_constructible<TYPE>::value)
+            return TYPE ();
+
+        else
+        {
+            STACK_ASSERTOK(true, STACK_EMPTY_STACK);
+        }
+    }
+
+    TYPE* slot = Slot(--size_cur_);
+
+    TYPE value (std::move(*slot));
+
+    slot->~TYPE();
+
+    fillPoison(slot, 1);
+
+    if constexpr (POLICY::hash) RehashSlot(size_cur_);
+
+    // the last chunk is kept while it holds the free slot above the top
+    if (size_cur_ < ChunkStart(chunks_num_ - 1)) RemoveChunk();
+
+    if constexpr (POLICY::hash) stackhash_ = hash(this, SizeForHash());
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+
+    return value;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::getSize () const
+{
+    return size_cur_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::getCapacity () const
+{
+    return ChunkStart(chunks_num_);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::getChunksNum () const
+{
+    return chunks_num_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+const char* SegmentedStack<TYPE, POLICY, ALLOC>::getName () const
+{
+    return name_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+int SegmentedStack<TYPE, POLICY, ALLOC>::setMaxCapacity (size_t max_capacity)
+{
+    STACK_CHECK;
+
+    if (max_capacity < getCapacity()) return STACK_CAPACITY_WRONG_VALUE;
+
+    max_capacity_ = max_capacity;
+
+    if constexpr (POLICY::hash) stackhash_ = hash(this, SizeForHash());
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+TYPE& SegmentedStack<TYPE, POLICY, ALLOC>::operator [] (size_t n)
+{
+    if constexpr (POLICY::check) STACK_ASSERTOK((n >= (HAS_POISON<TYPE> ? getCapacity() : size_cur_)), STACK_MEM_ACCESS_VIOLATION);
+
+    return *Slot(n);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+const TYPE& SegmentedStack<TYPE, POLICY, ALLOC>::operator [] (size_t n) const
+{
+    if constexpr (POLICY::check) STACK_ASSERTOK((n >= (HAS_POISON<TYPE> ? getCapacity() : size_cur_)), STACK_MEM_ACCESS_VIOLATION);
+
+    return *Slot(n);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::Clean ()
+{
+    STACK_CHECK;
+
+    DestroyValues();
+
+    for (size_t chunk = 1; chunk < SEGMENT_CHUNKS_MAX; ++chunk)
+    {
+        if (chunks_[chunk] != nullptr) FreeChunk(chunk);
+    }
+
+    size_cur_   = 0;
+    chunks_num_ = 1;
+
+    fillPoison(chunks_[0], first_);
+
+    if constexpr (POLICY::hash)
+    {
+        RehashChunk(0);
+
+        datahash_  = hash_mix(chunkhash_[0], 0);
+        tablehash_ = TableHash();
+        stackhash_ = hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) Dump(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+int SegmentedStack<TYPE, POLICY, ALLOC>::Verify ()
+{
+    return Check(true);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+int SegmentedStack<TYPE, POLICY, ALLOC>::Dump (const char* funcname, const char* logfile)
+{
+    DumpStack stk = {};
+    DumpState<TYPE>(&stk, this, chunks_[0], getCapacity(), size_cur_, id_, errCode_);
+
+    if constexpr (POLICY::hash)
+    {
+        stk.flags     |= DUMP_FLAG_HASH;
+        stk.stackhash  = stackhash_;
+        stk.datahash   = datahash_;
+    }
+
+    bool broken = dump_is_broken(errCode_) || (chunks_num_ > SEGMENT_CHUNKS_MAX);
+
+    // the chunks are rendered in place, a span ends with its chunk
+    return DumpText<TYPE>(&stk, funcname, name_, logfile, [this, broken] (size_t i, size_t* last) -> const TYPE*
+    {
+        size_t offset = 0;
+        size_t chunk  = SlotChunk(i, &offset);
+
+        if (broken || (chunk >= chunks_num_) || (chunks_[chunk] == nullptr)) return nullptr;
+
+        *last = ChunkStart(chunk) + ChunkCapacity(chunk);
+
+        return chunks_[chunk] + offset;
+    });
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::ChunkCapacity (size_t chunk) const
+{
+    return first_ << chunk;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::ChunkStart (size_t chunk) const
+{
+    return (first_ << chunk) - first_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::DataSize (size_t capacity)
+{
+    return (capacity * sizeof(TYPE) + sizeof(hash_t) - 1) / sizeof(hash_t) * sizeof(hash_t);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::ChunkSize (size_t chunk) const
+{
+    if constexpr (POLICY::hash) return DataSize(ChunkCapacity(chunk)) + BlocksNum(chunk) * sizeof(hash_t);
+    else                        return DataSize(ChunkCapacity(chunk));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::SlotChunk (size_t n, size_t* offset) const
+{
+    assert(offset != nullptr);
+
+    // value n is the (n + first)th of a sequence where chunk k starts at first << k
+    size_t index = n + first_;
+    size_t chunk = 63 - __builtin_clzll(index) - shift_;
+
+    *offset = index - (first_ << chunk);
+
+    return chunk;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+TYPE* SegmentedStack<TYPE, POLICY, ALLOC>::Slot (size_t n) const
+{
+    size_t offset = 0;
+    size_t chunk  = SlotChunk(n, &offset);
+
+    assert(chunk < chunks_num_);
+
+    return chunks_[chunk] + offset;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::AllocateChunk (size_t chunk)
+{
+    static_assert(alignof(TYPE) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "stack allocators do not align over-aligned types");
+
+    assert(chunk < SEGMENT_CHUNKS_MAX);
+    assert(chunks_[chunk] == nullptr);
+
+    chunks_[chunk] = (TYPE*)ALLOC::Allocate(ChunkSize(chunk));
+
+    STACK_ASSERTOK((chunks_[chunk] == nullptr), STACK_NO_MEMORY);
+
+    fillPoison(chunks_[chunk], ChunkCapacity(chunk));
+
+    if constexpr (POLICY::hash) RehashChunk(chunk);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::FreeChunk (size_t chunk)
+{
+    assert(chunks_[chunk] != nullptr);
+
+    ALLOC::Deallocate(chunks_[chunk], ChunkSize(chunk));
+
+    chunks_[chunk]    = nullptr;
+    chunkhash_[chunk] = 0;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+int SegmentedStack<TYPE, POLICY, ALLOC>::AddChunk ()
+{
+    size_t chunk = chunks_num_;
+
+    if ((chunk >= SEGMENT_CHUNKS_MAX) || (shift_ + chunk >= 63) ||
+        (ChunkCapacity(chunk) > max_capacity_ - ChunkStart(chunk))) return STACK_FULL;
+
+    if (chunks_[chunk] == nullptr) AllocateChunk(chunk);
+
+    ++chunks_num_;
+
+    if constexpr (POLICY::hash)
+    {
+        datahash_  ^= hash_mix(chunkhash_[chunk], chunk);
+        tablehash_  = TableHash();
+    }
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::RemoveChunk ()
+{
+    assert(chunks_num_ > 1);
+
+    --chunks_num_;
+
+    if constexpr (POLICY::hash) datahash_ ^= hash_mix(chunkhash_[chunks_num_], chunks_num_);
+
+    if ((chunks_num_ + 1 < SEGMENT_CHUNKS_MAX) && (chunks_[chunks_num_ + 1] != nullptr)) FreeChunk(chunks_num_ + 1);
+
+    if constexpr (POLICY::hash) tablehash_ = TableHash();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::DestroyValues ()
+{
+    if constexpr (std::is_trivially_destructible<TYPE>::value) return;
+
+    for (size_t chunk = 0; (chunk < chunks_num_) && (ChunkStart(chunk) < size_cur_); ++chunk)
+    {
+        size_t n = size_cur_ - ChunkStart(chunk);
+        if (n > ChunkCapacity(chunk)) n = ChunkCapacity(chunk);
+
+        std::destroy(chunks_[chunk], chunks_[chunk] + n);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::fillPoison (TYPE* slot, size_t n)
+{
+    assert(slot != nullptr);
+
+    if constexpr (! POLICY::poison) return;
+
+    else if constexpr (HAS_POISON<TYPE>)
+    {
+        poison_fill(slot, n);
+    }
+
+    else
+    {
+        memset((void*)slot, 0, n * sizeof(TYPE));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+int SegmentedStack<TYPE, POLICY, ALLOC>::Check (bool full)
+{
+    if ((errCode_ == STACK_NOT_CONSTRUCTED) || (errCode_ == STACK_DESTRUCTED))
+    {
+        return errCode_;
+    }
+
+    else if (POLICY::hash && ((stackhash_ != hash(this, SizeForHash())) || (tablehash_ != TableHash())))
+    {
+        errCode_ = STACK_INCORRECT_HASH;
+    }
+
+    else if ((chunks_num_ == 0) || (chunks_num_ > SEGMENT_CHUNKS_MAX) || (getCapacity() > max_capacity_))
+    {
+        errCode_ = STACK_CAPACITY_WRONG_VALUE;
+    }
+
+    else if (chunks_[chunks_num_ - 1] == nullptr)
+    {
+        errCode_ = STACK_NULL_DATA_PTR;
+    }
+
+    else if (size_cur_ >= getCapacity())
+    {
+        errCode_ = STACK_SIZE_BIGGER_CAPACITY;
+    }
+
+    else if ((size_cur_ < ChunkStart(chunks_num_ - 1)) ||
+             (POLICY::poison && HAS_POISON<TYPE> && ! isPOISON(*Slot(size_cur_))))
+    {
+        errCode_ = STACK_WRONG_CUR_SIZE;
+    }
+
+    else if (POLICY::hash &&
+             ((full || POLICY::full) ? ! CheckChunks()
+                                     : (! CheckSlot(size_cur_) || ((size_cur_ > 0) && ! CheckSlot(size_cur_ - 1)))))
+    {
+        errCode_ = STACK_INCORRECT_HASH;
+    }
+
+    else
+    {
+        errCode_ = STACK_OK;
+    }
+
+    return errCode_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::SizeForHash () const
+{
+    return (char*)&id_ - (char*)this + sizeof(id_);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+hash_t SegmentedStack<TYPE, POLICY, ALLOC>::TableHash () const
+{
+    size_t chunks_num = (chunks_num_ < SEGMENT_CHUNKS_MAX) ? chunks_num_ + 1 : SEGMENT_CHUNKS_MAX;
+
+    return hash(chunks_, chunks_num * sizeof(TYPE*));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+size_t SegmentedStack<TYPE, POLICY, ALLOC>::BlocksNum (size_t chunk) const
+{
+    return (ChunkCapacity(chunk) * sizeof(TYPE) + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+hash_t* SegmentedStack<TYPE, POLICY, ALLOC>::BlockHashes (size_t chunk) const
+{
+    return (hash_t*)((char*)chunks_[chunk] + DataSize(ChunkCapacity(chunk)));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+hash_t SegmentedStack<TYPE, POLICY, ALLOC>::BlockHash (size_t chunk, size_t block) const
+{
+    size_t offset = block * HASH_BLOCK_SIZE;
+    size_t size   = ChunkCapacity(chunk) * sizeof(TYPE) - offset;
+
+    if (size > HASH_BLOCK_SIZE) size = HASH_BLOCK_SIZE;
+
+    return hash((char*)chunks_[chunk] + offset, size);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::RehashChunk (size_t chunk)
+{
+    hash_t* blockhash  = BlockHashes(chunk);
+    size_t  blocks_num = BlocksNum(chunk);
+
+    hash_t chunkhash = 0;
+    for (size_t block = 0; block < blocks_num; ++block)
+    {
+        blockhash[block] = BlockHash(chunk, block);
+        chunkhash ^= hash_mix(blockhash[block], block);
+    }
+
+    chunkhash_[chunk] = chunkhash;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+void SegmentedStack<TYPE, POLICY, ALLOC>::RehashSlot (size_t n)
+{
+    size_t offset = 0;
+    size_t chunk  = SlotChunk(n, &offset);
+
+    assert(chunk < chunks_num_);
+
+    hash_t* blockhash = BlockHashes(chunk);
+
+    size_t first_block = offset * sizeof(TYPE) / HASH_BLOCK_SIZE;
+    size_t last_block  = ((offset + 1) * sizeof(TYPE) - 1) / HASH_BLOCK_SIZE;
+
+    hash_t chunkhash = chunkhash_[chunk];
+    for (size_t block = first_block; block <= last_block; ++block)
+    {
+        hash_t block_hash = BlockHash(chunk, block);
+
+        chunkhash        ^= hash_mix(blockhash[block], block) ^ hash_mix(block_hash, block);
+        blockhash[block]  = block_hash;
+    }
+
+    datahash_ ^= hash_mix(chunkhash_[chunk], chunk) ^ hash_mix(chunkhash, chunk);
+    chunkhash_[chunk] = chunkhash;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+bool SegmentedStack<TYPE, POLICY, ALLOC>::CheckSlot (size_t n) const
+{
+    size_t offset = 0;
+    size_t chunk  = SlotChunk(n, &offset);
+
+    hash_t* blockhash = BlockHashes(chunk);
+
+    size_t first_block = offset * sizeof(TYPE) / HASH_BLOCK_SIZE;
+    size_t last_block  = ((offset + 1) * sizeof(TYPE) - 1) / HASH_BLOCK_SIZE;
+
+    for (size_t block = first_block; block <= last_block; ++block)
+    {
+        if (blockhash[block] != BlockHash(chunk, block)) return false;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC>
+bool SegmentedStack<TYPE, POLICY, ALLOC>::CheckChunks () const
+{
+    hash_t datahash = 0;
+    for (size_t chunk = 0; chunk < chunks_num_; ++chunk)
+    {
+        if (chunks_[chunk] == nullptr) return false;
+
+        hash_t* blockhash  = BlockHashes(chunk);
+        size_t  blocks_num = BlocksNum(chunk);
+
+        hash_t chunkhash = 0;
+        for (size_t block = 0; block < blocks_num; ++block)
+        {
+            if (blockhash[block] != BlockHash(chunk, block)) return false;
+
+            chunkhash ^= hash_mix(blockhash[block], block);
+        }
+
+        if (chunkhash != chunkhash_[chunk]) return false;
+
+        datahash ^= hash_mix(chunkhash, chunk);
+    }
+
+    return (datahash == datahash_);
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,113 @@
+/*------------------------------------------------------------------------------
+    * File:        Snapshot.cpp                                                *
+    * Description: Snapshot image headers and scatter I/O.                     *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Snapshot.h"
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+
+
+//------------------------------------------------------------------------------
+
+void snapshot_header (SnapshotHeader* header, uint16_t type_tag, uint32_t elem_size, uint64_t size, hash_t datahash)
+{
+    assert(header != nullptr);
+
+    *header = {};
+
+    header->magic      = SNAPSHOT_MAGIC;
+    header->version    = SNAPSHOT_VERSION;
+    header->type_tag   = type_tag;
+    header->elem_size  = elem_size;
+    header->size       = size;
+    header->datahash   = datahash;
+    header->headerhash = hash_stable(header, offsetof(SnapshotHeader, headerhash));
+}
+
+//------------------------------------------------------------------------------
+
+bool snapshot_header_ok (const SnapshotHeader* header, uint16_t type_tag, uint32_t elem_size)
+{
+    assert(header != nullptr);
+
+    return (header->magic      == SNAPSHOT_MAGIC)   &&
+           (header->version    == SNAPSHOT_VERSION) &&
+           (header->type_tag   == type_tag)         &&
+           (header->elem_size  == elem_size)        &&
+           (header->headerhash == hash_stable(header, offsetof(SnapshotHeader, headerhash)));
+}
+
+//------------------------------------------------------------------------------
+
+bool snapshot_writev (int fd, struct iovec* iov, int iovcnt)
+{
+    assert(iov != nullptr);
+
+    while (iovcnt > 0)
+    {
+        if (iov->iov_len == 0)
+        {
+            ++iov;
+            --iovcnt;
+            continue;
+        }
+
+        ssize_t written = writev(fd, iov, iovcnt);
+
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        // skip what is written, the rest of a partly written buffer is left
+        while ((iovcnt > 0) && ((size_t)written >= iov->iov_len))
+        {
+            written -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+
+        if (iovcnt > 0)
+        {
+            iov->iov_base  = (char*)iov->iov_base + written;
+            iov->iov_len  -= written;
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool snapshot_read (int fd, void* buf, size_t size)
+{
+    assert((buf != nullptr) || (size == 0));
+
+    while (size > 0)
+    {
+        ssize_t got = read(fd, buf, size);
+
+        if (got < 0)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        if (got == 0) return false;
+
+        buf   = (char*)buf + got;
+        size -= got;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,95 @@
+/*------------------------------------------------------------------------------
+    * File:        Snapshot.h                                                  *
+    * Description: Binary snapshot images of stacks and the scatter I/O they  *
+                   are written and read with.                                  *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef SNAPSHOT_H_INCLUDED
+#define SNAPSHOT_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "hash.h"
+#include <stdint.h>
+#include <sys/uio.h>
+
+
+const uint32_t SNAPSHOT_MAGIC   = 0x50414E53; // "SNAP"
+const uint16_t SNAPSHOT_VERSION = 1;
+
+//------------------------------------------------------------------------------
+/*! @brief   Header of a snapshot image, the live values follow it. Both
+ *           hashes are counted by hash_stable, so an image is read by any
+ *           build and hash engine.
+ */
+
+struct SnapshotHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type_tag;
+    uint32_t elem_size;
+    uint32_t reserved;
+    uint64_t size;          // number of values
+    hash_t   datahash;      // hash of the values
+    hash_t   headerhash;    // hash of the fields above
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Fill the header of an image and its hash.
+ *
+ *  @param   header      Header
+ *  @param   type_tag    Type tag of the values
+ *  @param   elem_size   Size of a value
+ *  @param   size        Number of values
+ *  @param   datahash    Hash of the values
+ */
+
+void snapshot_header (SnapshotHeader* header, uint16_t type_tag, uint32_t elem_size, uint64_t size, hash_t datahash);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check the header of an image.
+ *
+ *  @param   header      Header
+ *  @param   type_tag    Type tag of the values expected
+ *  @param   elem_size   Size of a value expected
+ *
+ *  @return  true if the header is of this version and value type and its hash
+ *           is correct
+ */
+
+bool snapshot_header_ok (const SnapshotHeader* header, uint16_t type_tag, uint32_t elem_size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Write buffers to a file descriptor with writev, until all of them
+ *           are written.
+ *
+ *  @param   fd          File descriptor
+ *  @param   iov         Buffers, changed while written
+ *  @param   iovcnt      Number of buffers
+ *
+ *  @return  true on success
+ */
+
+bool snapshot_writev (int fd, struct iovec* iov, int iovcnt);
+
+//------------------------------------------------------------------------------
+/*! @brief   Read from a file descriptor until the buffer is full.
+ *
+ *  @param   fd          File descriptor
+ *  @param   buf         Buffer
+ *  @param   size        Number of bytes
+ *
+ *  @return  true if all the bytes are read
+ */
+
+bool snapshot_read (int fd, void* buf, size_t size);
+
+//------------------------------------------------------------------------------
+
+#endif // SNAPSHOT_H_INCLUDED
@@ -15,6 +15,13 @@
 
 
 #include "StackConfig.h"
+#include "Log.h"
+#include "Dump.h"
+#include "Allocator.h"
+#include "Stats.h"
+#include "Snapshot.h"
+#include "Verifier.h"
+#include "Registry.h"
 #include <assert.h>
 #include <limits.h>
 #include <memory.h>
@@ -22,59 +29,154 @@
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
+#include <atomic>
+#include <iterator>
+#include <memory>
 #include <new>
+#include <type_traits>
+#include <utility>
 
-#ifdef HASH_PROTECT
 #include "hash.h"
-#endif // HASH_PROTECT
-
-
-#define STACK_CHECK if (Check ())                                                                                      \
-                    {                                                                                                  \
-                      FILE* log = fopen(STACK_LOGNAME, "a");                                                           \
-                      assert (log != nullptr);                                                                         \
-                      fprintf(log, "ERROR: file %s  line %d  function \"%s\"\n\n", __FILE__, __LINE__, __FUNC_NAME__); \
-                      printf (     "ERROR: file %s  line %d  function \"%s\"\n",   __FILE__, __LINE__, __FUNC_NAME__); \
-                      fclose(log);                                                                                     \
-                      Dump( __FUNC_NAME__, STACK_LOGNAME);                                                             \
-                      exit(errCode_);                                                                                  \
+
+
+#define STACK_CHECK if constexpr (POLICY::check) if (Check ())                                                                      \
+                    {                                                                                                               \
+                      log_printf(STACK_LOGNAME, "ERROR: file %s  line %d  function \"%s\"\n\n", __FILE__, __LINE__, __FUNC_NAME__); \
+                      printf    (               "ERROR: file %s  line %d  function \"%s\"\n",   __FILE__, __LINE__, __FUNC_NAME__); \
+                      Dump( __FUNC_NAME__, STACK_LOGNAME);                                                                          \
+                      log_flush();                                                                                                  \
+                      exit(errCode_);                                                                                               \
                     } //
 
 
 #define STACK_ASSERTOK(cond, err) if (cond)                                                              \
                                   {                                                                      \
                                     printError (STACK_LOGNAME , __FILE__, __LINE__, __FUNC_NAME__, err); \
+                                    log_flush();                                                         \
                                     exit(err);                                                           \
                                   } //
 
 const size_t DEFAULT_STACK_CAPACITY = 8;
-static int   stack_id   = 0;
+const double DEFAULT_STACK_GROWTH   = 2.0;
+const double DEFAULT_STACK_SHRINK   = 0;    // stacks do not shrink on pops by default
 
-#define newStack_size(NAME, capacity, STK_TYPE) \
-        Stack<STK_TYPE> NAME ((char*)#NAME, capacity);
+inline std::atomic<int> stack_id (0);
 
-#define newStack(NAME, STK_TYPE) \
-        Stack<STK_TYPE> NAME ((char*)#NAME);
+//------------------------------------------------------------------------------
+/*! @brief   Canary word of the stack fields, empty if the policy has no
+ *           canaries. The empty ones of the two sides are different types,
+ *           so both of them take no space.
+ */
+
+struct StackCanary
+{
+    canary_t value = STACK_CANARY;
+};
+
+template <int SIDE>
+struct StackCanaryOff
+{
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Storage of a small stack inside the stack object: the data buffer
+ *           of SIZE bytes with its canaries and the hashes of its blocks.
+ */
 
+template <size_t SIZE, size_t ALIGN, size_t BLOCKS>
+struct StackSmall
+{
+    alignas(ALIGN) char data [SIZE];
+
+    hash_t blockhash [BLOCKS];
+};
+
+struct StackSmallOff
+{
+};
+
+#define newStack_size(NAME, capacity, STK_TYPE, ...) \
+        Stack<STK_TYPE, ##__VA_ARGS__> NAME ((char*)#NAME, capacity);
+
+#define newStack(NAME, STK_TYPE, ...) \
+        Stack<STK_TYPE, ##__VA_ARGS__> NAME ((char*)#NAME);
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Stack of TYPE values.
+ *
+ *  @tparam  TYPE        Type of values
+ *  @tparam  POLICY      Protection policy: Paranoid, Checked, Release or a
+ *                       user struct with the same constants (see StackConfig.h)
+ *  @tparam  ALLOC       Allocator of the stack buffers: HeapAllocator,
+ *                       PoolAllocator or a user struct with the same static
+ *                       functions (see Allocator.h)
+ *  @tparam  SMALL       Number of values kept in the stack object itself, a
+ *                       stack allocates its data only when it grows over them.
+ *                       Small data is copied by copies even if the policy is
+ *                       copy-on-write.
+ */
 
-template <typename TYPE>
+template <typename TYPE, typename POLICY = Checked, typename ALLOC = HeapAllocator, size_t SMALL = 0>
 class Stack
 {
 private:
 
+    typedef std::conditional_t<POLICY::canary, StackCanary, StackCanaryOff<0>> CanaryLeftType;
+    typedef std::conditional_t<POLICY::canary, StackCanary, StackCanaryOff<1>> CanaryRightType;
+
+    // the left data canary is before the data, aligned for both
+    static constexpr size_t CANARY_OFFSET = ! POLICY::canary                  ? 0             :
+                                            (alignof(TYPE) > sizeof(canary_t)) ? alignof(TYPE) : sizeof(canary_t);
+
+    // a buffer of copy-on-write stacks starts with the number of its stacks
+    static constexpr size_t SHARED_OFFSET = ! POLICY::cow                                 ? 0             :
+                                            (alignof(TYPE) > sizeof(std::atomic<size_t>)) ? alignof(TYPE) : sizeof(std::atomic<size_t>);
+
+    static constexpr size_t BUFFER_OFFSET = SHARED_OFFSET + CANARY_OFFSET;
+
+    [[no_unique_address]] CanaryLeftType canary_left_;
+
     char*   name_     = nullptr;
     size_t  capacity_ = 0;
     size_t  size_cur_ = 0;
 
     TYPE* data_ = nullptr;
 
+    hash_t* blockhash_ = nullptr;
+
+    size_t max_capacity_ = MAX_CAPACITY;
+    double growth_       = DEFAULT_STACK_GROWTH;
+    double shrink_       = DEFAULT_STACK_SHRINK;
+
     int id_ = 0;
     int errCode_;
 
-#ifdef HASH_PROTECT
     hash_t stackhash_ = 0;
     hash_t datahash_  = 0;
-#endif // HASH_PROTECT
+
+    typedef std::conditional_t<POLICY::stats, StackStats, StackStatsOff> StatsType;
+    typedef std::conditional_t<POLICY::stats, StatsScope, StatsScopeOff> StatsScopeType;
+
+    [[no_unique_address]] mutable StatsType stats_;
+
+    typedef std::conditional_t<(POLICY::check_period > 1) || (POLICY::check_budget > 0), CheckGate<POLICY>, CheckGateOff> CheckGateType;
+    typedef std::conditional_t<POLICY::background, VerifyLock,  VerifyLockOff>  VerifyLockType;
+    typedef std::conditional_t<POLICY::background, VerifyScope, VerifyScopeOff> VerifyScopeType;
+
+    [[no_unique_address]] CheckGateType  check_gate_;
+    [[no_unique_address]] VerifyLockType verify_lock_;
+
+    static constexpr size_t SMALL_SIZE   = CANARY_OFFSET + SMALL * sizeof(TYPE) + (POLICY::canary ? sizeof(canary_t) : 0);
+    static constexpr size_t SMALL_ALIGN  = (alignof(TYPE) > alignof(canary_t)) ? alignof(TYPE) : alignof(canary_t);
+    static constexpr size_t SMALL_BLOCKS = (SMALL * sizeof(TYPE) + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+
+    typedef std::conditional_t<(SMALL > 0), StackSmall<SMALL_SIZE, SMALL_ALIGN, SMALL_BLOCKS>, StackSmallOff> SmallType;
+
+    // the small data is before the right canary, which catches its overruns
+    [[no_unique_address]] SmallType small_;
+
+    [[no_unique_address]] CanaryRightType canary_right_;
 
 public:
 
@@ -94,7 +196,9 @@ public:
     Stack (char* stack_name, size_t capacity = DEFAULT_STACK_CAPACITY);
 
 //------------------------------------------------------------------------------
-/*! @brief   Stack copy constructor.
+/*! @brief   Stack copy constructor. With a copy-on-write policy the copy
+ *           shares the data and its hashes with the source in O(1), the
+ *           data is copied by the first change of either stack.
  *
  *  @param   obj         Source stack
  */
@@ -103,6 +207,16 @@ public:
 
     Stack& operator = (const Stack& obj);
 
+//------------------------------------------------------------------------------
+/*! @brief   Stack move constructor. The source stack is left not constructed.
+ *
+ *  @param   obj         Source stack
+ */
+
+    Stack (Stack&& obj);
+
+    Stack& operator = (Stack&& obj);
+
 //------------------------------------------------------------------------------
 /*! @brief   Stack destructor.
  */
@@ -117,16 +231,88 @@ public:
  *  @return  error code
  */
 
-    int Push (TYPE value);
+    int Push (const TYPE& value);
+
+    int Push (TYPE&& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Constructing a value in place on the top of the stack.
+ *
+ *  @param   args        Arguments of the TYPE constructor
+ *
+ *  @return  error code
+ */
+
+    template <typename... ARGS>
+    int Emplace (ARGS&&... args);
 
 //------------------------------------------------------------------------------
-/*! @brief   Popping from stack.
+/*! @brief   Popping from stack. The value is moved out of the stack.
  *
- *  @return  value from the stack if present, otherwise POISON
+ *  @return  value from the stack if present, otherwise POISON (default
+ *           constructed value for types without POISON, exit if there is none)
  */
 
     TYPE Pop ();
 
+//------------------------------------------------------------------------------
+/*! @brief   Pushing n values onto the stack. The stack grows at most once, the
+ *           check, hash update and dump are done once for the whole batch.
+ *
+ *  @param   data        Values to push, data[n - 1] becomes the top
+ *  @param   n           Number of values
+ *
+ *  @return  error code
+ */
+
+    int PushRange (const TYPE* data, size_t n);
+
+//------------------------------------------------------------------------------
+/*! @brief   Pushing values from first to last (not including) onto the stack.
+ *           Use std::make_move_iterator to move the values.
+ *
+ *  @param   first       Forward iterator to the first value
+ *  @param   last        Forward iterator after the last value
+ *
+ *  @return  error code
+ */
+
+    template <typename ITER>
+    int PushRange (ITER first, ITER last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping n values from the stack in the same order as n calls of
+ *           Pop, so out[0] is the former top. Nothing is popped if the stack
+ *           has less than n values.
+ *
+ *  @param   out         Output iterator or pointer to n values
+ *  @param   n           Number of values
+ *
+ *  @return  error code
+ */
+
+    template <typename ITER>
+    int PopRange (ITER out, size_t n);
+
+//------------------------------------------------------------------------------
+/*! @brief   Make the stack able to hold capacity values without growing.
+ *
+ *  @param   capacity    Number of values
+ *
+ *  @return  error code
+ */
+
+    int Reserve (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Reduce the capacity to the size of the stack, so it holds the
+ *           values and the free slot above the top only.
+ *
+ *  @return  error code
+ */
+
+    int ShrinkToFit ();
+
 //------------------------------------------------------------------------------
 /*! @brief   Get size of the stack data.
  *
@@ -151,6 +337,116 @@ public:
 
     void setName (char* name);
 
+//------------------------------------------------------------------------------
+/*! @brief   Get capacity of the stack.
+ *
+ *  @return  stack capacity
+ */
+
+    size_t getCapacity () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the maximum capacity the stack can grow to.
+ *
+ *  @return  maximum capacity
+ */
+
+    size_t getMaxCapacity () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Set the maximum capacity the stack can grow to. Pushing to a full
+ *           stack returns STACK_FULL.
+ *
+ *  @param   max_capacity  Maximum capacity, not less than the current one
+ *
+ *  @return  error code
+ */
+
+    int setMaxCapacity (size_t max_capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the growth factor of the stack.
+ *
+ *  @return  growth factor
+ */
+
+    double getGrowth () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Set how many times the capacity is increased when the stack grows.
+ *
+ *  @param   growth      Growth factor, bigger than 1 and less than the shrink
+ *                       factor if the stack shrinks
+ *
+ *  @return  error code
+ */
+
+    int setGrowth (double growth);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the shrink factor of the stack.
+ *
+ *  @return  shrink factor, 0 if the stack does not shrink on pops
+ */
+
+    double getShrink () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Set when the stack shrinks on pops: when the size falls below
+ *           capacity / shrink, the capacity is divided by the growth factor,
+ *           but not below DEFAULT_STACK_CAPACITY. The shrink factor bigger
+ *           than the growth one keeps a stack popping and pushing around a
+ *           size from shrinking and growing every time, so with growth 2 and
+ *           shrink 4 a stack below a quarter of the capacity is halved.
+ *
+ *  @param   shrink      Shrink factor, bigger than the growth factor, or 0 to
+ *                       never shrink on pops
+ *
+ *  @return  error code, STACK_WRONG_INPUT_SHRINK also if the policy has no
+ *           shrink and the factor is not 0
+ */
+
+    int setShrink (double shrink);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the counters and timing histograms of the stack. Only for
+ *           policies with stats.
+ *
+ *  @return  stats
+ */
+
+    const StackStats& getStats () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Reset the counters of the stack, the global ones are kept.
+ */
+
+    void ResetStats ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Let the background verifier check the stack, only for background
+ *           policies. The stack is unwatched when it is destructed.
+ *
+ *  @return  error code
+ */
+
+    int Watch ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Stop checking the stack in the background.
+ */
+
+    void Unwatch ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Access a value. A stack sharing its data copies it first, the
+ *           value may be written.
+ *
+ *  @param   n           Index of the value, 0 is the bottom
+ *
+ *  @return  reference to the value
+ */
+
     TYPE& operator [] (size_t n);
 
     const TYPE& operator [] (size_t n) const;
@@ -161,6 +457,14 @@ public:
 
     void Clean ();
 
+//------------------------------------------------------------------------------
+/*! @brief   Full stack check, including the hash of every data block.
+ *
+ *  @return  error code
+ */
+
+    int Verify ();
+
 //------------------------------------------------------------------------------
 /*! @brief   Print the contents of the stack and its data to the logfile.
  *
@@ -172,6 +476,81 @@ public:
 
     int Dump (const char* funcname = nullptr, const char* logfile = STACK_LOGNAME);
 
+//------------------------------------------------------------------------------
+/*! @brief   Write the stack and its raw data to the binary dump file. Used for
+ *           every operation dump if BINARY_DUMP is defined, the file is
+ *           rendered by the DumpDecoder tool.
+ *
+ *  @param   funcname    Name of the function from which the dump was called
+ *  @param   logfile     Name of the binary dump file
+ *
+ *  @return  error code
+ */
+
+    int DumpBinary (const char* funcname, const char* logfile = STACK_BINLOGNAME);
+
+//------------------------------------------------------------------------------
+/*! @brief   Size of the snapshot image of the stack: a SnapshotHeader and the
+ *           live values, the free slots are not in it.
+ *
+ *  @return  size in bytes
+ */
+
+    size_t SnapshotSize () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Write a snapshot image of the stack to a file descriptor. The
+ *           header and the values are written by one writev straight from
+ *           the stack data. Only for trivially copyable types.
+ *
+ *  @param   fd          File descriptor
+ *
+ *  @return  error code, STACK_FILE_ERROR if the write failed
+ */
+
+    int Snapshot (int fd);
+
+//------------------------------------------------------------------------------
+/*! @brief   Write a snapshot image of the stack to a buffer.
+ *
+ *  @param   buf         Buffer of at least SnapshotSize() bytes
+ *  @param   size        Size of the buffer
+ *
+ *  @return  error code, STACK_SNAPSHOT_BUFFER_SMALL if the image does not fit
+ */
+
+    int Snapshot (void* buf, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Replace the values of the stack with the ones of a snapshot image
+ *           read from a file descriptor. If the image fits in the free slots
+ *           above the values, it is read there and checked before it is moved
+ *           down, else it is read into a temporary buffer and the data is
+ *           reallocated. If the image is broken or can not be read the stack
+ *           is left as it was.
+ *
+ *  @param   fd          File descriptor
+ *
+ *  @return  error code, STACK_SNAPSHOT_BROKEN if the header or the hash of
+ *           the values is wrong, STACK_FILE_ERROR if the read failed,
+ *           STACK_FULL if the image is over the maximum capacity,
+ *           STACK_NO_MEMORY if there is no memory for the temporary buffer
+ */
+
+    int Restore (int fd);
+
+//------------------------------------------------------------------------------
+/*! @brief   Replace the values of the stack with the ones of a snapshot image
+ *           in a buffer. The image is verified before the stack is changed.
+ *
+ *  @param   buf         Buffer with the image
+ *  @param   size        Size of the buffer
+ *
+ *  @return  error code, STACK_SNAPSHOT_BROKEN if the image is broken
+ */
+
+    int Restore (const void* buf, size_t size);
+
 /*------------------------------------------------------------------------------
                    Private functions                                           *
 *///----------------------------------------------------------------------------
@@ -179,36 +558,313 @@ public:
 private:
 
 //------------------------------------------------------------------------------
-/*! @brief   Filling the stack data with POISON.
+/*! @brief   Size of the buffer of capacity elements with the data canaries.
+ *
+ *  @param   capacity    Number of elements
+ *
+ *  @return  size in bytes
  */
 
-    void fillPoison ();
+    static size_t BufferSize (size_t capacity);
 
 //------------------------------------------------------------------------------
-/*! @brief   Increase the stack by 2 times.
+/*! @brief   Write the data canaries before the first and after the last
+ *           element.
+ *
+ *  @param   data        Pointer to the elements
+ *  @param   capacity    Number of elements
+ */
+
+    static void SetDataCanaries (TYPE* data, size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check the canaries of the stack fields and of the data.
+ *
+ *  @return  error code
+ */
+
+    int CheckCanaries () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocate raw storage for capacity elements, nothing is constructed.
+ *           Up to SMALL elements are stored in the stack object, the small
+ *           storage must not be in use.
+ *
+ *  @param   capacity    Number of elements, SMALL at least
+ *
+ *  @return  pointer to the storage
+ */
+
+    TYPE* Allocate (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Free the storage got from Allocate.
+ *
+ *  @param   data        Pointer to the storage
+ *  @param   capacity    Number of elements
+ */
+
+    void Deallocate (TYPE* data, size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Free the array of block hashes, before the capacity is changed.
+ */
+
+    void DeallocateHashes ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the capacity of the stack storage: the stack with up
+ *           to SMALL elements keeps them in the stack object, so it holds
+ *           SMALL.
+ *
+ *  @param   capacity    Number of elements
+ *
+ *  @return  capacity of the storage
+ */
+
+    static size_t SmallCapacity (size_t capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if the stack data is stored in the stack object.
+ *
+ *  @return  true if the data is small
+ */
+
+    bool IsSmall () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Take the small data of a stack being moved from: its values are
+ *           moved to the small storage of this stack, the fields must be
+ *           copied already.
+ *
+ *  @param   obj         Source stack
+ */
+
+    void MoveSmall (Stack& obj);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the number of stacks sharing the data, stored before it.
+ *
+ *  @return  pointer to the number
+ */
+
+    std::atomic<size_t>* Refs () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if the data is shared with other stacks.
+ *
+ *  @return  true if the data is shared
+ */
+
+    bool IsShared () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Share the data of another stack and its hashes instead of copying
+ *           them, for copy-on-write policies. The fields must be copied
+ *           already.
+ *
+ *  @param   obj         Source stack
+ *
+ *  @return  true if the data is shared, small data is not
+ */
+
+    bool Share (const Stack& obj);
+
+//------------------------------------------------------------------------------
+/*! @brief   Copy the shared data before it is changed, the other stacks keep
+ *           the old one. The last stack to let go of the data frees it.
+ */
+
+    void Unshare ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Destroy the live elements and free the stack data, the shared
+ *           data is only let go of.
+ */
+
+    void FreeData ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Construct a value on the top of the stack, shared by Push and Emplace.
+ *
+ *  @param   funcname    Name of the calling function for dumps
+ *  @param   args        Arguments of the TYPE constructor
  *
  *  @return  error code
+ */
+
+    template <typename... ARGS>
+    int Construct (const char* funcname, ARGS&&... args);
+
+//------------------------------------------------------------------------------
+/*! @brief   Filling the free part of stack data with POISON. Types without
+ *           POISON are filled with zero bytes.
+ */
+
+    void fillPoison ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Filling the slots from first to last (not including) with POISON.
+ *
+ *  @param   first       Index of the first slot
+ *  @param   last        Index after the last slot
+ */
+
+    void fillPoison (size_t first, size_t last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Increase the stack by the growth factor, but not over the maximum
+ *           capacity.
+ *
+ *  @return  error code, STACK_FULL if the stack can not grow
  */
 
     int Expand ();
 
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the capacity the stack grows to when it must hold size
+ *           values.
+ *
+ *  @param   size        Number of values
+ *
+ *  @return  new capacity, 0 if it would be over the maximum capacity
+ */
+
+    size_t GrowCapacity (size_t size) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Move the stack data to a new storage and append values to it. The
+ *           values are copied before the old data is moved, so they may be
+ *           taken from the stack itself. Trivially copyable values are not
+ *           moved if the allocator can reallocate the buffer.
+ *
+ *  @param   capacity    New capacity, must be bigger than the new size
+ *  @param   first       Iterator to the first value to append
+ *  @param   last        Iterator after the last value to append
+ */
+
+    template <typename ITER>
+    void Grow (size_t capacity, ITER first, ITER last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the capacity the stack shrinks to when it holds size
+ *           values.
+ *
+ *  @param   size        Number of values
+ *
+ *  @return  new capacity, 0 if the stack does not shrink
+ */
+
+    size_t ShrinkCapacity (size_t size) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Move the stack data to a smaller storage, the freed memory is
+ *           counted in the stats. Trivially copyable values are not moved if
+ *           the allocator can reallocate the buffer.
+ *
+ *  @param   capacity    New capacity, must be bigger than the size
+ */
+
+    void Shrink (size_t capacity);
+
 //------------------------------------------------------------------------------
 /*! @brief   Check stack for problems and hash (if enabled).
+ *
+ *  @param   full        If false, only the data blocks near the top are verified
  *
  *  @return  error code
  */
 
-    int Check ();
+    int Check (bool full = false);
+
+//------------------------------------------------------------------------------
+/*! @brief   Verify a chunk of the data of a watched or registered stack from
+ *           a verifier thread: the stack fields, the slot above the top and
+ *           the hashes of VERIFIER_CHUNK_BLOCKS blocks, under the stack lock.
+ *           Nothing in the stack is changed.
+ *
+ *  @param   stack       Pointer to the stack
+ *  @param   block       Index of the first block, set to the next chunk or
+ *                       to 0 after the last one
+ *
+ *  @return  error code
+ */
+
+    static int VerifyChunk (const void* stack, size_t* block);
+
+//------------------------------------------------------------------------------
+/*! @brief   Dump a registered stack for registry_dump_all, under the stack
+ *           lock with a background policy.
+ *
+ *  @param   stack       Pointer to the stack
+ *  @param   logfile     Name of the logfile
+ *
+ *  @return  error code
+ */
+
+    static int RegistryDump (void* stack, const char* logfile);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the stats of a registered stack for registry_report.
+ *
+ *  @param   stack       Pointer to the stack
+ *
+ *  @return  pointer to the stats
+ */
+
+    static const StackStats* RegistryStats (const void* stack);
+
+//------------------------------------------------------------------------------
+/*! @brief   Add the stack to the registry if its policy has one.
+ */
+
+    void Join ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Remove the stack from the registry.
+ */
+
+    void Leave ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Print error summary to console.
+ */
+
+    void ErrorPrint ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Fill the stack state for a dump.
+ *
+ *  @param   stk         Stack state
+ */
+
+    void DumpInfo (DumpStack* stk);
+
+//------------------------------------------------------------------------------
+/*! @brief   Make room for n values before a restore. The old values are
+ *           dropped without copying.
+ *
+ *  @param   n           Number of values
+ *
+ *  @return  error code, STACK_FULL if n values do not fit in the maximum
+ *           capacity
+ */
+
+    int RestoreReserve (size_t n);
 
 //------------------------------------------------------------------------------
-/*! @brief   Print information and error summary to log file and to console.
+/*! @brief   Finish a restore of n values read into the data: poison and
+ *           rehash the slots changed, check and dump.
  *
- *  @param   fp          Pointer to the logfile
+ *  @param   n           Number of values
+ *  @param   used        End of the slots written before: the size of the
+ *                       stack before the restore or the end of the image
+ *                       read above its values
  *
  *  @return  error code
  */
 
-    void ErrorPrint (FILE * fp);
+    int RestoreCommit (size_t n, size_t used);
 
 //------------------------------------------------------------------------------
 /*! @brief   Calculates the size of the structure stack without hash and second canary.
@@ -216,15 +872,99 @@ private:
  *  @return  stack size for hash
  */
 
-#ifdef HASH_PROTECT
-
     size_t SizeForHash ();
 
-#endif // HASH_PROTECT
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the number of hash blocks covering the stack data.
+ *
+ *  @return  number of blocks
+ */
+
+    size_t BlocksNum () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the hash of one data block.
+ *
+ *  @param   block       Index of the block
+ *
+ *  @return  block hash
+ */
+
+    hash_t BlockHash (size_t block);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the hash of a buffer, counted and timed in the stats.
+ *
+ *  @param   ptr         Pointer to the buffer
+ *  @param   size        Size of the buffer
+ *
+ *  @return  hash
+ */
+
+    hash_t Hash (const void* ptr, size_t size) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of all data blocks and the data hash. The
+ *           array of block hashes is allocated if it is null, so it must be
+ *           freed before the capacity is changed.
+ *
+ *  @return  error code
+ */
+
+    int RehashData ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of the blocks from first_block to the end after
+ *           the buffer was reallocated, the blocks before it are kept.
+ *
+ *  @param   first_block  Index of the first changed block
+ *  @param   old_blocks   Number of blocks before the reallocation
+ */
+
+    void RehashTail (size_t first_block, size_t old_blocks);
+
+//------------------------------------------------------------------------------
+/*! @brief   Recalculates hashes of the blocks covering slots from first to last
+ *           and updates the data hash in place.
+ *
+ *  @param   first       Index of the first changed slot
+ *  @param   last        Index of the last changed slot
+ */
+
+    void RehashSlots (size_t first, size_t last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Checks hashes of the blocks covering slots from first to last.
+ *
+ *  @param   first       Index of the first slot
+ *  @param   last        Index of the last slot
+ *
+ *  @return  true if all the blocks are correct
+ */
+
+    bool CheckSlots (size_t first, size_t last);
+
+//------------------------------------------------------------------------------
+/*! @brief   Calculates the data hash from scratch.
+ *
+ *  @return  data hash
+ */
+
+    hash_t TrueDataHash ();
 
 //------------------------------------------------------------------------------
 };
 
+//------------------------------------------------------------------------------
+/*! @brief   Stack keeping up to SMALL values in the stack object, for short
+ *           stacks that would allocate nothing.
+ */
+
+const size_t DEFAULT_SMALL_CAPACITY = 16;
+
+template <typename TYPE, size_t SMALL = DEFAULT_SMALL_CAPACITY, typename POLICY = Checked, typename ALLOC = HeapAllocator>
+using SmallStack = Stack<TYPE, POLICY, ALLOC, SMALL>;
+
 //------------------------------------------------------------------------------
 /*! @brief   Print error explanations to log file and to console.
  *
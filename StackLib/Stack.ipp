@@ -8,16 +8,16 @@
     * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
     *///------------------------------------------------------------------------
 
-template <typename TYPE>
-Stack<TYPE>::Stack () : errCode_ (STACK_NOT_CONSTRUCTED) { }
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+Stack<TYPE, POLICY, ALLOC, SMALL>::Stack () : errCode_ (STACK_NOT_CONSTRUCTED) { }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-Stack<TYPE>::Stack (char* stack_name, size_t capacity) :
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+Stack<TYPE, POLICY, ALLOC, SMALL>::Stack (char* stack_name, size_t capacity) :
     data_     (),
     size_cur_ (0),
-    capacity_ (capacity),
+    capacity_ (SmallCapacity(capacity)),
     name_     (stack_name),
     id_       (stack_id++),
     errCode_  (STACK_OK)
@@ -26,371 +26,1657 @@ Stack<TYPE>::Stack (char* stack_name, size_t capacity) :
     STACK_ASSERTOK((capacity == 0),             STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
     STACK_ASSERTOK((stack_name == nullptr),     STACK_WRONG_INPUT_STACK_NAME);
     
-    data_ = new TYPE[capacity_];
+    data_ = Allocate(capacity_);
 
     fillPoison();
 
-#ifdef HASH_PROTECT
-    datahash_  = hash(data_, capacity_ * sizeof(TYPE));
-    stackhash_ = hash(this, SizeForHash());
-#endif // HASH_PROTECT
+    if constexpr (POLICY::hash)
+    {
+        RehashData();
+        stackhash_ = Hash(this, SizeForHash());
+    }
+
+    Join();
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+Stack<TYPE, POLICY, ALLOC, SMALL>::Stack (const Stack& obj) :
+    size_cur_     (obj.size_cur_),
+    capacity_     (obj.capacity_),
+    max_capacity_ (obj.max_capacity_),
+    growth_       (obj.growth_),
+    shrink_       (obj.shrink_),
+    id_           (stack_id++),
+    errCode_      (STACK_OK)
+{
+    STACK_ASSERTOK((capacity_ > max_capacity_), STACK_WRONG_INPUT_CAPACITY_VALUE_BIG);
+    STACK_ASSERTOK((capacity_ == 0),            STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
+
+    if (! Share(obj))
+    {
+        data_ = Allocate(capacity_);
+
+        std::uninitialized_copy(obj.data_, obj.data_ + size_cur_, data_);
+
+        fillPoison();
+
+        if constexpr (POLICY::hash) RehashData();
+    }
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    Join();
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+Stack<TYPE, POLICY, ALLOC, SMALL>& Stack<TYPE, POLICY, ALLOC, SMALL>::operator = (const Stack& obj)
+{
+    // the registry lock is taken before the stack lock, as the registry
+    // verifier does
+    Join();
+
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_ASSERTOK((obj.capacity_ > obj.max_capacity_), STACK_WRONG_INPUT_CAPACITY_VALUE_BIG);
+    STACK_ASSERTOK((obj.capacity_ == 0),           STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
+
+    if (this == &obj) return *this;
+
+    FreeData();
+
+    size_cur_     = obj.size_cur_;
+    capacity_     = obj.capacity_;
+    max_capacity_ = obj.max_capacity_;
+    growth_       = obj.growth_;
+    shrink_       = obj.shrink_;
+    errCode_      = STACK_OK;
+
+    if (! Share(obj))
+    {
+        data_ = Allocate(capacity_);
+
+        std::uninitialized_copy(obj.data_, obj.data_ + size_cur_, data_);
+
+        fillPoison();
+
+        if constexpr (POLICY::hash) RehashData();
+    }
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    return *this;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+Stack<TYPE, POLICY, ALLOC, SMALL>::Stack (Stack&& obj) :
+    name_         (obj.name_),
+    capacity_     (obj.capacity_),
+    size_cur_     (obj.size_cur_),
+    data_         (obj.data_),
+    blockhash_    (obj.blockhash_),
+    max_capacity_ (obj.max_capacity_),
+    growth_       (obj.growth_),
+    shrink_       (obj.shrink_),
+    id_           (stack_id++),
+    errCode_      (obj.errCode_),
+    datahash_     (obj.datahash_)
+{
+    bool watched = false;
+
+    // the verifier must be done with the source before it is changed
+    if constexpr (POLICY::background)
+    {
+        watched = obj.verify_lock_.watched;
+        obj.Unwatch();
+    }
+
+    obj.Leave();
+
+    if (obj.IsSmall()) MoveSmall(obj);
+
+    obj.capacity_  = 0;
+    obj.size_cur_  = 0;
+    obj.data_      = nullptr;
+    obj.blockhash_ = nullptr;
+    obj.datahash_  = 0;
+    obj.stackhash_ = 0;
+    obj.errCode_   = STACK_NOT_CONSTRUCTED;
+
+    if (errCode_ == STACK_NOT_CONSTRUCTED) return;
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    if constexpr (POLICY::background) if (watched) Watch();
+
+    Join();
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+Stack<TYPE, POLICY, ALLOC, SMALL>& Stack<TYPE, POLICY, ALLOC, SMALL>::operator = (Stack&& obj)
+{
+    if (this == &obj) return *this;
+
+    bool watched = false;
+
+    // both stacks are unwatched while they change, the lock is not taken to
+    // keep the verifier and the registry locks in one order
+    if constexpr (POLICY::background)
+    {
+        watched = verify_lock_.watched || obj.verify_lock_.watched;
+        Unwatch();
+        obj.Unwatch();
+    }
+
+    // the registry verifier must be done with both of them too
+    Leave();
+    obj.Leave();
+
+    FreeData();
+
+    name_         = obj.name_;
+    capacity_     = obj.capacity_;
+    size_cur_     = obj.size_cur_;
+    data_         = obj.data_;
+    blockhash_    = obj.blockhash_;
+    max_capacity_ = obj.max_capacity_;
+    growth_       = obj.growth_;
+    shrink_       = obj.shrink_;
+    errCode_      = obj.errCode_;
+    datahash_     = obj.datahash_;
+
+    if (obj.IsSmall()) MoveSmall(obj);
+
+    obj.capacity_  = 0;
+    obj.size_cur_  = 0;
+    obj.data_      = nullptr;
+    obj.blockhash_ = nullptr;
+    obj.datahash_  = 0;
+    obj.stackhash_ = 0;
+    obj.errCode_   = STACK_NOT_CONSTRUCTED;
+
+    if (errCode_ == STACK_NOT_CONSTRUCTED) return *this;
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    if constexpr (POLICY::background) if (watched) Watch();
+
+    Join();
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    return *this;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+Stack<TYPE, POLICY, ALLOC, SMALL>::~Stack ()
+{
+    Unwatch();
+    Leave();
+
+    if (errCode_ == STACK_NOT_CONSTRUCTED) return;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    if (errCode_ != STACK_DESTRUCTED)
+    {
+        FreeData();
+
+        datahash_  = 0;
+        stackhash_ = 0;
+
+        errCode_ = STACK_DESTRUCTED;
+    }
+    else
+    {
+        STACK_ASSERTOK(true, STACK_DESTRUCTOR_REPEATED);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Push (const TYPE& value)
+{
+    return Construct(__FUNC_NAME__, value);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Push (TYPE&& value)
+{
+    return Construct(__FUNC_NAME__, std::move(value));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+template <typename... ARGS>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Emplace (ARGS&&... args)
+{
+    return Construct(__FUNC_NAME__, std::forward<ARGS>(args)...);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+template <typename... ARGS>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Construct (const char* funcname, ARGS&&... args)
+{
+    StatsScopeType stats_scope (stats_, STATS_PUSH);
+    VerifyScopeType verify_scope (verify_lock_);
 
     STACK_CHECK;
 
-    DUMP_PRINT{ Dump(__FUNC_NAME__); }
+    Unshare();
+
+    if (size_cur_ == capacity_ - 1)
+    {
+        if (GrowCapacity(size_cur_ + 1) == 0)
+        {
+            errCode_ = STACK_FULL;
+
+            if constexpr (POLICY::dump) STACK_DUMP(funcname);
+
+            if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+            return STACK_FULL;
+        }
+
+        // arguments may refer to the stack data, so construct before it is moved
+        TYPE value (std::forward<ARGS>(args)...);
+
+        Expand();
+
+        new (data_ + size_cur_) TYPE (std::move(value));
+    }
+    else
+    {
+        new (data_ + size_cur_) TYPE (std::forward<ARGS>(args)...);
+    }
+
+    ++size_cur_;
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_PUSHES);
+
+    if constexpr (POLICY::hash)
+    {
+        RehashSlots(size_cur_ - 1, size_cur_ - 1);
+        stackhash_ = Hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(funcname);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+TYPE Stack<TYPE, POLICY, ALLOC, SMALL>::Pop ()
+{
+    StatsScopeType stats_scope (stats_, STATS_POP);
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    if (size_cur_ == 0)
+    {
+        errCode_ = STACK_EMPTY_STACK;
+
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+        if constexpr (HAS_POISON<TYPE>)
+            return POISON<TYPE>;
+
+        else if constexpr (std::is_default_constructible<TYPE>::value)
+            return TYPE ();
+
+        else
+        {
+            STACK_ASSERTOK(true, STACK_EMPTY_STACK);
+        }
+    }
+
+    Unshare();
+
+    TYPE value (std::move(data_[--size_cur_]));
+
+    data_[size_cur_].~TYPE();
+
+    fillPoison(size_cur_, size_cur_ + 1);
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_POPS);
+
+    if constexpr (POLICY::hash) RehashSlots(size_cur_, size_cur_);
+
+    // the popped slots are rehashed before the stack shrinks and cuts them
+    if constexpr (POLICY::shrink)
+    {
+        size_t capacity = ShrinkCapacity(size_cur_);
+        if (capacity != 0) Shrink(capacity);
+    }
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    return value;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::PushRange (const TYPE* data, size_t n)
+{
+    assert(data != nullptr);
+
+    return PushRange(data, data + n);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+template <typename ITER>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::PushRange (ITER first, ITER last)
+{
+    StatsScopeType stats_scope (stats_, STATS_PUSH);
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    size_t n = std::distance(first, last);
+
+    Unshare();
+
+    if (size_cur_ + n >= capacity_)
+    {
+        size_t capacity = GrowCapacity(size_cur_ + n);
+
+        if (capacity == 0)
+        {
+            errCode_ = STACK_FULL;
+
+            if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+            if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+            return STACK_FULL;
+        }
+
+        Grow(capacity, first, last);
+    }
+    else if (n != 0)
+    {
+        std::uninitialized_copy(first, last, data_ + size_cur_);
+        size_cur_ += n;
+
+        if constexpr (POLICY::hash) RehashSlots(size_cur_ - n, size_cur_ - 1);
+    }
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_PUSHES, n);
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+template <typename ITER>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::PopRange (ITER out, size_t n)
+{
+    StatsScopeType stats_scope (stats_, STATS_POP);
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    if (n > size_cur_)
+    {
+        errCode_ = STACK_EMPTY_STACK;
+
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+        return STACK_EMPTY_STACK;
+    }
+
+    if (n == 0) return STACK_OK;
+
+    Unshare();
+
+    for (size_t i = size_cur_; i > size_cur_ - n; --i, ++out)
+    {
+        *out = std::move(data_[i - 1]);
+    }
+
+    std::destroy(data_ + size_cur_ - n, data_ + size_cur_);
+    size_cur_ -= n;
+
+    fillPoison(size_cur_, size_cur_ + n);
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_POPS, n);
+
+    if constexpr (POLICY::hash) RehashSlots(size_cur_, size_cur_ + n - 1);
+
+    // the popped slots are rehashed before the stack shrinks and cuts them
+    if constexpr (POLICY::shrink)
+    {
+        size_t capacity = ShrinkCapacity(size_cur_);
+        if (capacity != 0) Shrink(capacity);
+    }
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    return STACK_OK;
 }
 
-//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Reserve (size_t capacity)
+{
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    if (capacity < capacity_) return STACK_OK;
+
+    if (capacity >= max_capacity_)
+    {
+        errCode_ = STACK_FULL;
+
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+        return STACK_FULL;
+    }
+
+    Unshare();
+
+    Grow(capacity + 1, std::make_move_iterator(data_), std::make_move_iterator(data_));
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::ShrinkToFit ()
+{
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    size_t capacity = SmallCapacity(size_cur_ + 1);
+
+    if (capacity >= capacity_) return STACK_OK;
+
+    Unshare();
+
+    Shrink(capacity);
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Clean ()
+{
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    FreeData();
+
+    capacity_ = SmallCapacity(DEFAULT_STACK_CAPACITY);
+
+    data_ = Allocate(capacity_);
+
+    fillPoison();
+
+    if constexpr (POLICY::hash)
+    {
+        RehashData();
+        stackhash_ = Hash(this, SizeForHash());
+    }
+
+    STACK_CHECK;
+
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::getSize () const
+{
+    return size_cur_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+const char* Stack<TYPE, POLICY, ALLOC, SMALL>::getName () const
+{
+    return name_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::setName (char* name)
+{
+    VerifyScopeType verify_scope (verify_lock_);
+
+    name_ = name;
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::getCapacity () const
+{
+    return capacity_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::getMaxCapacity () const
+{
+    return max_capacity_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::setMaxCapacity (size_t max_capacity)
+{
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    if (max_capacity < capacity_) return STACK_CAPACITY_WRONG_VALUE;
+
+    max_capacity_ = max_capacity;
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+double Stack<TYPE, POLICY, ALLOC, SMALL>::getGrowth () const
+{
+    return growth_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+const StackStats& Stack<TYPE, POLICY, ALLOC, SMALL>::getStats () const
+{
+    static_assert(POLICY::stats, "the stack policy has no stats");
+
+    return stats_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::ResetStats ()
+{
+    if constexpr (POLICY::stats) stats_.Reset();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Watch ()
+{
+    static_assert(POLICY::background, "the stack policy has no background verification");
+
+    if ((errCode_ == STACK_NOT_CONSTRUCTED) || (errCode_ == STACK_DESTRUCTED)) return errCode_;
+
+    if (! verify_lock_.watched) verify_lock_.watched = verifier_watch(this, name_, id_, VerifyChunk);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Unwatch ()
+{
+    if constexpr (POLICY::background)
+    {
+        if (verify_lock_.watched) verifier_unwatch(this);
+
+        verify_lock_.watched = false;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Join ()
+{
+    if constexpr (POLICY::registry)
+    {
+        registry_join(this, name_, id_, VerifyChunk, RegistryDump, (POLICY::stats) ? RegistryStats : nullptr);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Leave ()
+{
+    if constexpr (POLICY::registry) registry_leave(this);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::setGrowth (double growth)
+{
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    if (! (growth > 1.0) || ((shrink_ != 0) && (growth >= shrink_))) return STACK_WRONG_INPUT_GROWTH;
+
+    growth_ = growth;
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+double Stack<TYPE, POLICY, ALLOC, SMALL>::getShrink () const
+{
+    return shrink_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::setShrink (double shrink)
+{
+    VerifyScopeType verify_scope (verify_lock_);
+
+    STACK_CHECK;
+
+    if ((shrink != 0) && (! POLICY::shrink || ! (shrink > growth_))) return STACK_WRONG_INPUT_SHRINK;
+
+    shrink_ = shrink;
+
+    if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+TYPE& Stack<TYPE, POLICY, ALLOC, SMALL>::operator [] (size_t n)
+{
+    if constexpr (POLICY::check) STACK_ASSERTOK((n >= (HAS_POISON<TYPE> ? capacity_ : size_cur_)), STACK_MEM_ACCESS_VIOLATION);
+
+    if constexpr (POLICY::cow)
+    {
+        VerifyScopeType verify_scope (verify_lock_);
+
+        Unshare();
+    }
+
+    return data_[n];
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+const TYPE& Stack<TYPE, POLICY, ALLOC, SMALL>::operator [] (size_t n) const
+{
+    if constexpr (POLICY::check) STACK_ASSERTOK((n >= (HAS_POISON<TYPE> ? capacity_ : size_cur_)), STACK_MEM_ACCESS_VIOLATION);
+
+    return data_[n];
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+TYPE* Stack<TYPE, POLICY, ALLOC, SMALL>::Allocate (size_t capacity)
+{
+    static_assert(alignof(TYPE) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "stack allocators do not align over-aligned types");
+
+    if constexpr (SMALL > 0)
+    {
+        if (capacity <= SMALL)
+        {
+            assert(! IsSmall());
+
+            TYPE* data = (TYPE*)(small_.data + CANARY_OFFSET);
+
+            SetDataCanaries(data, capacity);
+
+            return data;
+        }
+    }
+
+    char* buf = (char*)ALLOC::Allocate(BufferSize(capacity));
+
+    STACK_ASSERTOK((buf == nullptr), STACK_NO_MEMORY);
+
+    if constexpr (POLICY::cow) new (buf) std::atomic<size_t> (1);
+
+    TYPE* data = (TYPE*)(buf + BUFFER_OFFSET);
+
+    SetDataCanaries(data, capacity);
+
+    return data;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Deallocate (TYPE* data, size_t capacity)
+{
+    if ((data != nullptr) && (capacity > SMALL)) ALLOC::Deallocate((char*)data - BUFFER_OFFSET, BufferSize(capacity));
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::DeallocateHashes ()
+{
+    if ((blockhash_ != nullptr) && (capacity_ > SMALL)) ALLOC::Deallocate(blockhash_, BlocksNum() * sizeof(hash_t));
+
+    blockhash_ = nullptr;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::SmallCapacity (size_t capacity)
+{
+    return (capacity < SMALL) ? SMALL : capacity;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+bool Stack<TYPE, POLICY, ALLOC, SMALL>::IsSmall () const
+{
+    return (SMALL > 0) && (data_ != nullptr) && (capacity_ <= SMALL);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::MoveSmall (Stack& obj)
+{
+    assert(obj.IsSmall());
+
+    // the pointers copied from the source are to its small storage
+    data_      = nullptr;
+    blockhash_ = nullptr;
+
+    data_ = Allocate(capacity_);
+
+    std::uninitialized_move(obj.data_, obj.data_ + size_cur_, data_);
+    std::destroy(obj.data_, obj.data_ + size_cur_);
+
+    fillPoison();
+
+    if constexpr (POLICY::hash) RehashData();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+std::atomic<size_t>* Stack<TYPE, POLICY, ALLOC, SMALL>::Refs () const
+{
+    assert(data_ != nullptr);
+    assert(capacity_ > SMALL);
+
+    return (std::atomic<size_t>*)((char*)data_ - BUFFER_OFFSET);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+bool Stack<TYPE, POLICY, ALLOC, SMALL>::IsShared () const
+{
+    if constexpr (POLICY::cow)
+        return (data_ != nullptr) && (capacity_ > SMALL) && (Refs()->load(std::memory_order_acquire) > 1);
+
+    else
+        return false;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+bool Stack<TYPE, POLICY, ALLOC, SMALL>::Share (const Stack& obj)
+{
+    if constexpr (POLICY::cow)
+    {
+        if ((obj.data_ == nullptr) || (obj.capacity_ <= SMALL)) return false;
+
+        obj.Refs()->fetch_add(1, std::memory_order_relaxed);
+
+        data_      = obj.data_;
+        blockhash_ = obj.blockhash_;
+        datahash_  = obj.datahash_;
+
+        return true;
+    }
+
+    return false;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Unshare ()
+{
+    if constexpr (POLICY::cow)
+    {
+        if (! IsShared()) return;
+
+        TYPE*   data      = data_;
+        hash_t* blockhash = blockhash_;
+
+        data_      = Allocate(capacity_);
+        blockhash_ = nullptr;
+
+        if constexpr (std::is_trivially_copyable<TYPE>::value)
+        {
+            // the copy has the same bytes, so it keeps the hashes
+            memcpy((void*)data_, data, capacity_ * sizeof(TYPE));
+
+            if constexpr (POLICY::hash)
+            {
+                blockhash_ = (hash_t*)ALLOC::Allocate(BlocksNum() * sizeof(hash_t));
+
+                STACK_ASSERTOK((blockhash_ == nullptr), STACK_NO_MEMORY);
+
+                memcpy(blockhash_, blockhash, BlocksNum() * sizeof(hash_t));
+            }
+        }
+        else
+        {
+            std::uninitialized_copy(data, data + size_cur_, data_);
+
+            fillPoison();
+
+            if constexpr (POLICY::hash) RehashData();
+        }
+
+        if constexpr (POLICY::stats)
+        {
+            stats_.Count(STATS_UNSHARES);
+            stats_.Count(STATS_BYTES_COPIED, size_cur_ * sizeof(TYPE));
+        }
+
+        // the other stacks may have let go of the old data meanwhile
+        if (((std::atomic<size_t>*)((char*)data - BUFFER_OFFSET))->fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::destroy(data, data + size_cur_);
+
+            Deallocate(data, capacity_);
+
+            if (blockhash != nullptr) ALLOC::Deallocate(blockhash, BlocksNum() * sizeof(hash_t));
+        }
+
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::BufferSize (size_t capacity)
+{
+    return BUFFER_OFFSET + capacity * sizeof(TYPE) + (POLICY::canary ? sizeof(canary_t) : 0);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::SetDataCanaries (TYPE* data, size_t capacity)
+{
+    if constexpr (POLICY::canary)
+    {
+        // the right canary is aligned only as TYPE is
+        memcpy((char*)data - sizeof(canary_t),  &STACK_CANARY, sizeof(canary_t));
+        memcpy((char*)(data + capacity),        &STACK_CANARY, sizeof(canary_t));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::CheckCanaries () const
+{
+    if constexpr (POLICY::canary)
+    {
+        canary_t left  = STACK_CANARY;
+        canary_t right = STACK_CANARY;
+
+        if (data_ != nullptr)
+        {
+            memcpy(&left,  (char*)data_ - sizeof(canary_t), sizeof(canary_t));
+            memcpy(&right, (char*)(data_ + capacity_),      sizeof(canary_t));
+        }
+
+        // one branch for the usual case of all four alive
+        if (((canary_left_.value ^ STACK_CANARY) | (canary_right_.value ^ STACK_CANARY) |
+             (left               ^ STACK_CANARY) | (right               ^ STACK_CANARY)) == 0)
+            return STACK_OK;
+
+        if ((canary_left_.value != STACK_CANARY) || (canary_right_.value != STACK_CANARY))
+            return STACK_CANARY_DEAD;
+
+        return STACK_DATA_CANARY_DEAD;
+    }
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::FreeData ()
+{
+    // the last stack of the shared data frees it
+    if (IsShared() && (Refs()->fetch_sub(1, std::memory_order_acq_rel) != 1))
+    {
+        size_cur_  = 0;
+        capacity_  = 0;
+        data_      = nullptr;
+        blockhash_ = nullptr;
+
+        return;
+    }
+
+    if (data_ != nullptr)
+    {
+        std::destroy(data_, data_ + size_cur_);
+
+        size_cur_ = 0;
+
+        fillPoison();
+
+        Deallocate(data_, capacity_);
+        data_ = nullptr;
+    }
+
+    DeallocateHashes();
+
+    capacity_ = 0;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::fillPoison ()
+{
+    assert(this     != nullptr);
+    assert(data_    != nullptr);
+    assert(size_cur_ < capacity_);
+
+    fillPoison(size_cur_, capacity_);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::fillPoison (size_t first, size_t last)
+{
+    assert(data_ != nullptr);
+    assert(last  <= capacity_);
+
+    if constexpr (! POLICY::poison) return;
+
+    else if constexpr (HAS_POISON<TYPE>)
+    {
+        poison_fill(data_ + first, last - first);
+    }
+
+    else
+    {
+        memset((void*)(data_ + first), 0, (last - first) * sizeof(TYPE));
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Expand ()
+{
+    assert(this != nullptr);
+
+    size_t capacity = GrowCapacity(size_cur_ + 1);
+
+    if (capacity == 0) return STACK_FULL;
+
+    Grow(capacity, std::make_move_iterator(data_), std::make_move_iterator(data_));
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::GrowCapacity (size_t size) const
+{
+    if (size >= max_capacity_) return 0;
+
+    size_t capacity = capacity_;
+
+    while (capacity <= size)
+    {
+        double next = capacity * growth_;
+
+        if (next >= (double)max_capacity_) return max_capacity_;
+
+        capacity = ((size_t)next > capacity) ? (size_t)next : capacity + 1;
+    }
+
+    return capacity;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+template <typename ITER>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Grow (size_t capacity, ITER first, ITER last)
+{
+    assert(this != nullptr);
+
+    StatsScopeType stats_scope (stats_, STATS_EXPAND);
+
+    size_t n = std::distance(first, last);
+
+    assert(capacity > size_cur_ + n);
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_EXPANDS);
+
+    if constexpr (std::is_trivially_copyable<TYPE>::value && CAN_REALLOCATE<ALLOC>)
+    {
+        // the small storage is in the stack object, it is never reallocated
+        if (! IsSmall())
+        {
+            size_t old_capacity = capacity_;
+            size_t old_blocks   = BlocksNum();
+            size_t offset       = capacity;
+
+            if constexpr (std::is_pointer<ITER>::value)
+            {
+                if ((first >= data_) && (first < data_ + capacity_)) offset = first - data_;
+            }
+
+            char* buf = (char*)ALLOC::Reallocate((char*)data_ - BUFFER_OFFSET, BufferSize(capacity_), BufferSize(capacity));
+
+            STACK_ASSERTOK((buf == nullptr), STACK_NO_MEMORY);
+
+            TYPE* data = (TYPE*)(buf + BUFFER_OFFSET);
+
+            SetDataCanaries(data, capacity);
+
+            // realloc copies the old buffer only if it could not extend it in place
+            if constexpr (POLICY::stats) stats_.Count(STATS_BYTES_COPIED, (data != data_) ? old_capacity * sizeof(TYPE) : 0);
+
+            data_     = data;
+            capacity_ = capacity;
+
+            // values of the stack itself are copied as bytes, TYPE may be move-only
+            if (offset < capacity) memcpy(data_ + size_cur_, data_ + offset, n * sizeof(TYPE));
+            else                   std::uninitialized_copy(first, last, data_ + size_cur_);
+
+            size_cur_ += n;
+
+            if constexpr (POLICY::stats) stats_.Count(STATS_BYTES_COPIED, n * sizeof(TYPE));
+
+            fillPoison((size_cur_ > old_capacity) ? size_cur_ : old_capacity, capacity_);
+
+            if constexpr (POLICY::hash) RehashTail((size_cur_ - n) * sizeof(TYPE) / HASH_BLOCK_SIZE, old_blocks);
+
+            return;
+        }
+    }
+
+    TYPE* temp = Allocate(capacity);
+
+    std::uninitialized_copy(first, last, temp + size_cur_);
+
+    std::uninitialized_move(data_, data_ + size_cur_, temp);
+    std::destroy(data_, data_ + size_cur_);
+
+    Deallocate(data_, capacity_);
+
+    DeallocateHashes();
+
+    data_      = temp;
+    capacity_  = capacity;
+    size_cur_ += n;
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_BYTES_COPIED, size_cur_ * sizeof(TYPE));
+
+    fillPoison();
+
+    if constexpr (POLICY::hash) RehashData();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::ShrinkCapacity (size_t size) const
+{
+    // one multiplication on pops of a stack that does not shrink
+    if ((shrink_ == 0) || (size * shrink_ >= capacity_) || (capacity_ <= DEFAULT_STACK_CAPACITY)) return 0;
+
+    size_t capacity = capacity_;
+
+    while ((capacity > DEFAULT_STACK_CAPACITY) && (size * shrink_ < capacity))
+    {
+        capacity = (size_t)(capacity / growth_);
+    }
+
+    if (capacity < DEFAULT_STACK_CAPACITY) capacity = DEFAULT_STACK_CAPACITY;
+    if (capacity <= size)                  capacity = size + 1;
+
+    capacity = SmallCapacity(capacity);
+
+    return (capacity < capacity_) ? capacity : 0;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::Shrink (size_t capacity)
+{
+    assert(this != nullptr);
+
+    StatsScopeType stats_scope (stats_, STATS_SHRINK);
+
+    assert(capacity >  size_cur_);
+    assert(capacity <  capacity_);
+
+    if constexpr (POLICY::stats)
+    {
+        stats_.Count(STATS_SHRINKS);
+        stats_.Count(STATS_BYTES_RELEASED, BufferSize(capacity_) - ((capacity > SMALL) ? BufferSize(capacity) : 0));
+    }
+
+    if constexpr (std::is_trivially_copyable<TYPE>::value && CAN_REALLOCATE<ALLOC>)
+    {
+        // a stack shrinking to the small storage moves its values there
+        if (capacity > SMALL)
+        {
+            size_t old_blocks = BlocksNum();
+
+            char* buf = (char*)ALLOC::Reallocate((char*)data_ - BUFFER_OFFSET, BufferSize(capacity_), BufferSize(capacity));
+
+            STACK_ASSERTOK((buf == nullptr), STACK_NO_MEMORY);
+
+            data_     = (TYPE*)(buf + BUFFER_OFFSET);
+            capacity_ = capacity;
+
+            SetDataCanaries(data_, capacity_);
+
+            // the free slots kept their POISON, only the last block is cut
+            if constexpr (POLICY::hash) RehashTail(BlocksNum() - 1, old_blocks);
+
+            return;
+        }
+    }
+
+    TYPE* temp = Allocate(capacity);
+
+    std::uninitialized_move(data_, data_ + size_cur_, temp);
+    std::destroy(data_, data_ + size_cur_);
+
+    Deallocate(data_, capacity_);
+
+    DeallocateHashes();
+
+    data_     = temp;
+    capacity_ = capacity;
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_BYTES_COPIED, size_cur_ * sizeof(TYPE));
+
+    fillPoison();
+
+    if constexpr (POLICY::hash) RehashData();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Dump (const char* funcname, const char* logfile)
+{
+    StatsScopeType stats_scope (stats_, STATS_DUMP);
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_DUMPS);
+
+    DumpStack stk = {};
+    DumpInfo(&stk);
+
+    return DumpText<TYPE>(&stk, funcname, name_, logfile, DumpArray<TYPE> { (dump_is_broken(errCode_)) ? nullptr : data_, capacity_ });
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::DumpBinary (const char* funcname, const char* logfile)
+{
+    assert(logfile != nullptr);
+
+    StatsScopeType stats_scope (stats_, STATS_DUMP);
+
+    if constexpr (POLICY::stats) stats_.Count(STATS_DUMPS);
+
+    static thread_local LogBuffer buf;
+    buf.size = 0;
 
-template <typename TYPE>
-Stack<TYPE>::Stack (const Stack& obj) :
-    size_cur_ (obj.size_cur_),
-    capacity_ (obj.capacity_),
-    id_       (stack_id++),
-    errCode_  (STACK_OK)
-{
-    STACK_ASSERTOK((capacity_ > MAX_CAPACITY),  STACK_WRONG_INPUT_CAPACITY_VALUE_BIG);
-    STACK_ASSERTOK((capacity_ == 0),            STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
+    DumpStack stk = {};
+    DumpInfo(&stk);
 
-    data_ = new TYPE[capacity_];
+    stk.func_id = dump_string_id(logfile, funcname);
+    stk.name_id = dump_string_id(logfile, name_);
 
-    for (int i = 0; i < capacity_; ++i) data_[i] = obj.data_[i];
+    size_t data_size = (data_ != nullptr) ? capacity_ * sizeof(TYPE) : 0;
 
-#ifdef HASH_PROTECT
-    datahash_  = hash(data_, capacity_ * sizeof(TYPE));
-    stackhash_ = hash(this, SizeForHash());
-#endif // HASH_PROTECT
+    DumpRecordHeader header = { DUMP_MAGIC, DUMP_VERSION, DUMP_RECORD_STACK, sizeof(stk) + data_size };
 
-    STACK_CHECK;
+    buf_write(&buf, &header, sizeof(header));
+    buf_write(&buf, &stk,    sizeof(stk));
+    buf_write(&buf, data_,   data_size);
 
-    DUMP_PRINT{ Dump(__FUNC_NAME__); }
+    return log_write(logfile, buf.data, buf.size) ? STACK_OK : STACK_NOT_OK;
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-Stack<TYPE>& Stack<TYPE>::operator = (const Stack& obj)
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::DumpInfo (DumpStack* stk)
 {
-    STACK_ASSERTOK((obj.capacity_ > MAX_CAPACITY), STACK_WRONG_INPUT_CAPACITY_VALUE_BIG);
-    STACK_ASSERTOK((obj.capacity_ == 0),           STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
-
-    size_cur_ = obj.size_cur_;
-    capacity_ = obj.capacity_;
-    errCode_  = STACK_OK;
+    assert(stk != nullptr);
 
-    delete[] data_;
-    data_ = new TYPE[capacity_];
+    DumpState<TYPE>(stk, this, data_, capacity_, size_cur_, id_, errCode_);
 
-    for (int i = 0; i < capacity_; ++i) copyType(data_[i], obj.data_[i]);
+    if (IsSmall())  stk->flags |= DUMP_FLAG_SMALL;
+    if (IsShared()) stk->flags |= DUMP_FLAG_SHARED;
 
-#ifdef HASH_PROTECT
-    datahash_  = hash(data_, capacity_ * sizeof(TYPE));
-    stackhash_ = hash(this, SizeForHash());
-#endif // HASH_PROTECT
-
-    STACK_CHECK;
+    if constexpr (POLICY::hash)
+    {
+        stk->flags     |= DUMP_FLAG_HASH;
+        stk->stackhash  = stackhash_;
+        stk->datahash   = datahash_;
+
+        if ((errCode_ != STACK_OK) && (errCode_ != STACK_EMPTY_STACK) && (errCode_ != STACK_NO_MEMORY) &&
+            (errCode_ != STACK_FULL) && ! dump_is_broken(errCode_))
+        {
+            stk->truestackhash = Hash(this, SizeForHash());
+            stk->truedatahash  = TrueDataHash();
+        }
+    }
+}
 
-    DUMP_PRINT{ Dump(__FUNC_NAME__); }
+//------------------------------------------------------------------------------
 
-    return *this;
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::SnapshotSize () const
+{
+    return sizeof(SnapshotHeader) + size_cur_ * sizeof(TYPE);
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-Stack<TYPE>::~Stack ()
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Snapshot (int fd)
 {
-    if (errCode_ == STACK_NOT_CONSTRUCTED) return;
+    static_assert(std::is_trivially_copyable<TYPE>::value, "snapshots are only for trivially copyable types");
 
-    DUMP_PRINT{ Dump (__FUNC_NAME__); }
+    STACK_CHECK;
 
-    if (errCode_ != STACK_DESTRUCTED)
-    {
-        size_cur_ = 0;
+    size_t data_size = size_cur_ * sizeof(TYPE);
 
-        fillPoison();
+    SnapshotHeader header;
+    snapshot_header(&header, TYPE_TAG<TYPE>, sizeof(TYPE), size_cur_, hash_stable(data_, data_size));
 
-        delete [] data_;
-        data_  = nullptr;
+    struct iovec iov[2] = { { &header, sizeof(header) }, { data_, data_size } };
 
-        capacity_ = 0;
+    if (! snapshot_writev(fd, iov, 2))
+    {
+        errCode_ = STACK_FILE_ERROR;
 
-        #ifdef HASH_PROTECT
-            datahash_  = 0;
-            stackhash_ = 0;
-        #endif // HASH_PROTECT
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
 
-        errCode_ = STACK_DESTRUCTED;
-    }
-    else
-    {
-        STACK_ASSERTOK(STACK_DESTRUCTOR_REPEATED, STACK_DESTRUCTOR_REPEATED);
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
+
+        return STACK_FILE_ERROR;
     }
+
+    return STACK_OK;
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-int Stack<TYPE>::Push (TYPE value)
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Snapshot (void* buf, size_t size)
 {
+    static_assert(std::is_trivially_copyable<TYPE>::value, "snapshots are only for trivially copyable types");
+
     STACK_CHECK;
 
-    if (size_cur_ == capacity_ - 1) Expand();
+    if ((buf == nullptr) || (size < SnapshotSize()))
+    {
+        errCode_ = STACK_SNAPSHOT_BUFFER_SMALL;
+
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
+
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
 
-    data_[size_cur_++] = value;
+        return STACK_SNAPSHOT_BUFFER_SMALL;
+    }
 
-#ifdef HASH_PROTECT
-    datahash_  = hash(data_, capacity_ * sizeof(TYPE));
-    stackhash_ = hash(this, SizeForHash());
-#endif // HASH_PROTECT
+    size_t data_size = size_cur_ * sizeof(TYPE);
 
-    STACK_CHECK;
+    SnapshotHeader header;
+    snapshot_header(&header, TYPE_TAG<TYPE>, sizeof(TYPE), size_cur_, hash_stable(data_, data_size));
 
-    DUMP_PRINT{ Dump (__FUNC_NAME__); }
+    memcpy(buf, &header, sizeof(header));
+    memcpy((char*)buf + sizeof(header), data_, data_size);
 
     return STACK_OK;
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-TYPE Stack<TYPE>::Pop ()
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Restore (int fd)
 {
+    static_assert(std::is_trivially_copyable<TYPE>::value, "snapshots are only for trivially copyable types");
+
+    VerifyScopeType verify_scope (verify_lock_);
+
     STACK_CHECK;
 
-    if (size_cur_ == 0) errCode_ = STACK_EMPTY_STACK;
+    SnapshotHeader header;
 
-    if (errCode_ == STACK_EMPTY_STACK)
-    {
-        DUMP_PRINT{ Dump (__FUNC_NAME__); }
+    int err = STACK_OK;
 
-        #ifdef HASH_PROTECT
-            datahash_  = hash(data_, capacity_ * sizeof(TYPE));
-            stackhash_ = hash(this, SizeForHash());
-        #endif // HASH_PROTECT
+    if      (! snapshot_read(fd, &header, sizeof(header)))                 err = STACK_FILE_ERROR;
+    else if (! snapshot_header_ok(&header, TYPE_TAG<TYPE>, sizeof(TYPE)))  err = STACK_SNAPSHOT_BROKEN;
 
-        return POISON<TYPE>;
-    }
+    if (err != STACK_OK)
+    {
+        errCode_ = err;
 
-    TYPE value = data_[--size_cur_];
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
 
-    data_[size_cur_] = POISON<TYPE>;
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
 
-#ifdef HASH_PROTECT
-    datahash_  = hash(data_, capacity_ * sizeof(TYPE));
-    stackhash_ = hash(this, SizeForHash());
-#endif // HASH_PROTECT
+        return err;
+    }
 
-    STACK_CHECK;
+    size_t n         = header.size;
+    size_t old_size  = size_cur_;
+    size_t data_size = n * sizeof(TYPE);
 
-    DUMP_PRINT{ Dump (__FUNC_NAME__); }
+    if (n >= max_capacity_) err = STACK_FULL;
 
-    return value;
-}
+    // the image is read into the free slots above the values if it fits there,
+    // so the values are kept until it is checked, or aside if it does not fit
+    bool  fits   = (err == STACK_OK) && (old_size + n < capacity_);
+    char* values = nullptr;
 
-//------------------------------------------------------------------------------
+    if (fits)
+    {
+        Unshare();
 
-template <typename TYPE>
-void Stack<TYPE>::Clean ()
-{
-    STACK_CHECK;
+        values = (char*)(data_ + old_size);
+    }
+    else if (err == STACK_OK)
+    {
+        values = (char*)malloc((n > 0) ? data_size : sizeof(TYPE));
 
-    size_cur_ = 0;
-    fillPoison();
-    delete [] data_;
+        if (values == nullptr) err = STACK_NO_MEMORY;
+    }
 
-    capacity_ = DEFAULT_STACK_CAPACITY;
+    if (err == STACK_OK)
+    {
+        if      (! snapshot_read(fd, values, data_size))                   err = STACK_FILE_ERROR;
+        else if (hash_stable(values, data_size) != header.datahash)        err = STACK_SNAPSHOT_BROKEN;
+    }
 
-    data_ = new TYPE[capacity_];
+    if (err != STACK_OK)
+    {
+        if (fits)
+        {
+            fillPoison(old_size, old_size + n);
 
-    fillPoison();
+            if constexpr (POLICY::hash)
+                if (n != 0) RehashSlots(old_size, old_size + n - 1);
+        }
+        else free(values);
 
-#ifdef HASH_PROTECT
-    datahash_  = hash(data_, capacity_ * sizeof(TYPE));
-    stackhash_ = hash(this, SizeForHash());
-#endif // HASH_PROTECT
+        errCode_ = err;
 
-    STACK_CHECK;
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
 
-    DUMP_PRINT{ Dump (__FUNC_NAME__); }
-}
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
 
-//------------------------------------------------------------------------------
+        return err;
+    }
 
-template <typename TYPE>
-size_t Stack<TYPE>::getSize () const
-{
-    return size_cur_;
-}
+    if (fits)
+    {
+        memmove((void*)data_, values, data_size);
 
-//------------------------------------------------------------------------------
+        // the slots up to the end of the image were written
+        return RestoreCommit(n, old_size + n);
+    }
 
-template <typename TYPE>
-const char* Stack<TYPE>::getName () const
-{
-    return name_;
-}
+    err = RestoreReserve(n);
+    if (err != STACK_OK)
+    {
+        free(values);
+        return err;
+    }
 
-//------------------------------------------------------------------------------
+    memcpy((void*)data_, values, data_size);
+    free(values);
 
-template <typename TYPE>
-void Stack<TYPE>::setName (char* name)
-{
-    name_ = name;
+    return RestoreCommit(n, old_size);
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-TYPE& Stack<TYPE>::operator [] (size_t n)
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Restore (const void* buf, size_t size)
 {
-    STACK_ASSERTOK((n >= capacity_), STACK_MEM_ACCESS_VIOLATION);
+    static_assert(std::is_trivially_copyable<TYPE>::value, "snapshots are only for trivially copyable types");
 
-    return data_[n];
-}
+    VerifyScopeType verify_scope (verify_lock_);
 
-//------------------------------------------------------------------------------
+    STACK_CHECK;
 
-template <typename TYPE>
-const TYPE& Stack<TYPE>::operator [] (size_t n) const
-{
-    STACK_ASSERTOK((n >= capacity_), STACK_MEM_ACCESS_VIOLATION);
-    
-    return data_[n];
-}
+    SnapshotHeader header = {};
 
-//------------------------------------------------------------------------------
+    if ((buf != nullptr) && (size >= sizeof(header))) memcpy(&header, buf, sizeof(header));
 
-template <typename TYPE>
-void Stack<TYPE>::fillPoison ()
-{
-    assert(this     != nullptr);
-    assert(data_    != nullptr);
-    assert(size_cur_ < capacity_);
+    const char* values = (const char*)buf + sizeof(header);
 
-    for (int i = size_cur_; i < capacity_; ++i)
+    if ((buf == nullptr) || (size < sizeof(header))                          ||
+        ! snapshot_header_ok(&header, TYPE_TAG<TYPE>, sizeof(TYPE))          ||
+        (header.size > (size - sizeof(header)) / sizeof(TYPE))               ||
+        (hash_stable(values, header.size * sizeof(TYPE)) != header.datahash))
     {
-        data_[i] = POISON<TYPE>;
-    }
-}
-
-//------------------------------------------------------------------------------
+        errCode_ = STACK_SNAPSHOT_BROKEN;
 
-template <typename TYPE>
-int Stack<TYPE>::Expand ()
-{
-    assert(this != nullptr);
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
 
-    capacity_ *= 2;
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
 
-    TYPE* temp = temp = new TYPE[capacity_];
+        return STACK_SNAPSHOT_BROKEN;
+    }
 
-    memcpy(temp, (char*)data_, capacity_ * sizeof(TYPE) / 2);
+    size_t n        = header.size;
+    size_t old_size = size_cur_;
 
-    delete [] data_;
-    data_ = temp;
+    int err = RestoreReserve(n);
+    if (err != STACK_OK) return err;
 
-    fillPoison();
+    memcpy((void*)data_, values, n * sizeof(TYPE));
 
-    return STACK_OK;
+    return RestoreCommit(n, old_size);
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-int Stack<TYPE>::Dump (const char* funcname, const char* logfile)
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::RestoreReserve (size_t n)
 {
-    const size_t linelen = 80;
-    char divline[linelen + 1] = "********************************************************************************";
-
-    FILE* fp = stdout;
-    if (funcname != nullptr)
-    {
-        fp = fopen(logfile, "a");
-        if (fp == nullptr)
-            return STACK_NOT_OK;
+    Unshare();
 
-        if (funcname != nullptr)
-            fprintf(fp, "This dump was called from a function \"%s\"\n", funcname);
+    if (n < capacity_) return STACK_OK;
 
-        time_t t = time(NULL);
-        struct tm tm = *localtime(&t);
-        fprintf(fp, "TIME: %d-%02d-%02d %02d:%02d:%02d\n\n",
-                tm.tm_year + 1900,
-                tm.tm_mon + 1,
-                tm.tm_mday,
-                tm.tm_hour,
-                tm.tm_min,
-                tm.tm_sec);
-    }
+    size_t capacity = GrowCapacity(n);
 
-    if ((errCode_ == STACK_NOT_CONSTRUCTED)      ||
-        (errCode_ == STACK_DESTRUCTED)           ||
-        (errCode_ == STACK_NULL_DATA_PTR)        ||
-        (errCode_ == STACK_SIZE_BIGGER_CAPACITY) ||
-        (errCode_ == STACK_CAPACITY_WRONG_VALUE)   )
+    if (capacity == 0)
     {
-        fprintf(fp, "\nStack (ERROR) [" PRINT_PTR "] \"%s\" id (%d)\n", this, name_, id_);
-        ErrorPrint(fp);
+        errCode_ = STACK_FULL;
 
-        fprintf(fp, "%s\n", divline);
-        if (fp != stdout) fclose(fp);
+        if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
 
-        return STACK_OK;
-    }
+        if constexpr (POLICY::hash) stackhash_ = Hash(this, SizeForHash());
 
-    char* StkState = (char*)stk_errstr[STACK_OK + 1];
+        return STACK_FULL;
+    }
 
-    if (errCode_) ErrorPrint(fp);
+    // the old values are overwritten, the new data gets none of them
+    size_cur_ = 0;
 
-    fprintf(fp, "\nStack (%s) [" PRINT_PTR "] \"%s\", id (%d)\n", StkState, this, name_, id_);
+    Grow(capacity, std::make_move_iterator(data_), std::make_move_iterator(data_));
 
-    fprintf(fp, "\t{\n");
+    return STACK_OK;
+}
 
-    fprintf(fp, "\tType of data is %s\n\n", PRINT_TYPE<TYPE>);
+//------------------------------------------------------------------------------
 
-    fprintf(fp, "\tCapacity           = %lu\n",   capacity_);
-    fprintf(fp, "\tCurrent size       = %lu\n\n", size_cur_);
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::RestoreCommit (size_t n, size_t used)
+{
+    size_cur_ = n;
 
-#ifdef HASH_PROTECT
-    fprintf(fp, "\tStack hash         = " HASH_PRINT_FORMAT "\n",   stackhash_);
-    fprintf(fp, "\tData hash          = " HASH_PRINT_FORMAT "\n\n", datahash_);
+    if (used > n) fillPoison(n, used);
 
-    if ((errCode_ != STACK_OK) && (errCode_ != STACK_EMPTY_STACK) && (errCode_ != STACK_NO_MEMORY))
+    if constexpr (POLICY::hash)
     {
-        fprintf(fp, "\tTrue stack hash    = " HASH_PRINT_FORMAT "\n",   hash(this, SizeForHash()));
-        fprintf(fp, "\tTrue data hash     = " HASH_PRINT_FORMAT "\n\n", hash(data_, capacity_ * sizeof(TYPE)));
-    }
-#endif // HASH_PROTECT
-
-    fprintf(fp, "\tData [" PRINT_PTR "]\n", data_);
-
-    fprintf(fp, "\t\t{\n");
+        size_t changed = (used > n) ? used : n;
 
-    for (int i = 0; i < capacity_; i++)
-    {
-        char ispois = isPOISON(data_[i]);
+        if (changed != 0) RehashSlots(0, changed - 1);
 
-        fprintf(fp, "\t\t%s[%d]: [", (ispois) ? " ": "*", i);
-        TypePrint(fp, data_[i]);
-        fprintf(fp, "]%s\n", (ispois) ? " (POISON)": "");
+        stackhash_ = Hash(this, SizeForHash());
     }
 
-    fprintf(fp, "\t\t}\n");
-
-    fprintf(fp, "\t}\n");
+    STACK_CHECK;
 
-    fprintf(fp, "%s\n", divline);
-    if (fp != stdout) fclose(fp);
+    if constexpr (POLICY::dump) STACK_DUMP(__FUNC_NAME__);
 
     return STACK_OK;
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-int Stack<TYPE>::Check ()
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Verify ()
+{
+    return Check(true);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::Check (bool full)
 {
+    if (! full && ! check_gate_.Due()) return STACK_OK;
+
+    StatsScopeType stats_scope (stats_, STATS_CHECK);
+
+    uint64_t start = (POLICY::check_budget > 0) ? stats_cycles() : 0;
+
     if (this == nullptr)
     {
         return STACK_NULL_STACK_PTR;
@@ -406,12 +1692,15 @@ int Stack<TYPE>::Check ()
         return STACK_DESTRUCTED;
     }
 
-#ifdef HASH_PROTECT
-    else if (stackhash_ != hash(this, SizeForHash()))
+    else if (POLICY::canary && (CheckCanaries() != STACK_OK))
+    {
+        errCode_ = CheckCanaries();
+    }
+
+    else if (POLICY::hash && (stackhash_ != Hash(this, SizeForHash())))
     {
         errCode_ = STACK_INCORRECT_HASH;
     }
-#endif // HASH_PROTECT
 
     else if (data_ == nullptr)
     {
@@ -423,38 +1712,130 @@ int Stack<TYPE>::Check ()
         errCode_ = STACK_SIZE_BIGGER_CAPACITY;
     }
 
-    else if ((capacity_ == 0) || (capacity_ > MAX_CAPACITY))
+    else if ((capacity_ == 0) || (capacity_ > max_capacity_))
     {
         errCode_ = STACK_CAPACITY_WRONG_VALUE;
     }
 
-    else if (! isPOISON(data_[size_cur_]))
+    else if (POLICY::poison && HAS_POISON<TYPE> && ! isPOISON(data_[size_cur_]))
+    {
+        errCode_ = STACK_WRONG_CUR_SIZE;
+    }
+
+    else if (POLICY::poison && HAS_POISON<TYPE> && (full || POLICY::full) &&
+             (poison_count(data_ + size_cur_, capacity_ - size_cur_) != 0))
     {
         errCode_ = STACK_WRONG_CUR_SIZE;
     }
 
-#ifdef HASH_PROTECT
-    else if (datahash_ != hash(data_, capacity_ * sizeof(TYPE)))
+    else if (POLICY::hash && ((full || POLICY::full) ? ! CheckSlots(0, capacity_ - 1)
+                                                     : ! CheckSlots((size_cur_ == 0) ? 0 : size_cur_ - 1, size_cur_)))
     {
         errCode_ = STACK_INCORRECT_HASH;
     }
-#endif // HASH_PROTECT
 
     else
     {
         errCode_ = STACK_OK;
     }
 
+    check_gate_.Done(start);
+
     return errCode_;
 }
 
 //------------------------------------------------------------------------------
 
-template <typename TYPE>
-void Stack<TYPE>::ErrorPrint (FILE* fp)
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::VerifyChunk (const void* stack, size_t* block)
+{
+    assert(stack != nullptr);
+    assert(block != nullptr);
+
+    Stack* stk = (Stack*)stack;
+
+    VerifyScopeType verify_scope (stk->verify_lock_);
+
+    // a default constructed stack joins the registry before it is assigned to
+    if (stk->errCode_ == STACK_NOT_CONSTRUCTED)
+        return STACK_OK;
+
+    if (POLICY::canary && (stk->CheckCanaries() != STACK_OK))
+        return stk->CheckCanaries();
+
+    // raw hashes, the stats belong to the owner thread
+    if (POLICY::hash && (stk->stackhash_ != hash(stk, stk->SizeForHash())))
+        return STACK_INCORRECT_HASH;
+
+    if (stk->data_ == nullptr)
+        return STACK_NULL_DATA_PTR;
+
+    if (stk->size_cur_ > stk->capacity_)
+        return STACK_SIZE_BIGGER_CAPACITY;
+
+    if ((stk->capacity_ == 0) || (stk->capacity_ > stk->max_capacity_))
+        return STACK_CAPACITY_WRONG_VALUE;
+
+    if (POLICY::poison && HAS_POISON<TYPE> && ! isPOISON(stk->data_[stk->size_cur_]))
+        return STACK_WRONG_CUR_SIZE;
+
+    size_t first = *block;
+    *block = 0;
+
+    if constexpr (POLICY::hash)
+    {
+        if (stk->blockhash_ == nullptr) return STACK_INCORRECT_HASH;
+
+        size_t blocks_num = stk->BlocksNum();
+        size_t last       = (first + VERIFIER_CHUNK_BLOCKS < blocks_num) ? first + VERIFIER_CHUNK_BLOCKS : blocks_num;
+
+        for (size_t i = first; i < last; ++i)
+        {
+            size_t offset = i * HASH_BLOCK_SIZE;
+            size_t size   = stk->capacity_ * sizeof(TYPE) - offset;
+
+            if (size > HASH_BLOCK_SIZE) size = HASH_BLOCK_SIZE;
+
+            if (stk->blockhash_[i] != hash((char*)stk->data_ + offset, size)) return STACK_INCORRECT_HASH;
+        }
+
+        if (last < blocks_num) *block = last;
+    }
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::RegistryDump (void* stack, const char* logfile)
+{
+    assert(stack != nullptr);
+
+    Stack* stk = (Stack*)stack;
+
+    VerifyScopeType verify_scope (stk->verify_lock_);
+
+    return stk->Dump("registry_dump_all", logfile);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+const StackStats* Stack<TYPE, POLICY, ALLOC, SMALL>::RegistryStats (const void* stack)
 {
-    assert(fp != nullptr);
+    assert(stack != nullptr);
+
+    if constexpr (POLICY::stats) return &((const Stack*)stack)->stats_;
+
+    else return nullptr;
+}
 
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::ErrorPrint ()
+{
     if (this == nullptr)
     {
         CONSOLE_PRINT{ printf("%s\n", stk_errstr[STACK_NULL_STACK_PTR + 1]); }
@@ -463,8 +1844,6 @@ void Stack<TYPE>::ErrorPrint (FILE* fp)
     else if (errCode_ != STACK_OK)
     {
         CONSOLE_PRINT{ printf("%s\n", stk_errstr[errCode_ + 1]); }
-
-        if (fp != stdout) fprintf(fp, "\n%s\n", stk_errstr[errCode_ + 1]);
     }
 }
 
@@ -476,50 +1855,208 @@ static void printError (const char* logname, const char* file, int line, const c
     assert(logname  != nullptr);
     assert(file     != nullptr);
 
-    FILE* log = fopen(logname, "a");
-    assert(log != nullptr);
+    LogBuffer buf;
 
     time_t t = time(NULL);
     struct tm tm = *localtime(&t);
-    fprintf(log, "TIME: %d-%02d-%02d %02d:%02d:%02d\n\n",
-            tm.tm_year + 1900,
-            tm.tm_mon + 1,
-            tm.tm_mday,
-            tm.tm_hour,
-            tm.tm_min,
-            tm.tm_sec);
+    buf_printf(&buf, "TIME: %d-%02d-%02d %02d:%02d:%02d\n\n",
+               tm.tm_year + 1900,
+               tm.tm_mon + 1,
+               tm.tm_mday,
+               tm.tm_hour,
+               tm.tm_min,
+               tm.tm_sec);
 
-    fprintf(log, "ERROR: file %s  line %d  function %s\n\n", file, line, function);
-    fprintf(log, "%s\n", stk_errstr[err + 1]);
+    buf_printf(&buf, "ERROR: file %s  line %d  function %s\n\n", file, line, function);
+    buf_printf(&buf, "%s\n", stk_errstr[err + 1]);
 
     printf("ERROR: file %s  line %d  function %s\n", file, line, function);
     printf("%s\n\n", stk_errstr[err + 1]);
 
-    fprintf(log, "********************************************************************************\n");
+    buf_printf(&buf, "********************************************************************************\n");
 
-    fclose(log);
+    log_write(logname, buf.data, buf.size);
 }
 
 //------------------------------------------------------------------------------
 
-#ifdef HASH_PROTECT
-
-template <typename TYPE>
-size_t Stack<TYPE>::SizeForHash ()
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::SizeForHash ()
 {
     assert(this != nullptr);
 
     size_t size = 0;
 
+    if constexpr (POLICY::canary) size += sizeof(canary_left_);
+
     size += sizeof(name_);
     size += sizeof(capacity_);
     size += sizeof(size_cur_);
     size += sizeof(data_);
+    size += sizeof(blockhash_);
+    size += sizeof(max_capacity_);
+    size += sizeof(growth_);
+    size += sizeof(shrink_);
     size += sizeof(id_);
 
     return size;
 }
 
-#endif // HASH_PROTECT
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+size_t Stack<TYPE, POLICY, ALLOC, SMALL>::BlocksNum () const
+{
+    return (capacity_ * sizeof(TYPE) + HASH_BLOCK_SIZE - 1) / HASH_BLOCK_SIZE;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+hash_t Stack<TYPE, POLICY, ALLOC, SMALL>::BlockHash (size_t block)
+{
+    assert(data_ != nullptr);
+
+    size_t offset = block * HASH_BLOCK_SIZE;
+    size_t size   = capacity_ * sizeof(TYPE) - offset;
+
+    if (size > HASH_BLOCK_SIZE) size = HASH_BLOCK_SIZE;
+
+    return Hash((char*)data_ + offset, size);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+hash_t Stack<TYPE, POLICY, ALLOC, SMALL>::Hash (const void* ptr, size_t size) const
+{
+    StatsScopeType stats_scope (stats_, STATS_HASH);
+
+    if constexpr (POLICY::stats)
+    {
+        stats_.Count(STATS_HASHES);
+        stats_.Count(STATS_BYTES_HASHED, size);
+    }
+
+    return hash(ptr, size);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+int Stack<TYPE, POLICY, ALLOC, SMALL>::RehashData ()
+{
+    assert(data_ != nullptr);
+
+    size_t blocks_num = BlocksNum();
+
+    if (blockhash_ == nullptr)
+    {
+        if constexpr (SMALL > 0)
+            blockhash_ = IsSmall() ? small_.blockhash : (hash_t*)ALLOC::Allocate(blocks_num * sizeof(hash_t));
+        else
+            blockhash_ = (hash_t*)ALLOC::Allocate(blocks_num * sizeof(hash_t));
+    }
+
+    STACK_ASSERTOK((blockhash_ == nullptr), STACK_NO_MEMORY);
+
+    datahash_ = 0;
+    for (size_t block = 0; block < blocks_num; ++block)
+    {
+        blockhash_[block] = BlockHash(block);
+        datahash_ ^= hash_mix(blockhash_[block], block);
+    }
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::RehashTail (size_t first_block, size_t old_blocks)
+{
+    assert(blockhash_ != nullptr);
+    assert(first_block < old_blocks);
+
+    for (size_t block = first_block; block < old_blocks; ++block)
+    {
+        datahash_ ^= hash_mix(blockhash_[block], block);
+    }
+
+    size_t blocks_num = BlocksNum();
+
+    hash_t* blockhash = (hash_t*)ALLOC::Reallocate(blockhash_, old_blocks * sizeof(hash_t), blocks_num * sizeof(hash_t));
+
+    STACK_ASSERTOK((blockhash == nullptr), STACK_NO_MEMORY);
+
+    blockhash_ = blockhash;
+
+    for (size_t block = first_block; block < blocks_num; ++block)
+    {
+        blockhash_[block] = BlockHash(block);
+        datahash_ ^= hash_mix(blockhash_[block], block);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+void Stack<TYPE, POLICY, ALLOC, SMALL>::RehashSlots (size_t first, size_t last)
+{
+    assert(blockhash_ != nullptr);
+    assert(first <= last);
+    assert(last  <  capacity_);
+
+    size_t first_block = first * sizeof(TYPE) / HASH_BLOCK_SIZE;
+    size_t last_block  = ((last + 1) * sizeof(TYPE) - 1) / HASH_BLOCK_SIZE;
+
+    for (size_t block = first_block; block <= last_block; ++block)
+    {
+        hash_t block_hash = BlockHash(block);
+
+        datahash_ ^= hash_mix(blockhash_[block], block) ^ hash_mix(block_hash, block);
+        blockhash_[block] = block_hash;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+bool Stack<TYPE, POLICY, ALLOC, SMALL>::CheckSlots (size_t first, size_t last)
+{
+    if (blockhash_ == nullptr) return false;
+
+    size_t first_block = first * sizeof(TYPE) / HASH_BLOCK_SIZE;
+    size_t last_block  = ((last + 1) * sizeof(TYPE) - 1) / HASH_BLOCK_SIZE;
+
+    hash_t datahash = 0;
+    for (size_t block = first_block; block <= last_block; ++block)
+    {
+        if (blockhash_[block] != BlockHash(block)) return false;
+
+        datahash ^= hash_mix(blockhash_[block], block);
+    }
+
+    if ((first_block == 0) && (last_block == BlocksNum() - 1))
+        return (datahash == datahash_);
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY, typename ALLOC, size_t SMALL>
+hash_t Stack<TYPE, POLICY, ALLOC, SMALL>::TrueDataHash ()
+{
+    size_t blocks_num = BlocksNum();
+
+    hash_t datahash = 0;
+    for (size_t block = 0; block < blocks_num; ++block)
+    {
+        datahash ^= hash_mix(BlockHash(block), block);
+    }
+
+    return datahash;
+}
 
 //------------------------------------------------------------------------------
@@ -14,6 +14,7 @@
 
 
 #include "../Types.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
 
@@ -44,16 +45,203 @@
 
 #endif // NO_DUMP
 
+#ifdef  BINARY_DUMP
+
+    #define STACK_DUMP(funcname) DumpBinary(funcname)
+
+#else
+
+    #define STACK_DUMP(funcname) Dump(funcname)
+
+#endif // BINARY_DUMP
+
 #ifndef NO_HASH
 
     #define HASH_PROTECT
 
 #endif // NO_HASH
 
+#ifdef  STACK_STATS
+
+    constexpr bool STATS_DEFAULT = true;
+
+#else
+
+    constexpr bool STATS_DEFAULT = false;
+
+#endif // STACK_STATS
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Stack protection policies. A policy is a struct with constants:
+ *           check  - check the stack before and after every operation,
+ *           hash   - protect the stack and its data with hashes,
+ *           full   - verify the hash of all the data on every check, not only
+ *                    the blocks near the top,
+ *           poison - fill free slots with POISON and check the slot above top,
+ *           dump   - dump the stack after every operation,
+ *           stats  - count operations and time them (see Stats.h), off
+ *                    unless STACK_STATS is defined,
+ *           check_period - run only every Nth check, an operation checks the
+ *                    stack before and after itself,
+ *           check_budget - share of the time the checks may take, a check is
+ *                    skipped until the time since the last one makes it
+ *                    fit (0 - no limit),
+ *           background - the stack can be watched by the background verifier
+ *                    (see Verifier.h), every change takes the stack lock,
+ *           canary - put canary words around the stack fields and its data,
+ *                    checked in O(1) on every check,
+ *           cow    - copies share the data until one of them changes it, a
+ *                    copy takes O(1) time and memory,
+ *           shrink - the stack can shrink on pops (see setShrink), without
+ *                    it pops do not test the shrink factor,
+ *           registry - the stack joins the registry of live stacks, which
+ *                    verifies, dumps and reports all of them at once (see
+ *                    Registry.h), it costs an allocation and a global lock
+ *                    per stack, so only Registered has it. Stacks without
+ *                    background can only be verified there while unused.
+ *           A custom policy can derive from a preset and override constants.
+ */
+
+struct Paranoid
+{
+    static constexpr bool check  = true;
+    static constexpr bool hash   = true;
+    static constexpr bool full   = true;
+    static constexpr bool poison = true;
+    static constexpr bool dump   = true;
+    static constexpr bool stats  = STATS_DEFAULT;
+
+    static constexpr size_t check_period = 1;
+    static constexpr double check_budget = 0;
+    static constexpr bool   background   = false;
+
+    static constexpr bool canary = true;
+    static constexpr bool cow    = false;
+    static constexpr bool shrink = true;
+
+    static constexpr bool registry = false;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Default policy, configured by NO_HASH and NO_DUMP.
+ */
+
+struct Checked
+{
+    static constexpr bool check  = true;
+#ifdef HASH_PROTECT
+    static constexpr bool hash   = true;
+#else
+    static constexpr bool hash   = false;
+#endif // HASH_PROTECT
+    static constexpr bool full   = false;
+    static constexpr bool poison = true;
+#ifdef NO_DUMP
+    static constexpr bool dump   = false;
+#else
+    static constexpr bool dump   = true;
+#endif // NO_DUMP
+    static constexpr bool stats  = STATS_DEFAULT;
+
+    static constexpr size_t check_period = 1;
+    static constexpr double check_budget = 0;
+    static constexpr bool   background   = false;
+
+    static constexpr bool canary = false;
+    static constexpr bool cow    = false;
+    static constexpr bool shrink = true;
+
+    static constexpr bool registry = false;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   No checks at all, the stack is as fast as a plain array.
+ */
+
+struct Release
+{
+    static constexpr bool check  = false;
+    static constexpr bool hash   = false;
+    static constexpr bool full   = false;
+    static constexpr bool poison = false;
+    static constexpr bool dump   = false;
+    static constexpr bool stats  = STATS_DEFAULT;
+
+    static constexpr size_t check_period = 1;
+    static constexpr double check_budget = 0;
+    static constexpr bool   background   = false;
+
+    static constexpr bool canary = false;
+    static constexpr bool cow    = false;
+    static constexpr bool shrink = false;
+
+    static constexpr bool registry = false;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Checks near the top on every 64th check, for production stacks
+ *           that need hashes at a small cost.
+ */
+
+struct Sampled : Checked
+{
+    static constexpr bool hash   = true;
+    static constexpr bool dump   = false;
+
+    static constexpr size_t check_period = 64;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   No checks in the operations, the hashes are kept for the
+ *           background verifier which checks all the data of watched stacks.
+ */
+
+struct Background : Checked
+{
+    static constexpr bool check  = false;
+    static constexpr bool hash   = true;
+    static constexpr bool dump   = false;
+
+    static constexpr bool background = true;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Canaries instead of hashes, overruns are found in O(1). Used with
+ *           GuardAllocator they fault at once (see Allocator.h).
+ */
+
+struct Guarded : Checked
+{
+    static constexpr bool hash   = false;
+    static constexpr bool dump   = false;
+
+    static constexpr bool canary = true;
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Background policy in the registry of live stacks, so they can be
+ *           verified, dumped and reported at once (see Registry.h). The
+ *           registry takes the stack lock for every chunk it verifies, so
+ *           the stacks may be used meanwhile.
+ */
+
+struct Registered : Background
+{
+    static constexpr bool registry = true;
+};
+
+
+char const * const STACK_LOGNAME    = "stack.log";
+char const * const STACK_BINLOGNAME = "stack.bin";
+
+constexpr size_t MAX_CAPACITY  = (size_t)1 << 40;  // default, can be lowered per stack
+
+constexpr size_t HASH_BLOCK_SIZE = 256;
 
-char const * const STACK_LOGNAME = "stack.log";
+typedef uint64_t canary_t;
 
-constexpr size_t MAX_CAPACITY  = 100000;
+constexpr canary_t STACK_CANARY = 0xBADC0FFEE0DDF00D;
 
 
 enum StackErrors
@@ -77,6 +265,16 @@ enum StackErrors
     STACK_WRONG_INPUT_CAPACITY_VALUE_BIG                            ,
     STACK_WRONG_INPUT_CAPACITY_VALUE_NIL                            ,
     STACK_WRONG_INPUT_STACK_NAME                                    ,
+    STACK_FULL                                                      ,
+    STACK_WRONG_INPUT_GROWTH                                        ,
+    STACK_STEAL_LOST                                                ,
+    STACK_FILE_ERROR                                                ,
+    STACK_FILE_WRONG_FORMAT                                         ,
+    STACK_SNAPSHOT_BROKEN                                           ,
+    STACK_SNAPSHOT_BUFFER_SMALL                                     ,
+    STACK_CANARY_DEAD                                               ,
+    STACK_DATA_CANARY_DEAD                                          ,
+    STACK_WRONG_INPUT_SHRINK                                        ,
 };
 
 char const * const stk_errstr[] =
@@ -100,6 +298,16 @@ char const * const stk_errstr[] =
     "Wrong capacity value: - is too big"                            ,
     "Wrong capacity value: - is nil"                                ,
     "Wrong input stack name"                                        ,
+    "Stack is full, maximum capacity reached"                       ,
+    "Wrong growth factor: must be bigger than 1"                    ,
+    "Steal lost the race for the value, try again"                  ,
+    "Could not open, read, write, resize or map the stack file"     ,
+    "Stack file has wrong format, version or value type"            ,
+    "Snapshot has wrong format, value type or hash"                 ,
+    "Snapshot buffer is too small"                                  ,
+    "Stack canary is damaged, the stack was overwritten"            ,
+    "Data canary is damaged, the data was overrun"                  ,
+    "Wrong shrink factor: must be 0 or bigger than the growth one"  ,
 };
 
 
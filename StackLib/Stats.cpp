@@ -0,0 +1,198 @@
+/*------------------------------------------------------------------------------
+    * File:        Stats.cpp                                                   *
+    * Description: Stack stats snapshots, printing and periodic export.        *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Stats.h"
+#include <time.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+struct StatsExporter
+{
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable wakeup;
+    bool                    running = false;
+};
+
+static StatsExporter stats_exporter;
+
+//------------------------------------------------------------------------------
+
+uint64_t StackStats::Percentile (int phase, double percent) const
+{
+    uint64_t calls = Calls(phase);
+    if (calls == 0) return 0;
+
+    uint64_t rank = (uint64_t)(calls * percent / 100.0);
+    if (rank >= calls) rank = calls - 1;
+
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < STATS_BUCKETS_NUM; ++bucket)
+    {
+        seen += histogram[phase][bucket];
+        if (seen > rank) return ((uint64_t)2 << bucket) - 1;
+    }
+
+    return UINT64_MAX;
+}
+
+//------------------------------------------------------------------------------
+
+StackStats stats_snapshot ()
+{
+    StackStats stats;
+
+    for (size_t i = 0; i < STATS_COUNTERS_NUM; ++i)
+        stats.counters[i] = stats_global.counters[i].load(std::memory_order_relaxed);
+
+    for (size_t phase = 0; phase < STATS_PHASES_NUM; ++phase)
+    {
+        stats.cycles[phase] = stats_global.cycles[phase].load(std::memory_order_relaxed);
+
+        for (size_t bucket = 0; bucket < STATS_BUCKETS_NUM; ++bucket)
+            stats.histogram[phase][bucket] = stats_global.histogram[phase][bucket].load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
+//------------------------------------------------------------------------------
+
+void stats_reset ()
+{
+    for (size_t i = 0; i < STATS_COUNTERS_NUM; ++i)
+        stats_global.counters[i].store(0, std::memory_order_relaxed);
+
+    for (size_t phase = 0; phase < STATS_PHASES_NUM; ++phase)
+    {
+        stats_global.cycles[phase].store(0, std::memory_order_relaxed);
+
+        for (size_t bucket = 0; bucket < STATS_BUCKETS_NUM; ++bucket)
+            stats_global.histogram[phase][bucket].store(0, std::memory_order_relaxed);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int stats_print (FILE* fp, const StackStats& stats, const char* name, int format)
+{
+    if ((fp == nullptr) || (name == nullptr)) return -1;
+
+    int printed = 0;
+
+    if (format == STATS_JSON)
+    {
+        printed += fprintf(fp, "{\"name\":\"%s\",\"time\":%lld", name, (long long)time(nullptr));
+
+        for (size_t i = 0; i < STATS_COUNTERS_NUM; ++i)
+            printed += fprintf(fp, ",\"%s\":%llu", stats_counter_names[i], (unsigned long long)stats.counters[i]);
+
+        printed += fprintf(fp, ",\"phases\":{");
+
+        for (size_t phase = 0; phase < STATS_PHASES_NUM; ++phase)
+        {
+            printed += fprintf(fp, "%s\"%s\":{\"calls\":%llu,\"cycles\":%llu,\"p50\":%llu,\"p99\":%llu,\"histogram\":[",
+                               (phase == 0) ? "" : ",", stats_phase_names[phase],
+                               (unsigned long long)stats.Calls(phase),
+                               (unsigned long long)stats.cycles[phase],
+                               (unsigned long long)stats.Percentile(phase, 50),
+                               (unsigned long long)stats.Percentile(phase, 99));
+
+            // trailing empty buckets are left out
+            size_t last = STATS_BUCKETS_NUM;
+            while ((last > 0) && (stats.histogram[phase][last - 1] == 0)) --last;
+
+            for (size_t bucket = 0; bucket < last; ++bucket)
+                printed += fprintf(fp, "%s%llu", (bucket == 0) ? "" : ",", (unsigned long long)stats.histogram[phase][bucket]);
+
+            printed += fprintf(fp, "]}");
+        }
+
+        printed += fprintf(fp, "}}\n");
+    }
+    else
+    {
+        printed += fprintf(fp, "Stats of %s\n", name);
+
+        for (size_t i = 0; i < STATS_COUNTERS_NUM; ++i)
+            printed += fprintf(fp, "\t%-14s %llu\n", stats_counter_names[i], (unsigned long long)stats.counters[i]);
+
+        printed += fprintf(fp, "\t%-14s %12s %16s %10s %10s\n", "phase", "calls", "cycles", "p50", "p99");
+
+        for (size_t phase = 0; phase < STATS_PHASES_NUM; ++phase)
+            printed += fprintf(fp, "\t%-14s %12llu %16llu %10llu %10llu\n", stats_phase_names[phase],
+                               (unsigned long long)stats.Calls(phase),
+                               (unsigned long long)stats.cycles[phase],
+                               (unsigned long long)stats.Percentile(phase, 50),
+                               (unsigned long long)stats.Percentile(phase, 99));
+
+        printed += fprintf(fp, "\n");
+    }
+
+    return printed;
+}
+
+//------------------------------------------------------------------------------
+
+static void stats_export_write (const char* filename, int format)
+{
+    FILE* fp = (filename == nullptr) ? stdout : fopen(filename, "a");
+    if (fp == nullptr) return;
+
+    stats_print(fp, stats_snapshot(), "global", format);
+
+    if (fp == stdout) fflush(fp);
+    else              fclose(fp);
+}
+
+//------------------------------------------------------------------------------
+
+bool stats_export_start (const char* filename, unsigned period_ms, int format)
+{
+    std::lock_guard<std::mutex> lock(stats_exporter.mutex);
+
+    if (stats_exporter.running || (period_ms == 0)) return false;
+
+    stats_exporter.running = true;
+    stats_exporter.thread  = std::thread([filename, period_ms, format]
+    {
+        std::unique_lock<std::mutex> lock(stats_exporter.mutex);
+
+        while (stats_exporter.running)
+        {
+            stats_exporter.wakeup.wait_for(lock, std::chrono::milliseconds(period_ms));
+
+            stats_export_write(filename, format);
+        }
+    });
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void stats_export_stop ()
+{
+    {
+        std::lock_guard<std::mutex> lock(stats_exporter.mutex);
+
+        if (! stats_exporter.running) return;
+
+        stats_exporter.running = false;
+    }
+
+    stats_exporter.wakeup.notify_all();
+    stats_exporter.thread.join();
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,303 @@
+/*------------------------------------------------------------------------------
+    * File:        Stats.h                                                     *
+    * Description: Counters and timing histograms of stack operations. A stack *
+                   collects them if its policy has stats, every stack adds to  *
+                   the global ones as well.                                    *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+
+enum StatsCounters
+{
+    STATS_PUSHES                                                    ,
+    STATS_POPS                                                      ,
+    STATS_EXPANDS                                                   ,
+    STATS_BYTES_COPIED                                              ,
+    STATS_HASHES                                                    ,
+    STATS_BYTES_HASHED                                              ,
+    STATS_DUMPS                                                     ,
+    STATS_SHRINKS                                                   ,
+    STATS_BYTES_RELEASED                                            ,
+    STATS_UNSHARES                                                  ,
+
+    STATS_COUNTERS_NUM                                              ,
+};
+
+enum StatsPhases
+{
+    STATS_PUSH                                                      ,
+    STATS_POP                                                       ,
+    STATS_EXPAND                                                    ,
+    STATS_CHECK                                                     ,
+    STATS_HASH                                                      ,
+    STATS_DUMP                                                      ,
+    STATS_SHRINK                                                    ,
+
+    STATS_PHASES_NUM                                                ,
+};
+
+enum StatsFormats
+{
+    STATS_TEXT                                                      ,
+    STATS_JSON                                                      ,
+};
+
+static const char* const stats_counter_names [] =
+{
+    "pushes"                                                        ,
+    "pops"                                                          ,
+    "expands"                                                       ,
+    "bytes_copied"                                                  ,
+    "hashes"                                                        ,
+    "bytes_hashed"                                                  ,
+    "dumps"                                                         ,
+    "shrinks"                                                       ,
+    "bytes_released"                                                ,
+    "unshares"                                                      ,
+};
+
+static const char* const stats_phase_names [] =
+{
+    "push"                                                          ,
+    "pop"                                                           ,
+    "expand"                                                        ,
+    "check"                                                         ,
+    "hash"                                                          ,
+    "dump"                                                          ,
+    "shrink"                                                        ,
+};
+
+static const size_t STATS_BUCKETS_NUM = 40;     // bucket i counts times of [2^i, 2^(i+1)) cycles
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Read the cycle counter, or nanoseconds where there is none.
+ *
+ *  @return  cycles
+ */
+
+inline uint64_t stats_cycles ()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Histogram bucket of a time.
+ *
+ *  @param   cycles      Time in cycles
+ *
+ *  @return  bucket index
+ */
+
+inline size_t stats_bucket (uint64_t cycles)
+{
+    size_t bucket = (cycles == 0) ? 0 : 63 - __builtin_clzll(cycles);
+
+    return (bucket < STATS_BUCKETS_NUM) ? bucket : STATS_BUCKETS_NUM - 1;
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Global counters of all the stacks with stats, updated atomically.
+ */
+
+struct StatsGlobal
+{
+    std::atomic<uint64_t> counters  [STATS_COUNTERS_NUM];
+    std::atomic<uint64_t> cycles    [STATS_PHASES_NUM];
+    std::atomic<uint64_t> histogram [STATS_PHASES_NUM][STATS_BUCKETS_NUM];
+};
+
+inline StatsGlobal stats_global;   // zeroed as a static
+
+//------------------------------------------------------------------------------
+/*! @brief   Counters and timing histograms of one stack, or a snapshot of the
+ *           global ones. Phase times are inclusive: the time of a push
+ *           contains the checks, hashes and dumps it made.
+ */
+
+struct StackStats
+{
+    uint64_t counters  [STATS_COUNTERS_NUM]                   = {};
+    uint64_t cycles    [STATS_PHASES_NUM]                     = {};
+    uint64_t histogram [STATS_PHASES_NUM][STATS_BUCKETS_NUM]  = {};
+
+//------------------------------------------------------------------------------
+/*! @brief   Add to a counter of the stack and to the global one.
+ *
+ *  @param   counter     Counter (StatsCounters)
+ *  @param   value       Value to add
+ */
+
+    void Count (int counter, uint64_t value = 1)
+    {
+        counters[counter] += value;
+        stats_global.counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+//------------------------------------------------------------------------------
+/*! @brief   Add a time of a phase of the stack and to the global one.
+ *
+ *  @param   phase       Phase (StatsPhases)
+ *  @param   time        Time in cycles
+ */
+
+    void Time (int phase, uint64_t time)
+    {
+        size_t bucket = stats_bucket(time);
+
+        cycles[phase] += time;
+        histogram[phase][bucket]++;
+
+        stats_global.cycles[phase].fetch_add(time, std::memory_order_relaxed);
+        stats_global.histogram[phase][bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+//------------------------------------------------------------------------------
+/*! @brief   Number of timed calls of a phase.
+ *
+ *  @param   phase       Phase (StatsPhases)
+ *
+ *  @return  number of calls
+ */
+
+    uint64_t Calls (int phase) const
+    {
+        uint64_t calls = 0;
+        for (size_t bucket = 0; bucket < STATS_BUCKETS_NUM; ++bucket) calls += histogram[phase][bucket];
+
+        return calls;
+    }
+
+//------------------------------------------------------------------------------
+/*! @brief   Approximate percentile of the times of a phase, the upper bound
+ *           of the bucket it falls in.
+ *
+ *  @param   phase       Phase (StatsPhases)
+ *  @param   percent     Percentile from 0 to 100
+ *
+ *  @return  time in cycles
+ */
+
+    uint64_t Percentile (int phase, double percent) const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Reset all the counters, the global ones are kept.
+ */
+
+    void Reset ()
+    {
+        *this = StackStats {};
+    }
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Stats of a stack whose policy has no stats, takes no time.
+ */
+
+struct StackStatsOff
+{
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Times the scope it is declared in as a phase.
+ */
+
+struct StatsScope
+{
+    StackStats* stats;
+    int         phase;
+    uint64_t    start;
+
+    StatsScope (StackStats& stack_stats, int stats_phase) :
+        stats (&stack_stats),
+        phase (stats_phase),
+        start (stats_cycles())
+    {
+    }
+
+   ~StatsScope ()
+    {
+        stats->Time(phase, stats_cycles() - start);
+    }
+};
+
+struct StatsScopeOff
+{
+    StatsScopeOff (const StackStatsOff&, int) { }
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Snapshot of the global counters.
+ *
+ *  @return  global stats
+ */
+
+StackStats stats_snapshot ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Reset the global counters.
+ */
+
+void stats_reset ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Print stats as text (one line per counter and per phase with
+ *           calls, total cycles and p50/p99 percentiles) or as one JSON object
+ *           on one line.
+ *
+ *  @param   fp          Output file
+ *  @param   stats       Stats
+ *  @param   name        Name of the stack, "global" for global stats
+ *  @param   format      STATS_TEXT or STATS_JSON
+ *
+ *  @return  number of characters printed, -1 on error
+ */
+
+int stats_print (FILE* fp, const StackStats& stats, const char* name, int format = STATS_TEXT);
+
+//------------------------------------------------------------------------------
+/*! @brief   Start a thread appending a snapshot of the global stats to a file
+ *           periodically. Only one exporter runs at a time.
+ *
+ *  @param   filename    Name of the file, stdout if nullptr, must stay valid
+ *                       until the exporter is stopped
+ *  @param   period_ms   Period in milliseconds
+ *  @param   format      STATS_TEXT or STATS_JSON
+ *
+ *  @return  true if the exporter was started
+ */
+
+bool stats_export_start (const char* filename, unsigned period_ms, int format = STATS_JSON);
+
+//------------------------------------------------------------------------------
+/*! @brief   Stop the exporter, the last snapshot is written before it stops.
+ */
+
+void stats_export_stop ();
+
+//------------------------------------------------------------------------------
+
+#endif // STATS_H_INCLUDED
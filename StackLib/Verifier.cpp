@@ -0,0 +1,169 @@
+/*------------------------------------------------------------------------------
+    * File:        Verifier.cpp                                                *
+    * Description: Background verifier of watched stacks.                      *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#include "Verifier.h"
+#include "StackConfig.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+struct VerifierEntry
+{
+    const void*       stack;
+    const char*       name;
+    int               id;
+    verifier_function verify;
+};
+
+struct VerifierKey
+{
+    const void* stack;
+    int         id;
+};
+
+struct Verifier
+{
+    std::mutex                 stacks_mutex;
+    std::vector<VerifierEntry> stacks;
+
+    std::thread                thread;
+    std::mutex                 mutex;
+    std::condition_variable    wakeup;
+    bool                       running = false;
+};
+
+static Verifier verifier;
+
+//------------------------------------------------------------------------------
+
+static std::vector<VerifierEntry>::iterator verifier_find (const void* stack)
+{
+    return std::find_if(verifier.stacks.begin(), verifier.stacks.end(),
+                        [stack] (const VerifierEntry& entry) { return entry.stack == stack; });
+}
+
+//------------------------------------------------------------------------------
+
+bool verifier_watch (const void* stack, const char* name, int id, verifier_function verify)
+{
+    if ((stack == nullptr) || (verify == nullptr)) return false;
+
+    std::lock_guard<std::mutex> lock(verifier.stacks_mutex);
+
+    if (verifier_find(stack) != verifier.stacks.end()) return false;
+
+    verifier.stacks.push_back({ stack, name, id, verify });
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void verifier_unwatch (const void* stack)
+{
+    std::lock_guard<std::mutex> lock(verifier.stacks_mutex);
+
+    std::vector<VerifierEntry>::iterator entry = verifier_find(stack);
+
+    if (entry != verifier.stacks.end()) verifier.stacks.erase(entry);
+}
+
+//------------------------------------------------------------------------------
+
+size_t verifier_run (verifier_callback callback, void* arg)
+{
+    std::vector<VerifierKey> keys;
+    {
+        std::lock_guard<std::mutex> lock(verifier.stacks_mutex);
+
+        for (const VerifierEntry& entry : verifier.stacks) keys.push_back({ entry.stack, entry.id });
+    }
+
+    size_t broken = 0;
+
+    for (const VerifierKey& key : keys)
+    {
+        size_t block = 0;
+
+        // the watched stacks are locked for one chunk at a time, the stack may
+        // be unwatched between chunks and another one watched at its address
+        do
+        {
+            std::lock_guard<std::mutex> lock(verifier.stacks_mutex);
+
+            std::vector<VerifierEntry>::iterator entry = verifier_find(key.stack);
+            if ((entry == verifier.stacks.end()) || (entry->id != key.id)) break;
+
+            int err = entry->verify(key.stack, &block);
+
+            if (err != STACK_OK)
+            {
+                if (callback != nullptr) callback(key.stack, entry->name, err, arg);
+                else log_printf(STACK_LOGNAME, "Background verifier: stack %s [" PRINT_PTR "]: %s\n\n",
+                                entry->name, key.stack, stk_errstr[err + 1]);
+
+                ++broken;
+                break;
+            }
+        }
+        while (block != 0);
+    }
+
+    return broken;
+}
+
+//------------------------------------------------------------------------------
+
+bool verifier_start (unsigned period_ms, verifier_callback callback, void* arg)
+{
+    std::lock_guard<std::mutex> lock(verifier.mutex);
+
+    if (verifier.running || (period_ms == 0)) return false;
+
+    verifier.running = true;
+    verifier.thread  = std::thread([period_ms, callback, arg]
+    {
+        std::unique_lock<std::mutex> lock(verifier.mutex);
+
+        while (verifier.running)
+        {
+            verifier.wakeup.wait_for(lock, std::chrono::milliseconds(period_ms));
+            if (! verifier.running) break;
+
+            lock.unlock();
+            verifier_run(callback, arg);
+            lock.lock();
+        }
+    });
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+void verifier_stop ()
+{
+    {
+        std::lock_guard<std::mutex> lock(verifier.mutex);
+
+        if (! verifier.running) return;
+
+        verifier.running = false;
+    }
+
+    verifier.wakeup.notify_all();
+    verifier.thread.join();
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,199 @@
+/*------------------------------------------------------------------------------
+    * File:        Verifier.h                                                  *
+    * Description: Sampled checks and the background verifier of stacks. A    *
+                   sampled policy checks on every Nth check or within a share  *
+                   of the time, the background verifier rehashes watched       *
+                   stacks in its own thread and reports errors to a callback.  *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef VERIFIER_H_INCLUDED
+#define VERIFIER_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "Stats.h"
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+
+const size_t VERIFIER_CHUNK_BLOCKS = 64;    // blocks verified under one lock of a stack
+const size_t CHECK_CLOCK_PERIOD    = 16;    // checks of a budget policy per clock read
+
+//------------------------------------------------------------------------------
+/*! @brief   Verifies one chunk of a watched stack.
+ *
+ *  @param   stack       Pointer to the stack
+ *  @param   block       Index of the first block of the chunk, set to the next
+ *                       chunk or to 0 after the last one
+ *
+ *  @return  error code
+ */
+
+typedef int (*verifier_function) (const void* stack, size_t* block);
+
+//------------------------------------------------------------------------------
+/*! @brief   Gets errors found by the background verifier. Called from the
+ *           verifier thread, must not watch or unwatch stacks.
+ *
+ *  @param   stack       Pointer to the stack
+ *  @param   name        Name of the stack
+ *  @param   errcode     Error code
+ *  @param   arg         Argument given to verifier_start
+ */
+
+typedef void (*verifier_callback) (const void* stack, const char* name, int errcode, void* arg);
+
+//------------------------------------------------------------------------------
+/*! @brief   Decides which checks of a sampled policy run: every check_period
+ *           one, and no more often than check_budget of the time allows.
+ */
+
+template <typename POLICY>
+struct CheckGate
+{
+    uint64_t checks = 0;
+    uint64_t polls  = 0;
+    uint64_t next   = 0;    // cycles when the next check may run
+
+    bool Due ()
+    {
+        if constexpr (POLICY::check_period > 1)
+            if (++checks % POLICY::check_period != 0) return false;
+
+        // reading the clock costs as much as a small check, it is read rarely
+        if constexpr (POLICY::check_budget > 0)
+            if ((++polls % CHECK_CLOCK_PERIOD != 0) || (stats_cycles() < next)) return false;
+
+        return true;
+    }
+
+    // a check that took c cycles is followed by c * (1 / budget - 1) without checks
+    void Done (uint64_t start)
+    {
+        if constexpr (POLICY::check_budget > 0)
+        {
+            uint64_t end = stats_cycles();
+            next = end + (uint64_t)((end - start) * (1.0 / POLICY::check_budget - 1.0));
+        }
+    }
+};
+
+struct CheckGateOff
+{
+    bool Due  ()         { return true; }
+    void Done (uint64_t) { }
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Lock of a stack with a background policy. The owner takes it for
+ *           every change of the stack, the verifier for every chunk it
+ *           verifies, so the owner waits for one chunk at most.
+ */
+
+struct VerifyLock
+{
+    std::atomic<bool> locked  { false };
+    bool              watched = false;
+
+    void Lock ()
+    {
+        while (locked.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+    }
+
+    void Unlock ()
+    {
+        locked.store(false, std::memory_order_release);
+    }
+};
+
+struct VerifyLockOff
+{
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Holds the lock of a stack in the scope it is declared in.
+ */
+
+struct VerifyScope
+{
+    VerifyLock* lock;
+
+    VerifyScope (VerifyLock& stack_lock) :
+        lock (&stack_lock)
+    {
+        lock->Lock();
+    }
+
+   ~VerifyScope ()
+    {
+        lock->Unlock();
+    }
+};
+
+struct VerifyScopeOff
+{
+    VerifyScopeOff (const VerifyLockOff&) { }
+};
+
+//------------------------------------------------------------------------------
+/*! @brief   Add a stack to the ones the background verifier checks.
+ *
+ *  @param   stack       Pointer to the stack
+ *  @param   name        Name of the stack
+ *  @param   id          Id of the stack, tells it from a later stack at the
+ *                       same address
+ *  @param   verify      Function verifying a chunk of the stack
+ *
+ *  @return  true if the stack was added
+ */
+
+bool verifier_watch (const void* stack, const char* name, int id, verifier_function verify);
+
+//------------------------------------------------------------------------------
+/*! @brief   Remove a stack from the watched ones, waits if the verifier is
+ *           checking it.
+ *
+ *  @param   stack       Pointer to the stack
+ */
+
+void verifier_unwatch (const void* stack);
+
+//------------------------------------------------------------------------------
+/*! @brief   Start the thread verifying all the watched stacks periodically.
+ *           Errors are written to the log if there is no callback.
+ *
+ *  @param   period_ms   Period in milliseconds
+ *  @param   callback    Function getting the errors, may be nullptr
+ *  @param   arg         Argument of the callback
+ *
+ *  @return  true if the verifier was started
+ */
+
+bool verifier_start (unsigned period_ms, verifier_callback callback = nullptr, void* arg = nullptr);
+
+//------------------------------------------------------------------------------
+/*! @brief   Stop the verifier thread.
+ */
+
+void verifier_stop ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Verify all the watched stacks once in the calling thread.
+ *
+ *  @param   callback    Function getting the errors, may be nullptr
+ *  @param   arg         Argument of the callback
+ *
+ *  @return  number of stacks with errors
+ */
+
+size_t verifier_run (verifier_callback callback = nullptr, void* arg = nullptr);
+
+//------------------------------------------------------------------------------
+
+#endif // VERIFIER_H_INCLUDED
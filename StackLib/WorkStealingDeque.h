@@ -0,0 +1,222 @@
+/*------------------------------------------------------------------------------
+    * File:        WorkStealingDeque.h                                         *
+    * Description: Chase-Lev work-stealing deque: the owner thread pushes and  *
+                   pops at the bottom like a stack, other threads steal from   *
+                   the top.                                                    *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#ifndef WORK_STEALING_DEQUE_H_INCLUDED
+#define WORK_STEALING_DEQUE_H_INCLUDED
+
+#define _CRT_SECURE_NO_WARNINGS
+
+
+#include "Stack.h"
+#include <atomic>
+
+#define newWorkStealingDeque(NAME, STK_TYPE, ...) \
+        WorkStealingDeque<STK_TYPE, ##__VA_ARGS__> NAME ((char*)#NAME);
+
+
+//------------------------------------------------------------------------------
+/*! @brief   Work-stealing deque of TYPE values (tasks). Push and Pop may be
+ *           called only by the owner thread and need no atomic read-modify-
+ *           write unless one value is left, Steal may be called by any thread.
+ *           The buffer is a ring, it grows like Stack::Expand by the growth
+ *           factor up to the maximum capacity, free slots are filled with
+ *           POISON. Old buffers are kept until the deque is destructed,
+ *           because a thief may still read them.
+ *
+ *  @tparam  TYPE        Type of values, trivially copyable
+ *  @tparam  POLICY      Protection policy (see StackConfig.h): with check the
+ *                       owner operations verify the indices, with poison
+ *                       popped slots are filled with POISON.
+ */
+
+template <typename TYPE, typename POLICY = Checked>
+class WorkStealingDeque
+{
+    static_assert(std::is_trivially_copyable<TYPE>::value, "work-stealing deque values must be trivially copyable");
+
+private:
+
+    struct Buffer
+    {
+        size_t              capacity = 0;
+        std::atomic<TYPE>*  data     = nullptr;
+        Buffer*             prev     = nullptr;
+    };
+
+    char*  name_         = nullptr;
+    size_t max_capacity_ = MAX_CAPACITY;
+    double growth_       = DEFAULT_STACK_GROWTH;
+
+    int id_ = 0;
+
+    alignas(64) std::atomic<long long> top_;
+    alignas(64) std::atomic<long long> bottom_;
+    std::atomic<Buffer*>               buffer_;
+
+public:
+
+//------------------------------------------------------------------------------
+/*! @brief   Work-stealing deque constructor.
+ *
+ *  @param   stack_name  Deque variable name
+ *  @param   capacity    Initial capacity, a power of two is not required
+ */
+
+    WorkStealingDeque (char* stack_name, size_t capacity = DEFAULT_STACK_CAPACITY);
+
+    WorkStealingDeque (const WorkStealingDeque& obj) = delete;
+
+    WorkStealingDeque& operator = (const WorkStealingDeque& obj) = delete;
+
+//------------------------------------------------------------------------------
+/*! @brief   Work-stealing deque destructor. No thread may use the deque anymore.
+ */
+
+   ~WorkStealingDeque ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Pushing a value to the bottom. Owner thread only.
+ *
+ *  @param   value       Value to push
+ *
+ *  @return  error code, STACK_FULL if the maximum capacity is reached
+ */
+
+    int Push (TYPE value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping from the bottom. Owner thread only.
+ *
+ *  @return  value if present, otherwise POISON
+ */
+
+    TYPE Pop ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Popping from the bottom. Owner thread only.
+ *
+ *  @param   value       Popped value
+ *
+ *  @return  STACK_OK or STACK_EMPTY_STACK
+ */
+
+    int Pop (TYPE& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Stealing from the top. Any thread.
+ *
+ *  @return  value if stolen, otherwise POISON
+ */
+
+    TYPE Steal ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Stealing from the top. Any thread.
+ *
+ *  @param   value       Stolen value
+ *
+ *  @return  STACK_OK, STACK_EMPTY_STACK or STACK_STEAL_LOST if another thread
+ *           took the value first
+ */
+
+    int Steal (TYPE& value);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the number of values at the moment of the call.
+ *
+ *  @return  number of values
+ */
+
+    size_t getSize () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get capacity of the current buffer.
+ *
+ *  @return  capacity
+ */
+
+    size_t getCapacity () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Get name of the deque.
+ *
+ *  @return  deque name
+ */
+
+    const char* getName () const;
+
+//------------------------------------------------------------------------------
+/*! @brief   Set the maximum capacity the deque can grow to. Owner thread only.
+ *
+ *  @param   max_capacity  Maximum capacity, not less than the current one
+ *
+ *  @return  error code
+ */
+
+    int setMaxCapacity (size_t max_capacity);
+
+//------------------------------------------------------------------------------
+/*! @brief   Set how many times the capacity is increased when the deque grows.
+ *           Owner thread only.
+ *
+ *  @param   growth      Growth factor, bigger than 1
+ *
+ *  @return  error code
+ */
+
+    int setGrowth (double growth);
+
+/*------------------------------------------------------------------------------
+                   Private functions                                           *
+*///----------------------------------------------------------------------------
+
+private:
+
+//------------------------------------------------------------------------------
+/*! @brief   Filling the free slots of a buffer with POISON.
+ *
+ *  @param   buf         Buffer
+ *  @param   top         Index of the top value
+ *  @param   bottom      Index after the bottom value
+ */
+
+    void fillPoison (Buffer* buf, long long top, long long bottom);
+
+//------------------------------------------------------------------------------
+/*! @brief   Move the values to a bigger buffer.
+ *
+ *  @param   top         Index of the top value
+ *  @param   bottom      Index after the bottom value
+ *
+ *  @return  new buffer, nullptr if the maximum capacity is reached
+ */
+
+    Buffer* Expand (long long top, long long bottom);
+
+//------------------------------------------------------------------------------
+/*! @brief   Allocate a buffer.
+ *
+ *  @param   capacity    Capacity of the buffer
+ *
+ *  @return  buffer
+ */
+
+    static Buffer* NewBuffer (size_t capacity);
+
+//------------------------------------------------------------------------------
+};
+
+//------------------------------------------------------------------------------
+
+#include "WorkStealingDeque.ipp"
+
+#endif // WORK_STEALING_DEQUE_H_INCLUDED
@@ -0,0 +1,276 @@
+/*------------------------------------------------------------------------------
+    * File:        WorkStealingDeque.ipp                                       *
+    * Description: Implementations of work-stealing deque functions.           *
+    * Created:     1 dec 2020                                                  *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+WorkStealingDeque<TYPE, POLICY>::WorkStealingDeque (char* stack_name, size_t capacity) :
+    name_   (stack_name),
+    id_     (stack_id++),
+    top_    (0),
+    bottom_ (0),
+    buffer_ (nullptr)
+{
+    STACK_ASSERTOK((capacity > MAX_CAPACITY),   STACK_WRONG_INPUT_CAPACITY_VALUE_BIG);
+    STACK_ASSERTOK((capacity == 0),             STACK_WRONG_INPUT_CAPACITY_VALUE_NIL);
+    STACK_ASSERTOK((stack_name == nullptr),     STACK_WRONG_INPUT_STACK_NAME);
+
+    Buffer* buf = NewBuffer(capacity);
+
+    fillPoison(buf, 0, 0);
+
+    buffer_.store(buf, std::memory_order_release);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+WorkStealingDeque<TYPE, POLICY>::~WorkStealingDeque ()
+{
+    Buffer* buf = buffer_.load();
+
+    while (buf != nullptr)
+    {
+        Buffer* prev = buf->prev;
+
+        delete [] buf->data;
+        delete buf;
+
+        buf = prev;
+    }
+
+    buffer_.store(nullptr);
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int WorkStealingDeque<TYPE, POLICY>::Push (TYPE value)
+{
+    long long b   = bottom_.load(std::memory_order_relaxed);
+    long long t   = top_.load(std::memory_order_acquire);
+    Buffer*   buf = buffer_.load(std::memory_order_relaxed);
+
+    if constexpr (POLICY::check) STACK_ASSERTOK(((b < t) || (b - t > (long long)buf->capacity)), STACK_SIZE_BIGGER_CAPACITY);
+
+    if (b - t >= (long long)buf->capacity)
+    {
+        buf = Expand(t, b);
+
+        if (buf == nullptr) return STACK_FULL;
+    }
+
+    buf->data[b % buf->capacity].store(value, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+TYPE WorkStealingDeque<TYPE, POLICY>::Pop ()
+{
+    TYPE value {};
+
+    if (Pop(value) == STACK_OK) return value;
+
+    if constexpr (HAS_POISON<TYPE>) return POISON<TYPE>;
+    else                            return TYPE {};
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int WorkStealingDeque<TYPE, POLICY>::Pop (TYPE& value)
+{
+    long long b   = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer*   buf = buffer_.load(std::memory_order_relaxed);
+
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    long long t = top_.load(std::memory_order_relaxed);
+
+    if constexpr (POLICY::check) STACK_ASSERTOK((b - t >= (long long)buf->capacity), STACK_SIZE_BIGGER_CAPACITY);
+
+    if (t > b)
+    {
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return STACK_EMPTY_STACK;
+    }
+
+    std::atomic<TYPE>* slot = &buf->data[b % buf->capacity];
+
+    value = slot->load(std::memory_order_relaxed);
+
+    if (t == b)
+    {
+        // the last value, race with thieves for it
+        bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+
+        bottom_.store(b + 1, std::memory_order_relaxed);
+
+        return won ? STACK_OK : STACK_EMPTY_STACK;
+    }
+
+    if constexpr (POLICY::poison && HAS_POISON<TYPE>) slot->store(POISON<TYPE>, std::memory_order_relaxed);
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+TYPE WorkStealingDeque<TYPE, POLICY>::Steal ()
+{
+    TYPE value {};
+
+    if (Steal(value) == STACK_OK) return value;
+
+    if constexpr (HAS_POISON<TYPE>) return POISON<TYPE>;
+    else                            return TYPE {};
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int WorkStealingDeque<TYPE, POLICY>::Steal (TYPE& value)
+{
+    long long t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long b = bottom_.load(std::memory_order_acquire);
+
+    if (t >= b) return STACK_EMPTY_STACK;
+
+    Buffer* buf = buffer_.load(std::memory_order_acquire);
+
+    TYPE stolen = buf->data[t % buf->capacity].load(std::memory_order_relaxed);
+
+    if (! top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return STACK_STEAL_LOST;
+
+    value = stolen;
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t WorkStealingDeque<TYPE, POLICY>::getSize () const
+{
+    long long b = bottom_.load(std::memory_order_relaxed);
+    long long t = top_.load(std::memory_order_relaxed);
+
+    return (b > t) ? (size_t)(b - t) : 0;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+size_t WorkStealingDeque<TYPE, POLICY>::getCapacity () const
+{
+    return buffer_.load(std::memory_order_relaxed)->capacity;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+const char* WorkStealingDeque<TYPE, POLICY>::getName () const
+{
+    return name_;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int WorkStealingDeque<TYPE, POLICY>::setMaxCapacity (size_t max_capacity)
+{
+    if (max_capacity < getCapacity()) return STACK_CAPACITY_WRONG_VALUE;
+
+    max_capacity_ = max_capacity;
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+int WorkStealingDeque<TYPE, POLICY>::setGrowth (double growth)
+{
+    if (! (growth > 1.0)) return STACK_WRONG_INPUT_GROWTH;
+
+    growth_ = growth;
+
+    return STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+void WorkStealingDeque<TYPE, POLICY>::fillPoison (Buffer* buf, long long top, long long bottom)
+{
+    assert(buf != nullptr);
+
+    if constexpr (POLICY::poison && HAS_POISON<TYPE>)
+    {
+        for (long long i = bottom; i < top + (long long)buf->capacity; ++i)
+        {
+            buf->data[i % buf->capacity].store(POISON<TYPE>, std::memory_order_relaxed);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+typename WorkStealingDeque<TYPE, POLICY>::Buffer* WorkStealingDeque<TYPE, POLICY>::Expand (long long top, long long bottom)
+{
+    Buffer* old = buffer_.load(std::memory_order_relaxed);
+
+    if (old->capacity >= max_capacity_) return nullptr;
+
+    double next     = old->capacity * growth_;
+    size_t capacity = (next >= (double)max_capacity_)   ? max_capacity_     :
+                      ((size_t)next > old->capacity)    ? (size_t)next      : old->capacity + 1;
+
+    Buffer* buf = NewBuffer(capacity);
+
+    for (long long i = top; i < bottom; ++i)
+    {
+        buf->data[i % buf->capacity].store(old->data[i % old->capacity].load(std::memory_order_relaxed),
+                                           std::memory_order_relaxed);
+    }
+
+    fillPoison(buf, top, bottom);
+
+    buf->prev = old;
+    buffer_.store(buf, std::memory_order_release);
+
+    return buf;
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE, typename POLICY>
+typename WorkStealingDeque<TYPE, POLICY>::Buffer* WorkStealingDeque<TYPE, POLICY>::NewBuffer (size_t capacity)
+{
+    Buffer* buf = new (std::nothrow) Buffer;
+    STACK_ASSERTOK((buf == nullptr), STACK_NO_MEMORY);
+
+    buf->capacity = capacity;
+    buf->data     = new (std::nothrow) std::atomic<TYPE>[capacity];
+    STACK_ASSERTOK((buf->data == nullptr), STACK_NO_MEMORY);
+
+    return buf;
+}
+
+//------------------------------------------------------------------------------
@@ -10,6 +10,62 @@
     *///------------------------------------------------------------------------
 
 #include "hash.h"
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+#if defined (__x86_64__) || defined (__i386__)
+    #include <immintrin.h>
+    #define HASH_X86
+#endif
+
+typedef hash_t (*hash_func_t) (const void* buf, size_t size);
+
+static const hash_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const hash_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const hash_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const hash_t PRIME32_1 = 0x9E3779B1ULL;
+
+static const size_t LANES_NUM    = 4;
+static const size_t STRIPE_SIZE  = LANES_NUM * sizeof(hash_t);
+static const size_t STRIPES_NUM  = 16;
+
+static std::atomic<hash_func_t> hash_impl   (nullptr);
+static std::atomic<int>         hash_engine (HASH_ENGINE_AUTO);
+
+//------------------------------------------------------------------------------
+
+static inline hash_t rotl64 (hash_t x, unsigned n)
+{
+    n &= 63;
+    return (x << n) | (x >> ((64 - n) & 63));
+}
+
+static inline hash_t rotr64 (hash_t x, unsigned n)
+{
+    n &= 63;
+    return (x >> n) | (x << ((64 - n) & 63));
+}
+
+static inline hash_t load64 (const char* p)
+{
+    hash_t word = 0;
+    memcpy(&word, p, sizeof(word));
+
+    return word;
+}
+
+static inline hash_t avalanche (hash_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
 
 //------------------------------------------------------------------------------
 
@@ -20,109 +76,387 @@ int bit_rotate (void* buf, size_t size, int dir)
     if ((size == 0) || (dir == 0))
         return 0;
 
-    char* carry_bits = (char*)calloc(size, 1);
-    if (carry_bits == nullptr)
-        return 0;
+    size_t bits  = size * 8;
+    size_t shift = (dir > 0) ? (size_t)dir % bits : bits - (size_t)(-(long long)dir) % bits;
+    shift %= bits;
+
+    switch (size)
+    {
+    case 1: { uint8_t  x; memcpy(&x, buf, 1); x = (uint8_t) ((x >> shift) | (x << ((8  - shift) & 7 ))); memcpy(buf, &x, 1); return 1; }
+    case 2: { uint16_t x; memcpy(&x, buf, 2); x = (uint16_t)((x >> shift) | (x << ((16 - shift) & 15))); memcpy(buf, &x, 2); return 1; }
+    case 4: { uint32_t x; memcpy(&x, buf, 4); x = (x >> shift) | (x << ((32 - shift) & 31));              memcpy(buf, &x, 4); return 1; }
+    case 8: { hash_t   x; memcpy(&x, buf, 8); x = rotr64(x, (unsigned)shift);                               memcpy(buf, &x, 8); return 1; }
+    default: break;
+    }
+
+    unsigned char* bytes = (unsigned char*)buf;
 
-    if (dir > 0)
+    std::rotate(bytes, bytes + shift / 8, bytes + size);
+
+    unsigned bit_shift = shift % 8;
+    if (bit_shift != 0)
     {
-        dir = dir % (size * 8);
-        for (int i = 0; i < dir; ++i)
+        unsigned char first = bytes[0];
+        for (size_t byte_i = 0; byte_i < size - 1; ++byte_i)
         {
-            for (int byte_i = 0; byte_i < size; ++byte_i)
-            {
-                carry_bits[byte_i] = *((char*)buf + byte_i) & 1;
-            }
+            bytes[byte_i] = (unsigned char)((bytes[byte_i] >> bit_shift) | (bytes[byte_i + 1] << (8 - bit_shift)));
+        }
+        bytes[size - 1] = (unsigned char)((bytes[size - 1] >> bit_shift) | (first << (8 - bit_shift)));
+    }
 
-            for (int byte_i = 0; byte_i < size - 1; ++byte_i)
-            {
-                char byte = *((char*)buf + byte_i);
-                byte = byte >> 1;
-                byte = (byte & 127) | (128 * carry_bits[byte_i + 1]);
+    return 1;
+}
 
-                ((char*)buf)[byte_i] = byte;
-            }
+//------------------------------------------------------------------------------
+/*! @brief   Hash of the first version of this library. The buffer was copied
+ *           to a zero padded one and every byte was turned round with
+ *           bit_rotate, which set a byte to 0xFF when turning left a byte with
+ *           the highest bit. Both are reproduced here without allocations.
+ */
+
+static inline char compat_byte (const char* buf, size_t size, size_t i)
+{
+    return (i < size) ? buf[i] : 0;
+}
 
-            char byte = *((char*)buf + size - 1);
-            byte = byte >> 1;
-            byte = (byte & 127) | (128 * carry_bits[0]);
+static inline char compat_rotate_right (char byte, size_t n)
+{
+    unsigned char b = (unsigned char)byte;
+    n %= 8;
 
-            ((char*)buf)[size - 1] = byte;
-        }
+    return (char)((n == 0) ? b : (unsigned char)((b >> n) | (b << (8 - n))));
+}
+
+static inline char compat_rotate_left (char byte, size_t n)
+{
+    unsigned char b = (unsigned char)byte;
+    n %= 8;
+
+    if (n == 0) return byte;
+
+    return (char)(((b >> (8 - n)) != 0) ? 0xFF : (unsigned char)(b << n));
+}
+
+static hash_t hash_compat (const void* buf, size_t size)
+{
+    const char* bytes = (const char*)buf;
+
+    size_t main_size = (size / BLOCK_SIZE) * BLOCK_SIZE + BLOCK_SIZE;
+    size_t half_size = main_size / 2;
+
+    hash_t hsh = (hash_t)(Keys[size % KEYS_NUM]);
+
+    for (size_t byte_i = 0; byte_i < half_size; ++byte_i)
+    {
+        char b1 = compat_byte(bytes, size, byte_i);
+        char b2 = compat_byte(bytes, size, byte_i + half_size);
+
+        int dir1 = (int)(1 + byte_i);
+        int dir2 = (int)(1 - byte_i);
+
+        char p1 = (dir1 > 0) ? compat_rotate_right(b1, dir1) : compat_rotate_left(b1, -dir1);
+        char p2 = (dir2 > 0) ? compat_rotate_right(b2, dir2) : compat_rotate_left(b2, -dir2);
+
+        int q1 = (int)(b2 ^ p1 ^ (Keys[ byte_i      % KEYS_NUM] + b1));
+        int q2 = (int)(b1 ^ p2 ^ (Keys[(byte_i + 1) % KEYS_NUM] + b2));
+
+        char d1 = compat_byte(bytes, size, main_size - 1 - byte_i);
+        char d2 = compat_byte(bytes, size, half_size - 1 - byte_i);
+
+        int mul = (int)((unsigned)q1 * (unsigned)d2 + (unsigned)q2 * (unsigned)d1);
+        int sum = (int)((unsigned)q1 * (unsigned)d1 + (unsigned)q2 * (unsigned)d2 +
+                        (unsigned)q1 + (unsigned)q2 + (unsigned)b1 + (unsigned)b2);
+
+        hsh = (hsh * (hash_t)mul + hsh) ^ (hash_t)sum;
+
+        hsh = rotr64(hsh, 3);
     }
-    else
+
+    return hsh;
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Word engines. The buffer is read by stripes of four 64-bit lanes,
+ *           every lane is accumulated with a 32x32 multiplication, so that
+ *           SSE2 and AVX2 versions give exactly the same hash as the scalar.
+ */
+
+static inline hash_t lane_key (size_t lane)
+{
+    return (hash_t)Keys[4 + lane] | ((hash_t)Keys[8 + lane] << 32);
+}
+
+static inline void init_lanes (hash_t* acc, hash_t seed)
+{
+    for (size_t lane = 0; lane < LANES_NUM; ++lane)
+    {
+        acc[lane] = (hash_t)Keys[lane] * PRIME64_1 ^ seed;
+    }
+}
+
+static hash_t merge_lanes (const hash_t* acc, const char* tail, size_t tail_size, size_t size, hash_t seed)
+{
+    hash_t h = seed + (hash_t)size * PRIME64_1;
+
+    for (size_t lane = 0; lane < LANES_NUM; ++lane)
+    {
+        h ^= avalanche(acc[lane]);
+        h  = rotl64(h, 27) * PRIME64_1 + PRIME64_3;
+    }
+
+    for (; tail_size >= sizeof(hash_t); tail_size -= sizeof(hash_t), tail += sizeof(hash_t))
+    {
+        hash_t k = rotl64(load64(tail) * PRIME64_2, 31) * PRIME64_1;
+        h ^= k;
+        h  = rotl64(h, 27) * PRIME64_1 + PRIME64_3;
+    }
+
+    for (; tail_size > 0; --tail_size, ++tail)
+    {
+        h ^= (hash_t)(unsigned char)*tail * PRIME64_3;
+        h  = rotl64(h, 11) * PRIME64_1;
+    }
+
+    return avalanche(h);
+}
+
+static hash_t hash_scalar (const void* buf, size_t size)
+{
+    const char* p = (const char*)buf;
+    hash_t seed   = (hash_t)Keys[size % KEYS_NUM];
+
+    hash_t acc[LANES_NUM] = {};
+    init_lanes(acc, seed);
+
+    size_t stripes = size / STRIPE_SIZE;
+    for (size_t stripe = 0; stripe < stripes; ++stripe, p += STRIPE_SIZE)
     {
-        dir = -dir % (size * 8);
+        for (size_t lane = 0; lane < LANES_NUM; ++lane)
+        {
+            hash_t x = load64(p + lane * sizeof(hash_t));
+            hash_t k = x ^ lane_key(lane);
+
+            acc[lane] += (k & 0xFFFFFFFFULL) * (k >> 32) + x;
+        }
 
-        for (int i = 0; i < dir; ++i)
+        if ((stripe + 1) % STRIPES_NUM == 0)
         {
-            for (int byte_i = 0; byte_i < size; ++byte_i)
+            for (size_t lane = 0; lane < LANES_NUM; ++lane)
             {
-                carry_bits[byte_i] = *((char*)buf + byte_i) & 128;
+                acc[lane] = (acc[lane] ^ (acc[lane] >> 47) ^ lane_key(lane)) * PRIME32_1;
             }
+        }
+    }
 
-            for (int byte_i = size - 1; byte_i > 0; --byte_i)
-            {
-                char byte = *((char*)buf + byte_i);
-                byte = byte << 1;
-                byte = (byte & 254) | (carry_bits[byte_i - 1] / 128);
+    return merge_lanes(acc, p, size % STRIPE_SIZE, size, seed);
+}
 
-                ((char*)buf)[byte_i] = byte;
-            }
+#ifdef HASH_X86
+
+__attribute__((target("sse2")))
+static hash_t hash_sse2 (const void* buf, size_t size)
+{
+    const char* p = (const char*)buf;
+    hash_t seed   = (hash_t)Keys[size % KEYS_NUM];
+
+    alignas(16) hash_t acc[LANES_NUM] = {};
+    init_lanes(acc, seed);
+
+    __m128i acc0  = _mm_load_si128((const __m128i*)acc);
+    __m128i acc1  = _mm_load_si128((const __m128i*)acc + 1);
+    __m128i key0  = _mm_set_epi64x((long long)lane_key(1), (long long)lane_key(0));
+    __m128i key1  = _mm_set_epi64x((long long)lane_key(3), (long long)lane_key(2));
+    __m128i prime = _mm_set1_epi32((int)PRIME32_1);
+
+    size_t stripes = size / STRIPE_SIZE;
+    for (size_t stripe = 0; stripe < stripes; ++stripe, p += STRIPE_SIZE)
+    {
+        __m128i x0 = _mm_loadu_si128((const __m128i*)p);
+        __m128i x1 = _mm_loadu_si128((const __m128i*)p + 1);
+        __m128i k0 = _mm_xor_si128(x0, key0);
+        __m128i k1 = _mm_xor_si128(x1, key1);
+
+        acc0 = _mm_add_epi64(acc0, _mm_add_epi64(_mm_mul_epu32(k0, _mm_srli_epi64(k0, 32)), x0));
+        acc1 = _mm_add_epi64(acc1, _mm_add_epi64(_mm_mul_epu32(k1, _mm_srli_epi64(k1, 32)), x1));
+
+        if ((stripe + 1) % STRIPES_NUM == 0)
+        {
+            __m128i a0 = _mm_xor_si128(_mm_xor_si128(acc0, _mm_srli_epi64(acc0, 47)), key0);
+            __m128i a1 = _mm_xor_si128(_mm_xor_si128(acc1, _mm_srli_epi64(acc1, 47)), key1);
+
+            acc0 = _mm_add_epi64(_mm_mul_epu32(a0, prime), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(a0, 32), prime), 32));
+            acc1 = _mm_add_epi64(_mm_mul_epu32(a1, prime), _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(a1, 32), prime), 32));
+        }
+    }
 
-            char byte = *((char*)buf);
-            byte = byte << 1;
-            byte = (byte & 254) | (carry_bits[size - 1] / 128);
+    _mm_store_si128((__m128i*)acc,     acc0);
+    _mm_store_si128((__m128i*)acc + 1, acc1);
 
-            ((char*)buf)[0] = byte;
+    return merge_lanes(acc, p, size % STRIPE_SIZE, size, seed);
+}
+
+__attribute__((target("avx2")))
+static hash_t hash_avx2 (const void* buf, size_t size)
+{
+    const char* p = (const char*)buf;
+    hash_t seed   = (hash_t)Keys[size % KEYS_NUM];
+
+    alignas(32) hash_t acc[LANES_NUM] = {};
+    init_lanes(acc, seed);
+
+    __m256i acc0  = _mm256_load_si256((const __m256i*)acc);
+    __m256i key0  = _mm256_set_epi64x((long long)lane_key(3), (long long)lane_key(2),
+                                      (long long)lane_key(1), (long long)lane_key(0));
+    __m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+
+    size_t stripes = size / STRIPE_SIZE;
+    for (size_t stripe = 0; stripe < stripes; ++stripe, p += STRIPE_SIZE)
+    {
+        __m256i x0 = _mm256_loadu_si256((const __m256i*)p);
+        __m256i k0 = _mm256_xor_si256(x0, key0);
+
+        acc0 = _mm256_add_epi64(acc0, _mm256_add_epi64(_mm256_mul_epu32(k0, _mm256_srli_epi64(k0, 32)), x0));
+
+        if ((stripe + 1) % STRIPES_NUM == 0)
+        {
+            __m256i a0 = _mm256_xor_si256(_mm256_xor_si256(acc0, _mm256_srli_epi64(acc0, 47)), key0);
+
+            acc0 = _mm256_add_epi64(_mm256_mul_epu32(a0, prime),
+                                    _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a0, 32), prime), 32));
         }
     }
 
-    free(carry_bits);
+    _mm256_store_si256((__m256i*)acc, acc0);
+
+    // gcc does not always put it for target("avx2") functions, and dirty
+    // upper halves make every following SSE instruction of the caller slow
+    _mm256_zeroupper();
+
+    return merge_lanes(acc, p, size % STRIPE_SIZE, size, seed);
+}
+
+#endif // HASH_X86
+
+//------------------------------------------------------------------------------
+
+static hash_func_t hash_select (int engine)
+{
+    switch (engine)
+    {
+    case HASH_ENGINE_COMPAT: return hash_compat;
+    case HASH_ENGINE_SCALAR: return hash_scalar;
+
+#ifdef HASH_X86
+    case HASH_ENGINE_SSE2:   return hash_engine_supported(HASH_ENGINE_SSE2) ? hash_sse2 : nullptr;
+    case HASH_ENGINE_AVX2:   return hash_engine_supported(HASH_ENGINE_AVX2) ? hash_avx2 : nullptr;
+#endif // HASH_X86
+
+    case HASH_ENGINE_AUTO:
+#ifdef HASH_COMPAT
+        return hash_compat;
+#else
+        if (hash_engine_supported(HASH_ENGINE_AVX2)) return hash_select(HASH_ENGINE_AVX2);
+        if (hash_engine_supported(HASH_ENGINE_SSE2)) return hash_select(HASH_ENGINE_SSE2);
+        return hash_scalar;
+#endif // HASH_COMPAT
+
+    default: return nullptr;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int hash_engine_supported (int engine)
+{
+    switch (engine)
+    {
+    case HASH_ENGINE_AUTO:
+    case HASH_ENGINE_COMPAT:
+    case HASH_ENGINE_SCALAR: return 1;
+
+#ifdef HASH_X86
+    case HASH_ENGINE_SSE2:   __builtin_cpu_init(); return __builtin_cpu_supports("sse2") ? 1 : 0;
+    case HASH_ENGINE_AVX2:   __builtin_cpu_init(); return __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif // HASH_X86
+
+    default: return 0;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int hash_set_engine (int engine)
+{
+    hash_func_t func = hash_select(engine);
+    if (func == nullptr)
+        return 0;
+
+    hash_impl.store(func);
+    hash_engine.store(engine);
 
     return 1;
 }
 
 //------------------------------------------------------------------------------
 
-hash_t hash (void* buf, size_t size)
+int hash_get_engine ()
 {
-    assert(buf != nullptr);
+    return hash_engine.load();
+}
 
-    size_t main_size = (size / BLOCK_SIZE) * BLOCK_SIZE + BLOCK_SIZE;
-    size_t half_size = main_size / 2;
+//------------------------------------------------------------------------------
 
-    char* buf_main = (char*)calloc(main_size, 1);
-    if (buf_main == nullptr)
+hash_t hash_with (int engine, const void* buf, size_t size)
+{
+    assert(buf != nullptr);
+
+    hash_func_t func = hash_select(engine);
+    if (func == nullptr)
         return 0;
 
-    memcpy(buf_main, buf, size);
-    hash_t hsh = (hash_t)(Keys[size % KEYS_NUM]);
+    return func(buf, size);
+}
 
-    for (size_t byte_i = 0; byte_i < half_size; ++byte_i)
-    {
-        char b1 = *((char*)buf_main + byte_i);
-        char b2 = *((char*)buf_main + byte_i + half_size);
+//------------------------------------------------------------------------------
 
-        char p1 = b1;
-        char p2 = b2;
+hash_t hash_stable (const void* buf, size_t size)
+{
+    assert(buf != nullptr);
 
-        bit_rotate(&p1, 1, 1 + byte_i);
-        bit_rotate(&p2, 1, 1 - byte_i);
+    static const hash_func_t func =
+        hash_engine_supported(HASH_ENGINE_AVX2) ? hash_select(HASH_ENGINE_AVX2) :
+        hash_engine_supported(HASH_ENGINE_SSE2) ? hash_select(HASH_ENGINE_SSE2) :
+                                                  hash_scalar;
 
-        int q1 = b2 ^ p1 ^ Keys[ byte_i      % KEYS_NUM] + b1;
-        int q2 = b1 ^ p2 ^ Keys[(byte_i + 1) % KEYS_NUM] + b2;
+    return func(buf, size);
+}
 
-        char d1 = *((char*)buf_main - 1 - byte_i + main_size);
-        char d2 = *((char*)buf_main - 1 - byte_i + half_size);
+//------------------------------------------------------------------------------
 
-        hsh = hsh * (q1*d2 + q2*d1) + hsh ^ (q1*d1 + q2*d2) + q1 + q2 + b1 + b2;
+hash_t hash (const void* buf, size_t size)
+{
+    assert(buf != nullptr);
 
-        bit_rotate(&hsh, sizeof(hsh), 3);
+    hash_func_t func = hash_impl.load(std::memory_order_relaxed);
+    if (func == nullptr)
+    {
+        func = hash_select(HASH_ENGINE_AUTO);
+        hash_impl.store(func);
     }
-    free(buf_main);
 
-    return hsh;
+    return func(buf, size);
+}
+
+//------------------------------------------------------------------------------
+
+hash_t hash_mix (hash_t block_hash, size_t block)
+{
+    hash_t h = block_hash ^ ((hash_t)block * 0x9E3779B97F4A7C15ULL);
+
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+
+    return h ^ (h >> 31);
 }
 
 //------------------------------------------------------------------------------
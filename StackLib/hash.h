@@ -41,6 +41,24 @@ static const size_t Keys[KEYS_NUM] =
     0xda592d93, 0x2696c964, 0xb26d365b, 0x25936934,
 };
 
+enum HashEngines
+{
+    HASH_ENGINE_AUTO = 0 ,
+    HASH_ENGINE_COMPAT   ,
+    HASH_ENGINE_SCALAR   ,
+    HASH_ENGINE_SSE2     ,
+    HASH_ENGINE_AVX2     ,
+};
+
+char const * const hash_engine_names[] =
+{
+    "auto"   ,
+    "compat" ,
+    "scalar" ,
+    "sse2"   ,
+    "avx2"   ,
+};
+
 //------------------------------------------------------------------------------
 /*! @brief   Circular shift of bits anywhere in any length.
  *
@@ -54,7 +72,7 @@ static const size_t Keys[KEYS_NUM] =
 int bit_rotate (void* buf, size_t size, int dir);
 
 //------------------------------------------------------------------------------
-/*! @brief   Hash counting.
+/*! @brief   Hash counting with the current engine (see hash_set_engine).
  *
  *  @param   buf  Start of memory to be hashable
  *  @param   size Size of memory to be hashable
@@ -62,7 +80,78 @@ int bit_rotate (void* buf, size_t size, int dir);
  *  @return  0 if error, else hash
  */
 
-hash_t hash (void* buf, size_t size);
+hash_t hash (const void* buf, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Hash counting with the given engine. Scalar, SSE2 and AVX2 engines
+ *           give the same hash, compat engine gives the hash of the first
+ *           byte-at-a-time version of this library.
+ *
+ *  @param   engine Hash engine
+ *  @param   buf    Start of memory to be hashable
+ *  @param   size   Size of memory to be hashable
+ *
+ *  @return  0 if error, else hash
+ */
+
+hash_t hash_with (int engine, const void* buf, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Hash counting for data kept outside of the process (files,
+ *           snapshots). It is always the hash of the scalar engine, counted
+ *           by the fastest engine giving it, so it does not depend on
+ *           hash_set_engine or HASH_COMPAT.
+ *
+ *  @param   buf  Start of memory to be hashable
+ *  @param   size Size of memory to be hashable
+ *
+ *  @return  0 if error, else hash
+ */
+
+hash_t hash_stable (const void* buf, size_t size);
+
+//------------------------------------------------------------------------------
+/*! @brief   Select the engine used by hash(). By default the fastest engine
+ *           supported by the CPU is used, or compat engine if HASH_COMPAT
+ *           was defined while compiling hash.cpp.
+ *
+ *  @param   engine Hash engine
+ *
+ *  @return  0 if the engine is not supported by the CPU, else 1
+ */
+
+int hash_set_engine (int engine);
+
+//------------------------------------------------------------------------------
+/*! @brief   Get the engine used by hash().
+ *
+ *  @return  hash engine
+ */
+
+int hash_get_engine ();
+
+//------------------------------------------------------------------------------
+/*! @brief   Check if the engine is supported by the CPU.
+ *
+ *  @param   engine Hash engine
+ *
+ *  @return  1 if supported, else 0
+ */
+
+int hash_engine_supported (int engine);
+
+//------------------------------------------------------------------------------
+/*! @brief   Mixing of a block hash with its position, so that the hash of the
+ *           whole buffer is a xor of mixed block hashes and can be updated
+ *           when one block changes.
+ *
+ *  @param   block_hash  Hash of the block
+ *  @param   block       Index of the block
+ *
+ *  @return  mixed hash
+ */
+
+hash_t hash_mix (hash_t block_hash, size_t block);
 
 //------------------------------------------------------------------------------
 
@@ -0,0 +1,91 @@
+/*------------------------------------------------------------------------------
+    * File:        ConcurrentTest.cpp                                          *
+    * Description: Value conservation of the concurrent stack. Every thread    *
+                   pushes its own range of values and pops in turn, then the   *
+                   rest is drained. Every pushed value has to be popped once.  *
+                   Threads as the argument, 4 by default. Exit status is the   *
+                   number of failed checks.                                    *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/ConcurrentStack.h"
+#include <thread>
+#include <vector>
+
+const size_t VALUES_PER_THREAD = 200000;
+
+//------------------------------------------------------------------------------
+
+// pops every second push, so the stack holds half of the values at the end
+template <typename POLICY>
+int test (const char* name, size_t threads_num)
+{
+    ConcurrentStack<long long, POLICY> stk ((char*)"stk");
+
+    std::vector<std::vector<long long>> popped (threads_num);
+    std::vector<std::thread>            threads;
+
+    for (size_t t = 0; t < threads_num; ++t)
+    {
+        threads.emplace_back([&, t]
+        {
+            long long first = (long long)(t * VALUES_PER_THREAD);
+
+            for (size_t i = 0; i < VALUES_PER_THREAD; ++i)
+            {
+                stk.Push(first + (long long)i);
+
+                long long value = 0;
+                if ((i % 2 == 1) && (stk.Pop(value) == STACK_OK)) popped[t].push_back(value);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads) thread.join();
+
+    std::vector<long long> rest;
+    long long value = 0;
+    while (stk.Pop(value) == STACK_OK) rest.push_back(value);
+
+    popped.push_back(rest);
+
+    std::vector<char> seen (threads_num * VALUES_PER_THREAD, 0);
+    size_t wrong = 0;
+
+    for (std::vector<long long>& values : popped)
+        for (long long v : values)
+        {
+            if ((v < 0) || ((size_t)v >= seen.size()) || seen[v]) ++wrong;
+            else seen[v] = 1;
+        }
+
+    size_t lost = 0;
+    for (char s : seen) lost += (s == 0);
+
+    int failed = (wrong != 0) || (lost != 0) || (! stk.isEmpty());
+
+    printf("%-26s threads %zu: %s (wrong %zu, lost %zu)\n", name, threads_num, failed ? "FAILED" : "ok", wrong, lost);
+
+    return failed;
+}
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char* argv[])
+{
+    size_t threads_num = 4;
+    if (argc > 1) threads_num = (size_t)atoi(argv[1]);
+    if (threads_num == 0) threads_num = 1;
+
+    int failed = 0;
+
+    failed += test<Release> ("ConcurrentStack<Release>", threads_num);
+    failed += test<Checked> ("ConcurrentStack<Checked>", threads_num);
+
+    return failed;
+}
@@ -0,0 +1,193 @@
+/*------------------------------------------------------------------------------
+    * File:        PersistentTest.cpp                                          *
+    * Description: Torn file detection and recovery of the persistent stack.   *
+                   The file is damaged behind the stack's back the way a crash *
+                   leaves it: a value written without its hashes, a size       *
+                   written without the header hash, a file cut while growing.  *
+                   Open has to report each of them and Recover has to give a   *
+                   consistent stack with the values under the size. A file     *
+                   has to reopen under any hash engine of the process. The     *
+                   file is the argument, .bin/PersistentTest.stk by default.   *
+                   Exit status is the number of failed checks.                 *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/PersistentStack.h"
+
+const size_t CAPACITY   = 1000;
+const size_t VALUES_NUM = 300;
+
+struct Persistent : Checked
+{
+    static constexpr bool hash = true;
+    static constexpr bool dump = false;
+};
+
+typedef PersistentStack<long long, Persistent> TestStack;
+
+int failed = 0;
+
+//------------------------------------------------------------------------------
+
+void expect (bool cond, const char* what)
+{
+    printf("%-52s %s\n", what, cond ? "ok" : "FAILED");
+
+    failed += ! cond;
+}
+
+//------------------------------------------------------------------------------
+
+// a new file with 0 .. VALUES_NUM - 1 in it
+bool create (const char* filename)
+{
+    unlink(filename);
+
+    TestStack stk ((char*)"stk");
+    if (stk.Open(filename, CAPACITY) != STACK_OK) return false;
+
+    for (size_t i = 0; i < VALUES_NUM; ++i) stk.Push((long long)i);
+
+    return stk.Close() == STACK_OK;
+}
+
+//------------------------------------------------------------------------------
+
+// the values under the size are 0, 1, ... except the top one, which may be torn
+bool values_kept (TestStack& stk, size_t size)
+{
+    if (stk.getSize() != size) return false;
+
+    for (size_t i = 0; i + 1 < size; ++i)
+        if (stk[i] != (long long)i) return false;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+bool write_at (const char* filename, off_t offset, const void* data, size_t size)
+{
+    int fd = open(filename, O_RDWR);
+    if (fd < 0) return false;
+
+    bool ok = (pwrite(fd, data, size, offset) == (ssize_t)size);
+
+    return (close(fd) == 0) && ok;
+}
+
+//------------------------------------------------------------------------------
+
+void test_reopen (const char* filename)
+{
+    expect(create(filename), "create a stack file");
+
+    TestStack stk ((char*)"stk");
+    expect(stk.Open(filename) == STACK_OK,       "reopen a good file");
+    expect(values_kept(stk, VALUES_NUM),          "reopened file keeps its values");
+    expect(stk.Verify() == STACK_OK,              "reopened file passes the full check");
+}
+
+//------------------------------------------------------------------------------
+
+void test_torn_value (const char* filename)
+{
+    create(filename);
+
+    // the top value reached the file, its block hash did not
+    long long value = -1;
+    write_at(filename, PERSISTENT_HEADER_SIZE + (VALUES_NUM - 1) * sizeof(long long), &value, sizeof(value));
+
+    TestStack stk ((char*)"stk");
+    expect(stk.Open(filename) == STACK_INCORRECT_HASH, "torn value is found by Open");
+    expect(stk.Recover() == STACK_OK,                  "torn value is recovered");
+    expect(values_kept(stk, VALUES_NUM),               "values under the torn one are kept");
+    expect(stk.Verify() == STACK_OK,                   "recovered file passes the full check");
+}
+
+//------------------------------------------------------------------------------
+
+void test_torn_header (const char* filename)
+{
+    create(filename);
+
+    // a push changed the size, the header hash was not written
+    uint64_t size = VALUES_NUM + 1;
+    write_at(filename, offsetof(PersistentHeader, size), &size, sizeof(size));
+
+    TestStack stk ((char*)"stk");
+    expect(stk.Open(filename) == STACK_INCORRECT_HASH, "torn header is found by Open");
+    expect(stk.Recover() == STACK_OK,                  "torn header is recovered");
+    expect(values_kept(stk, VALUES_NUM + 1),           "values under the torn size are kept");
+    expect(stk.Verify() == STACK_OK,                   "recovered file passes the full check");
+}
+
+//------------------------------------------------------------------------------
+
+void test_truncated (const char* filename)
+{
+    create(filename);
+
+    // the file was cut in the middle of the block hashes
+    struct stat st = {};
+    stat(filename, &st);
+    expect(truncate(filename, st.st_size - 100) == 0, "truncate the file");
+
+    TestStack stk ((char*)"stk");
+    expect(stk.Open(filename) != STACK_OK,   "truncated file is found by Open");
+    expect(stk.Recover() == STACK_OK,        "truncated file is recovered");
+    expect(stk.getCapacity() < CAPACITY,     "capacity is taken from the file size");
+    expect(values_kept(stk, VALUES_NUM),     "values of the truncated file are kept");
+    expect(stk.Verify() == STACK_OK,         "recovered file passes the full check");
+
+    stk.Push((long long)VALUES_NUM);
+    expect(stk.Close() == STACK_OK,          "recovered file takes pushes");
+
+    expect(stk.Open(filename) == STACK_OK,   "recovered file reopens");
+    expect(values_kept(stk, VALUES_NUM + 1), "pushed value is kept");
+}
+
+//------------------------------------------------------------------------------
+
+void test_other_engine (const char* filename)
+{
+    create(filename);
+
+    // the file is opened by a process whose hash() is another engine
+    hash_set_engine(HASH_ENGINE_COMPAT);
+
+    TestStack stk ((char*)"stk");
+    expect(stk.Open(filename) == STACK_OK,   "file reopens under compat hash engine");
+    expect(values_kept(stk, VALUES_NUM),     "values are kept under compat engine");
+    expect(stk.Verify() == STACK_OK,         "file passes the full check under compat");
+
+    stk.Push((long long)VALUES_NUM);
+    expect(stk.Close() == STACK_OK,          "file takes pushes under compat engine");
+
+    hash_set_engine(HASH_ENGINE_AUTO);
+
+    expect(stk.Open(filename) == STACK_OK,   "file reopens under auto engine again");
+    expect(values_kept(stk, VALUES_NUM + 1), "value pushed under compat is kept");
+}
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char* argv[])
+{
+    const char* filename = (argc > 1) ? argv[1] : ".bin/PersistentTest.stk";
+
+    test_reopen      (filename);
+    test_torn_value  (filename);
+    test_torn_header (filename);
+    test_truncated   (filename);
+    test_other_engine(filename);
+
+    unlink(filename);
+
+    return failed;
+}
@@ -0,0 +1,101 @@
+/*------------------------------------------------------------------------------
+    * File:        StealTest.cpp                                               *
+    * Description: Value conservation of the work-stealing deque. The owner    *
+                   pushes and pops at the bottom while thieves steal from the  *
+                   top, the deque starts small so it grows under the thieves.  *
+                   Every pushed value has to be taken once. Thieves as the     *
+                   argument, 3 by default. Exit status is the number of        *
+                   failed checks.                                              *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/WorkStealingDeque.h"
+#include <thread>
+#include <vector>
+
+const size_t VALUES_NUM = 1000000;
+
+//------------------------------------------------------------------------------
+
+// pushes in bursts of 1..8 values and pops one after every burst
+template <typename POLICY>
+int test (const char* name, size_t thieves_num)
+{
+    WorkStealingDeque<long long, POLICY> deque ((char*)"deque", 16);
+
+    std::vector<std::vector<long long>> taken (thieves_num + 1);
+    std::vector<std::thread>            thieves;
+    std::atomic<bool>                   done (false);
+
+    for (size_t t = 0; t < thieves_num; ++t)
+    {
+        thieves.emplace_back([&, t]
+        {
+            long long value = 0;
+            while (! done.load())
+            {
+                if (deque.Steal(value) == STACK_OK) taken[t].push_back(value);
+                else std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<long long>& owner = taken[thieves_num];
+    long long value = 0;
+
+    for (size_t i = 0; i < VALUES_NUM; )
+    {
+        for (size_t burst = i % 8 + 1; (burst > 0) && (i < VALUES_NUM); --burst) deque.Push((long long)i++);
+
+        if (deque.Pop(value) == STACK_OK) owner.push_back(value);
+    }
+
+    while (deque.Pop(value) == STACK_OK) owner.push_back(value);
+
+    done.store(true);
+    for (std::thread& thief : thieves) thief.join();
+
+    std::vector<char> seen (VALUES_NUM, 0);
+    size_t wrong  = 0;
+    size_t stolen = 0;
+
+    for (size_t t = 0; t <= thieves_num; ++t)
+    {
+        if (t < thieves_num) stolen += taken[t].size();
+
+        for (long long v : taken[t])
+        {
+            if ((v < 0) || ((size_t)v >= seen.size()) || seen[v]) ++wrong;
+            else seen[v] = 1;
+        }
+    }
+
+    size_t lost = 0;
+    for (char s : seen) lost += (s == 0);
+
+    int failed = (wrong != 0) || (lost != 0) || (deque.getSize() != 0);
+
+    printf("%-28s thieves %zu: %s (wrong %zu, lost %zu, stolen %zu)\n", name, thieves_num, failed ? "FAILED" : "ok", wrong, lost, stolen);
+
+    return failed;
+}
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char* argv[])
+{
+    size_t thieves_num = 3;
+    if (argc > 1) thieves_num = (size_t)atoi(argv[1]);
+
+    int failed = 0;
+
+    failed += test<Release> ("WorkStealingDeque<Release>", thieves_num);
+    failed += test<Checked> ("WorkStealingDeque<Checked>", thieves_num);
+
+    return failed;
+}
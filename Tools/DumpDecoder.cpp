@@ -0,0 +1,360 @@
+/*------------------------------------------------------------------------------
+    * File:        DumpDecoder.cpp                                             *
+    * Description: Decoder of binary stack dumps. Renders records in the text  *
+                   format of Stack::Dump, filters them by stack id and time    *
+                   and shows differences between consecutive dumps.            *
+    * Author:      Artem Puzankov                                              *
+    * Email:       puzankov.ao@phystech.edu                                    *
+    * GitHub:      https://github.com/hellopuza                                *
+    * Copyright © 2021 Artem Puzankov. All rights reserved.                    *
+    *///------------------------------------------------------------------------
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "../StackLib/Dump.h"
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+struct DecoderOptions
+{
+    const char* filename = STACK_BINLOGNAME;
+    bool        diff     = false;
+    bool        by_id    = false;
+    int         id       = 0;
+    uint64_t    from     = 0;
+    uint64_t    to       = UINT64_MAX;
+    size_t      head     = DUMP_NO_WINDOW;
+    size_t      tail     = DUMP_NO_WINDOW;
+};
+
+struct DecoderState
+{
+    std::unordered_map<uint32_t, std::string>       strings;
+    std::unordered_map<int, std::vector<char>>      last;
+};
+
+//------------------------------------------------------------------------------
+
+static void usage (const char* progname)
+{
+    printf("Usage: %s [-i id] [-from time] [-to time] [-diff] [-head n] [-tail n] [file]\n"
+           "  file        binary dump file (default %s)\n"
+           "  -i id       print only dumps of the stack with this id\n"
+           "  -from time  print only dumps made at this time or later\n"
+           "  -to time    print only dumps made at this time or earlier\n"
+           "  -diff       print only changes since the previous dump of the same stack\n"
+           "  -head n     print only the first n values of a stack and the last ones of -tail\n"
+           "  -tail n     print only the last n values of a stack and the first ones of -head\n"
+           "  time is seconds since epoch or \"YYYY-MM-DD HH:MM:SS\" in local time\n"
+           "  exit status is 1 if the file can not be read or ends inside a record\n",
+           progname, STACK_BINLOGNAME);
+}
+
+//------------------------------------------------------------------------------
+
+static bool parse_time (const char* str, uint64_t* time_ns)
+{
+    struct tm tm = {};
+    int parsed = sscanf(str, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                                                  &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+    if (parsed >= 3)
+    {
+        tm.tm_year -= 1900;
+        tm.tm_mon  -= 1;
+        tm.tm_isdst = -1;
+
+        *time_ns = (uint64_t)mktime(&tm) * 1000000000;
+        return true;
+    }
+
+    char* end = nullptr;
+    unsigned long long seconds = strtoull(str, &end, 10);
+    if ((end == str) || (*end != '\0'))
+        return false;
+
+    *time_ns = (uint64_t)seconds * 1000000000;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static bool parse_options (int argc, char* argv[], DecoderOptions* opts)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if ((strcmp(argv[i], "-i") == 0) && (i + 1 < argc))
+        {
+            opts->by_id = true;
+            opts->id    = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "-from") == 0) && (i + 1 < argc))
+        {
+            if (! parse_time(argv[++i], &opts->from)) return false;
+        }
+        else if ((strcmp(argv[i], "-to") == 0) && (i + 1 < argc))
+        {
+            if (! parse_time(argv[++i], &opts->to)) return false;
+            opts->to += 999999999;
+        }
+        else if (strcmp(argv[i], "-diff") == 0)
+        {
+            opts->diff = true;
+        }
+        else if ((strcmp(argv[i], "-head") == 0) && (i + 1 < argc))
+        {
+            opts->head = strtoull(argv[++i], nullptr, 10);
+            if (opts->tail == DUMP_NO_WINDOW) opts->tail = 0;
+        }
+        else if ((strcmp(argv[i], "-tail") == 0) && (i + 1 < argc))
+        {
+            opts->tail = strtoull(argv[++i], nullptr, 10);
+            if (opts->head == DUMP_NO_WINDOW) opts->head = 0;
+        }
+        else if (argv[i][0] == '-')
+        {
+            return false;
+        }
+        else
+        {
+            opts->filename = argv[i];
+        }
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+static const char* find_string (const DecoderState* state, uint32_t id)
+{
+    if (id == 0)
+        return nullptr;
+
+    auto found = state->strings.find(id);
+    if (found == state->strings.end())
+        return "?";
+
+    return found->second.c_str();
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE>
+void render_diff (LogBuffer* buf, const DumpStack* prev, const TYPE* prev_data,
+                  const DumpStack* stk, const TYPE* data, const char* funcname, const char* name)
+{
+    buf_printf(buf, "Diff of stack \"%s\", id (%d) called from a function \"%s\"\n", name, stk->id, funcname);
+
+    time_t t = (time_t)(stk->time / 1000000000);
+    struct tm tm = *localtime(&t);
+    buf_printf(buf, "TIME: %d-%02d-%02d %02d:%02d:%02d\n\n",
+               tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+    if (prev->errcode != stk->errcode)
+        buf_printf(buf, "\tState              : %s -> %s\n", stk_errstr[prev->errcode + 1], stk_errstr[stk->errcode + 1]);
+
+    if (prev->capacity != stk->capacity)
+        buf_printf(buf, "\tCapacity           = %lu -> %lu\n", (unsigned long)prev->capacity, (unsigned long)stk->capacity);
+
+    if (prev->size != stk->size)
+        buf_printf(buf, "\tCurrent size       = %lu -> %lu\n", (unsigned long)prev->size, (unsigned long)stk->size);
+
+    if (prev->data_address != stk->data_address)
+        buf_printf(buf, "\tData               = " PRINT_PTR " -> " PRINT_PTR "\n", (void*)prev->data_address, (void*)stk->data_address);
+
+    size_t prev_capacity = (prev_data != nullptr) ? prev->capacity : 0;
+    size_t capacity      = (data      != nullptr) ? stk->capacity  : 0;
+
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        if ((i < prev_capacity) && (memcmp(&prev_data[i], &data[i], sizeof(TYPE)) == 0))
+            continue;
+
+        buf_printf(buf, "\t\t[%zu]: [", i);
+        if (i < prev_capacity) DumpValue(buf, prev_data[i], true);
+        buf_printf(buf, "] -> [");
+        DumpValue(buf, data[i], true);
+        buf_printf(buf, "]%s\n", isPOISON(data[i]) ? " (POISON)" : "");
+    }
+
+    buf_printf(buf, "********************************************************************************\n");
+}
+
+//------------------------------------------------------------------------------
+
+template <typename TYPE>
+void render (LogBuffer* buf, const DumpStack* stk, const char* data, size_t data_size,
+             const std::vector<char>* prev, const char* funcname, const char* name)
+{
+    if ((stk->elem_size != sizeof(TYPE)) || ((data_size != 0) && (data_size != stk->capacity * sizeof(TYPE))))
+    {
+        buf_printf(buf, "Broken record of stack id (%d): wrong data size\n", stk->id);
+        return;
+    }
+
+    const TYPE* values = (data_size != 0) ? (const TYPE*)data : nullptr;
+
+    if (prev == nullptr)
+    {
+        DumpRender(buf, stk, funcname, name, values, true);
+        return;
+    }
+
+    const DumpStack* prev_stk  = (const DumpStack*)prev->data();
+    const TYPE*      prev_data = (prev->size() > sizeof(DumpStack)) ? (const TYPE*)(prev->data() + sizeof(DumpStack)) : nullptr;
+
+    render_diff(buf, prev_stk, prev_data, stk, values, funcname, name);
+}
+
+//------------------------------------------------------------------------------
+
+static void render_record (LogBuffer* buf, const DumpStack* stk, const char* data, size_t data_size,
+                           const std::vector<char>* prev, const char* funcname, const char* name)
+{
+    switch (stk->type_tag)
+    {
+    case TYPE_TAG<double>:             render<double>            (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<float>:              render<float>             (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<unsigned long long>: render<unsigned long long>(buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<long long>:          render<long long>         (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<long unsigned int>:  render<long unsigned int> (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<unsigned int>:       render<unsigned int>      (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<int>:                render<int>               (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<unsigned short>:     render<unsigned short>    (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<short>:              render<short>             (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<unsigned char>:      render<unsigned char>     (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<char>:               render<char>              (buf, stk, data, data_size, prev, funcname, name); break;
+    case TYPE_TAG<char*>:              render<char*>             (buf, stk, data, data_size, prev, funcname, name); break;
+
+    default:
+        buf_printf(buf, "Record of stack id (%d) has unknown type tag %d\n", stk->id, stk->type_tag);
+        break;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+static void decode_stack (const DecoderOptions* opts, DecoderState* state, const std::vector<char>& payload)
+{
+    if (payload.size() < sizeof(DumpStack))
+        return;
+
+    const DumpStack* stk = (const DumpStack*)payload.data();
+
+    if ((opts->by_id && (stk->id != opts->id)) || (stk->time < opts->from) || (stk->time > opts->to))
+        return;
+
+    std::vector<char>* prev = nullptr;
+    if (opts->diff)
+    {
+        auto found = state->last.find(stk->id);
+        if (found != state->last.end()) prev = &found->second;
+    }
+
+    LogBuffer buf;
+    render_record(&buf, stk, payload.data() + sizeof(DumpStack), payload.size() - sizeof(DumpStack), prev,
+                  find_string(state, stk->func_id), find_string(state, stk->name_id));
+
+    if (buf.size != 0) fwrite(buf.data, 1, buf.size, stdout);
+
+    if (opts->diff) state->last[stk->id] = payload;
+}
+
+//------------------------------------------------------------------------------
+
+int main (int argc, char* argv[])
+{
+    DecoderOptions opts;
+    if (! parse_options(argc, argv, &opts))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    dump_set_window(opts.head, opts.tail);
+
+    FILE* fp = fopen(opts.filename, "rb");
+    if (fp == nullptr)
+    {
+        printf("Can not open file \"%s\"\n", opts.filename);
+        return 1;
+    }
+
+    // record sizes are checked against the file, a damaged header must not make a huge allocation
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    DecoderState      state;
+    DumpRecordHeader  header  = {};
+    std::vector<char> payload;
+
+    // a log cut in the middle of a record is an error, so scripts can find damaged logs
+    int status = 0;
+
+    while (true)
+    {
+        size_t read = fread(&header, 1, sizeof(header), fp);
+        if (read == 0) break;
+
+        if (read != sizeof(header))
+        {
+            printf("Unexpected end of file\n");
+            status = 1;
+            break;
+        }
+
+        if ((header.magic != DUMP_MAGIC) || (header.version != DUMP_VERSION))
+        {
+            printf("Wrong record header at offset %ld\n", ftell(fp) - (long)sizeof(header));
+            fclose(fp);
+            return 1;
+        }
+
+        if (header.size > (uint64_t)(file_size - ftell(fp)))
+        {
+            printf("Record size %llu at offset %ld is over the end of file\n",
+                   (unsigned long long)header.size, ftell(fp) - (long)sizeof(header));
+            status = 1;
+            break;
+        }
+
+        payload.resize(header.size);
+        if ((header.size != 0) && (fread(payload.data(), header.size, 1, fp) != 1))
+        {
+            printf("Unexpected end of file\n");
+            status = 1;
+            break;
+        }
+
+        switch (header.record)
+        {
+        case DUMP_RECORD_SESSION:
+            state.strings.clear();
+            state.last.clear();
+            break;
+
+        case DUMP_RECORD_STRING:
+            if (payload.size() >= sizeof(DumpString))
+            {
+                const DumpString* string = (const DumpString*)payload.data();
+                state.strings[string->id] = std::string(payload.data() + sizeof(DumpString), payload.size() - sizeof(DumpString));
+            }
+            break;
+
+        case DUMP_RECORD_STACK:
+            decode_stack(&opts, &state, payload);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return status;
+}
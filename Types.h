@@ -11,12 +11,19 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <new>
+#include <tuple>
 #include <type_traits>
 #include <limits.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 
 template<typename TYPE> const TYPE POISON;
 
@@ -34,7 +41,48 @@ template<typename TYPE> const TYPE POISON;
     template<> constexpr char*              POISON<char*>              = nullptr;
 
 
-template<typename TYPE> const char* PRINT_TYPE;
+template<typename TYPE> constexpr bool HAS_POISON = false;
+
+    template<> constexpr bool HAS_POISON<double>             = true;
+    template<> constexpr bool HAS_POISON<float>              = true;
+    template<> constexpr bool HAS_POISON<unsigned long long> = true;
+    template<> constexpr bool HAS_POISON<long long>          = true;
+    template<> constexpr bool HAS_POISON<long unsigned int>  = true;
+    template<> constexpr bool HAS_POISON<unsigned int>       = true;
+    template<> constexpr bool HAS_POISON<int>                = true;
+    template<> constexpr bool HAS_POISON<unsigned short>     = true;
+    template<> constexpr bool HAS_POISON<short>              = true;
+    template<> constexpr bool HAS_POISON<unsigned char>      = true;
+    template<> constexpr bool HAS_POISON<char>               = true;
+    template<> constexpr bool HAS_POISON<char*>              = true;
+
+    // a tuple is POISON when all its fields with POISON are
+    template<typename... FIELDS> constexpr bool HAS_POISON<std::tuple<FIELDS...>> = (HAS_POISON<FIELDS> || ...);
+
+
+template<typename TYPE> constexpr bool IS_TUPLE = false;
+
+    template<typename... FIELDS> constexpr bool IS_TUPLE<std::tuple<FIELDS...>> = true;
+
+
+//------------------------------------------------------------------------------
+/*! @brief   POISON of a field of a tuple, a value initialized field if its type
+ *           has no POISON.
+ *
+ *  @return  POISON of the field
+ */
+
+template <typename TYPE>
+constexpr TYPE FieldPOISON ()
+{
+    if constexpr (HAS_POISON<TYPE>) return POISON<TYPE>;
+    else                            return TYPE ();
+}
+
+    template<typename... FIELDS> const std::tuple<FIELDS...> POISON<std::tuple<FIELDS...>> = std::tuple<FIELDS...> (FieldPOISON<FIELDS>()...);
+
+
+template<typename TYPE> const char* PRINT_TYPE = "object";
 
     template<> const char* const PRINT_TYPE<double>             = "double";
     template<> const char* const PRINT_TYPE<float>              = "float";
@@ -49,6 +97,8 @@ template<typename TYPE> const char* PRINT_TYPE;
     template<> const char* const PRINT_TYPE<char>               = "char";
     template<> const char* const PRINT_TYPE<char*>              = "char*";
 
+    template<typename... FIELDS> const char* const PRINT_TYPE<std::tuple<FIELDS...>> = "tuple";
+
 
 template<typename TYPE> const char* const PRINT_FORMAT;
 
@@ -66,28 +116,261 @@ template<typename TYPE> const char* const PRINT_FORMAT;
     template<> const char* const PRINT_FORMAT<char*>              = "%s";
 
 
+template<typename TYPE> constexpr int TYPE_TAG = 0;
+
+    template<> constexpr int TYPE_TAG<double>             = 1;
+    template<> constexpr int TYPE_TAG<float>              = 2;
+    template<> constexpr int TYPE_TAG<unsigned long long> = 3;
+    template<> constexpr int TYPE_TAG<long long>          = 4;
+    template<> constexpr int TYPE_TAG<long unsigned int>  = 5;
+    template<> constexpr int TYPE_TAG<unsigned int>       = 6;
+    template<> constexpr int TYPE_TAG<int>                = 7;
+    template<> constexpr int TYPE_TAG<unsigned short>     = 8;
+    template<> constexpr int TYPE_TAG<short>              = 9;
+    template<> constexpr int TYPE_TAG<unsigned char>      = 10;
+    template<> constexpr int TYPE_TAG<char>               = 11;
+    template<> constexpr int TYPE_TAG<char*>              = 12;
+
+
 //------------------------------------------------------------------------------
 /*! @brief   Check if value is POISON.
  *
  *  @param   value       Value to be checked
  *
- *  @return 1 if value is POISON, else 0
+ *  @return 1 if value is POISON, else 0 (always 0 for types without POISON)
  */
 
 template <typename TYPE>
-bool isPOISON (TYPE value)
+bool isPOISON (const TYPE& value)
 {
-    if (value == POISON<TYPE>) return 1;
+    if constexpr (! HAS_POISON<TYPE>) return 0;
 
-    if (isnan(*(double*)&POISON<TYPE>))
-        if (isnan(*(double*)&value))
-            return 1;
-        else
-            return 0;
+    else if constexpr (std::is_same<TYPE, float>::value)
+    {
+        // any NaN, matched by its bits so that it works with -ffast-math too
+        uint32_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+
+        return (bits & 0x7FFFFFFFu) > 0x7F800000u;
+    }
+
+    else if constexpr (std::is_same<TYPE, double>::value)
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+
+        return (bits & 0x7FFFFFFFFFFFFFFFull) > 0x7FF0000000000000ull;
+    }
 
     else return (value == POISON<TYPE>);
 }
 
+//------------------------------------------------------------------------------
+/*! @brief   Check if all the fields of a tuple that have POISON are POISON.
+ *
+ *  @param   value       Tuple to be checked
+ *
+ *  @return 1 if value is POISON, else 0 (always 0 if no field has POISON)
+ */
+
+template <typename... FIELDS>
+bool isPOISON (const std::tuple<FIELDS...>& value)
+{
+    if constexpr (! HAS_POISON<std::tuple<FIELDS...>>) return 0;
+
+    else return std::apply([] (const FIELDS&... field) { return ((! HAS_POISON<FIELDS> || isPOISON(field)) && ...); }, value);
+}
+
+// scalars that the kernels below check 16 bytes at a time
+template<typename TYPE> constexpr bool POISON_SIMD = HAS_POISON<TYPE> && (std::is_arithmetic<TYPE>::value || std::is_pointer<TYPE>::value) &&
+                                                    (16 % sizeof(TYPE) == 0);
+
+#if defined(__SSE2__)
+
+//------------------------------------------------------------------------------
+/*! @brief   Check 16 bytes of values for POISON.
+ *
+ *  @param   slots       Pointer to the values, unaligned
+ *
+ *  @return  vector with all the bytes of POISON values set, others are zero
+ */
+
+template <typename TYPE>
+__m128i poison_match (const TYPE* slots)
+{
+    static_assert(POISON_SIMD<TYPE>);
+
+    __m128i values = _mm_loadu_si128((const __m128i*)slots);
+    __m128i match  = _mm_setzero_si128();
+
+    if constexpr (std::is_same<TYPE, float>::value)
+    {
+        __m128 ps = _mm_castsi128_ps(values);
+        match = _mm_castps_si128(_mm_cmpunord_ps(ps, ps));
+    }
+
+    else if constexpr (std::is_same<TYPE, double>::value)
+    {
+        __m128d pd = _mm_castsi128_pd(values);
+        match = _mm_castpd_si128(_mm_cmpunord_pd(pd, pd));
+    }
+
+    else
+    {
+        TYPE poison = POISON<TYPE>;
+
+        if constexpr (sizeof(TYPE) == 1)
+        {
+            char bits = 0;
+            memcpy(&bits, &poison, 1);
+            match = _mm_cmpeq_epi8(values, _mm_set1_epi8(bits));
+        }
+        else if constexpr (sizeof(TYPE) == 2)
+        {
+            short bits = 0;
+            memcpy(&bits, &poison, 2);
+            match = _mm_cmpeq_epi16(values, _mm_set1_epi16(bits));
+        }
+        else if constexpr (sizeof(TYPE) == 4)
+        {
+            int bits = 0;
+            memcpy(&bits, &poison, 4);
+            match = _mm_cmpeq_epi32(values, _mm_set1_epi32(bits));
+        }
+        else
+        {
+            long long bits = 0;
+            memcpy(&bits, &poison, 8);
+            match = _mm_cmpeq_epi32(values, _mm_set1_epi64x(bits));
+
+            // both halves of a value must match
+            match = _mm_and_si128(match, _mm_shuffle_epi32(match, _MM_SHUFFLE(2, 3, 0, 1)));
+        }
+    }
+
+    return match;
+}
+
+#endif // __SSE2__
+
+//------------------------------------------------------------------------------
+/*! @brief   Fill slots with POISON, the slots may be raw storage.
+ *
+ *  @param   slots       Pointer to the first slot
+ *  @param   n           Number of slots
+ */
+
+template <typename TYPE>
+void poison_fill (TYPE* slots, size_t n)
+{
+    static_assert(HAS_POISON<TYPE>);
+
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    if constexpr (POISON_SIMD<TYPE>)
+    {
+        alignas(16) TYPE pattern[16 / sizeof(TYPE)];
+        for (TYPE& value : pattern) value = POISON<TYPE>;
+
+        __m128i poison = _mm_load_si128((const __m128i*)pattern);
+
+        for (; i + 16 / sizeof(TYPE) <= n; i += 16 / sizeof(TYPE))
+        {
+            _mm_storeu_si128((__m128i*)(slots + i), poison);
+        }
+    }
+#endif
+
+    for (; i < n; ++i)
+    {
+        new (slots + i) TYPE (POISON<TYPE>);
+    }
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Find the first value that is not POISON.
+ *
+ *  @param   slots       Pointer to the first value
+ *  @param   n           Number of values
+ *
+ *  @return  index of the value, n if all the values are POISON (0 for types
+ *           without POISON)
+ */
+
+template <typename TYPE>
+size_t poison_span (const TYPE* slots, size_t n)
+{
+    if constexpr (! HAS_POISON<TYPE>) return 0;
+
+    else
+    {
+        size_t i = 0;
+
+#if defined(__SSE2__)
+        if constexpr (POISON_SIMD<TYPE>)
+        {
+            for (; i + 16 / sizeof(TYPE) <= n; i += 16 / sizeof(TYPE))
+            {
+                unsigned mask = (unsigned)_mm_movemask_epi8(poison_match(slots + i));
+
+                if (mask != 0xFFFF) return i + __builtin_ctz(~mask) / sizeof(TYPE);
+            }
+        }
+#endif
+
+        for (; (i < n) && isPOISON(slots[i]); ++i);
+
+        return i;
+    }
+}
+
+//------------------------------------------------------------------------------
+/*! @brief   Count the values that are not POISON.
+ *
+ *  @param   slots       Pointer to the first value
+ *  @param   n           Number of values
+ *
+ *  @return  number of the values (n for types without POISON)
+ */
+
+template <typename TYPE>
+size_t poison_count (const TYPE* slots, size_t n)
+{
+    if constexpr (! HAS_POISON<TYPE>) return n;
+
+    else
+    {
+        size_t i     = 0;
+        size_t count = 0;
+
+#if defined(__SSE2__)
+        if constexpr (POISON_SIMD<TYPE>)
+        {
+            // sums of the matching bytes in the two halves
+            __m128i bytes = _mm_setzero_si128();
+
+            for (; i + 16 / sizeof(TYPE) <= n; i += 16 / sizeof(TYPE))
+            {
+                __m128i match = _mm_and_si128(poison_match(slots + i), _mm_set1_epi8(1));
+                bytes = _mm_add_epi64(bytes, _mm_sad_epu8(match, _mm_setzero_si128()));
+            }
+
+            // stored, not moved to a register: 64-bit moves are only on x86-64
+            uint64_t sums[2];
+            _mm_storeu_si128((__m128i*)sums, bytes);
+
+            size_t poisoned = (size_t)(sums[0] + sums[1]);
+            count = i - poisoned / sizeof(TYPE);
+        }
+#endif
+
+        for (; i < n; ++i) count += ! isPOISON(slots[i]);
+
+        return count;
+    }
+}
+
 //------------------------------------------------------------------------------
 /*! @brief   Print values of any type.
  *